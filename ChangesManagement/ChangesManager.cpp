@@ -6,17 +6,26 @@
 #include "data.h"
 #include "IndexFileParser.h"
 #include "../JitUtility/jit_utility.h"
+#include "../DirectoryManagement/FsMonitor.h"
+#include "../CommitManagement/SnapshotStore.h"
 
 #include <iostream>
 #include <fstream>
 #include <regex>
+#include <algorithm>
 #include <ranges>
 #include <set>
+#include <sys/stat.h>
 
 namespace fs = std::filesystem;
 
 namespace manager {
 
+    /**
+     * Number of files hashed at once by the clean check before looking at the results.
+     */
+    constexpr size_t CLEAN_CHECK_HASH_BATCH = 256;
+
     /**
      * Constructor that initializes the DirManager and sets the root directory.
      * @param root_directory The root directory of the repository.
@@ -33,38 +42,214 @@ namespace manager {
      * @throws std::runtime_error if any file in files_to_add cannot be found or read.
      */
     std::unordered_map<std::string, FileInfo> ChangesManager::get_files_map(const std::set<std::string> &files_to_add) {
+        const std::vector<std::string> file_names(files_to_add.begin(), files_to_add.end());
+        const std::vector<FileScanResult> scan_results = scan_files(file_names, true);
+
         std::unordered_map<std::string, FileInfo> current_files;
+        current_files.reserve(file_names.size());
+
+        for (size_t i = 0; i < file_names.size(); ++i) {
+            const auto &file_name = file_names[i];
+            const auto &scan_result = scan_results[i];
+
+            if (!scan_result.exists) {
+                throw std::runtime_error("Error reading file time for " + file_name);
+            }
+            if (scan_result.checksum.empty()) {
+                std::cerr << "Error opening file: " << get_root_directory() + "/" + file_name << std::endl;
+            }
 
-        for (const auto &file_name : files_to_add) {
             FileInfo file_info;
             file_info.filename = file_name;
-            file_info.checksum = generateSHA1(get_root_directory() + "/" + file_name);
+            file_info.checksum = scan_result.checksum;
+            file_info.last_modified = scan_result.last_modified;
+            file_info.size = scan_result.size;
             file_info.is_dirty = false;
             file_info.is_new = false;
 
-            // Convert filesystem time to system_clock time
-            try {
-                auto file_time = fs::last_write_time(get_root_directory() + "/" + file_name);
-                file_info.last_modified = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-                        file_time - fs::file_time_type::clock::now() + std::chrono::system_clock::now()
-                );
-            } catch (const std::exception &e) {
-                throw std::runtime_error("Error reading file time for " + file_name);
+            current_files[file_name] = std::move(file_info);
+        }
+
+        return current_files;
+    }
+
+    /**
+     * Removes the index entries outside the sparse checkout, which are expected to be missing from the working tree.
+     *
+     * @param content The index content to filter.
+     */
+    static void drop_skip_worktree_entries(IndexFileContent &content) {
+        std::erase_if(content.files_map, [](const auto &pair) { return pair.second.skip_worktree; });
+    }
+
+    /**
+     * Reads the working tree state saved by the last fsmonitor-assisted scan.
+     *
+     * @param state_path The path of the state file.
+     * @param token Receives the fsmonitor token the state corresponds to (empty if there is no state).
+     * @return A map of filenames to FileInfo objects as they were at the time of the token.
+     */
+    static std::unordered_map<std::string, FileInfo> read_fsmonitor_state(const std::string &state_path,
+                                                                          std::string &token) {
+        std::unordered_map<std::string, FileInfo> state;
+        std::ifstream file(state_path);
+        token.clear();
+
+        if (!file || !std::getline(file, token)) {
+            return state;
+        }
+
+        std::string line;
+        while (std::getline(file, line)) {
+            auto first_tab = line.find('\t');
+            auto second_tab = line.find('\t', first_tab + 1);
+            if (first_tab == std::string::npos || second_tab == std::string::npos) {
+                token.clear();
+                return {};
             }
 
-            current_files[file_info.filename] = file_info;
+            FileInfo file_info{};
+            file_info.checksum = line.substr(0, first_tab);
+            file_info.last_modified = std::chrono::system_clock::time_point(std::chrono::system_clock::duration(
+                    std::stoll(line.substr(first_tab + 1, second_tab - first_tab - 1))));
+            file_info.filename = line.substr(second_tab + 1);
+            state[file_info.filename] = file_info;
         }
 
-        return current_files;
+        return state;
+    }
+
+    /**
+     * Saves the working tree state so that the next scan only has to look at what fsmonitor reports as changed.
+     *
+     * @param state_path The path of the state file.
+     * @param token The fsmonitor token the state corresponds to.
+     * @param file_map The files of the working tree.
+     */
+    static void write_fsmonitor_state(const std::string &state_path, const std::string &token,
+                                      const std::unordered_map<std::string, FileInfo> &file_map) {
+        std::ofstream file(state_path);
+        if (!file) {
+            return;
+        }
+
+        file << token << '\n';
+        for (const auto &[file_name, file_info]: file_map) {
+            file << file_info.checksum << '\t' << file_info.last_modified.time_since_epoch().count() << '\t'
+                 << file_name << '\n';
+        }
+    }
+
+    /**
+     * Builds the file map of the working tree, asking the fsmonitor daemon (if any) first and falling back to a full
+     * scan.
+     *
+     * @param pathspec Limits the scan to the matching files.
+     * @return A map of filenames to FileInfo objects for every matching file in the working tree.
+     */
+    std::unordered_map<std::string, FileInfo> ChangesManager::scan_working_tree(const Pathspec &pathspec) {
+        if (auto file_map = scan_with_fsmonitor(pathspec)) {
+            return std::move(*file_map);
+        }
+
+        transform_file_names(pathspec);
+        return get_files_map(files);
+    }
+
+    /**
+     * Builds the file map of the working tree with the help of the fsmonitor daemon: only the paths it reports as
+     * changed since the last scan are hashed again, and every file is hashed when its answer cannot be trusted.
+     *
+     * The saved state always covers the whole tree. A limited scan that cannot use the daemon's answer leaves the
+     * state and its token untouched, which keeps them consistent with each other.
+     *
+     * @param pathspec Limits the scan to the matching files.
+     * @return A map of filenames to FileInfo objects for every matching file, or an empty optional when no daemon is
+     *         running.
+     */
+    std::optional<std::unordered_map<std::string, FileInfo>>
+    ChangesManager::scan_with_fsmonitor(const Pathspec &pathspec) {
+        std::string state_path = get_jit_root() + "/fsmonitor-state";
+        std::string token;
+        auto saved_state = read_fsmonitor_state(state_path, token);
+        auto response = FsMonitor(get_root_directory()).query(token);
+
+        if (!response) {
+            return std::nullopt;
+        }
+
+        if (!response->is_reliable) {
+            transform_file_names(pathspec);
+            auto file_map = get_files_map(files);
+            if (pathspec.matches_everything()) {
+                write_fsmonitor_state(state_path, response->token, file_map);
+            }
+            return file_map;
+        }
+
+        load_ignore_rules();
+        const SparseCheckout sparse_checkout = get_sparse_checkout();
+        std::set<std::string> files_to_hash;
+        std::set<std::string> vanished_paths;
+
+        for (const auto &path: response->changed_paths) {
+            fs::path absolute_path = fs::path(get_root_directory()) / path;
+            saved_state.erase(path);
+
+            if (fs::is_directory(absolute_path)) {
+                for (const auto &entry: fs::recursive_directory_iterator(absolute_path)) {
+                    std::string relative_path = entry.path().lexically_relative(get_root_directory()).string();
+                    if (!entry.is_directory() && !is_ignored(entry.path()) &&
+                        sparse_checkout.includes(relative_path)) {
+                        files_to_hash.insert(relative_path);
+                    }
+                }
+            } else if (fs::exists(absolute_path)) {
+                if (!is_ignored(absolute_path) && sparse_checkout.includes(path)) {
+                    files_to_hash.insert(path);
+                }
+            } else {
+                vanished_paths.insert(path);
+            }
+        }
+
+        // A removed or renamed directory is reported once, so drop everything that used to live under it.
+        if (!vanished_paths.empty()) {
+            std::erase_if(saved_state, [&vanished_paths](const auto &pair) {
+                for (auto parent = fs::path(pair.first).parent_path(); !parent.empty(); parent = parent.parent_path()) {
+                    if (vanished_paths.contains(parent.string())) return true;
+                }
+                return false;
+            });
+        }
+
+        for (const auto &file_name: files_to_hash) {
+            saved_state.erase(file_name);
+        }
+        saved_state.merge(get_files_map(files_to_hash));
+
+        files.clear();
+        for (const auto &[file_name, _]: saved_state) {
+            files.insert(file_name);
+        }
+
+        write_fsmonitor_state(state_path, response->token, saved_state);
+
+        if (!pathspec.matches_everything()) {
+            std::erase_if(saved_state, [&pathspec](const auto &pair) { return !pathspec.matches(pair.first); });
+            std::erase_if(files, [&pathspec](const auto &file_name) { return !pathspec.matches(file_name); });
+        }
+        return saved_state;
     }
 
     /**
      * Transforms file names by removing directory structure and leading slashes/dots.
      *
+     * @param pathspec Limits the scan to the matching files.
      * @return A set of transformed file names without directories.
      */
-    std::set<std::string> ChangesManager::transform_file_names() {
-        auto temp_files = get_files();
+    std::set<std::string> ChangesManager::transform_file_names(const Pathspec &pathspec) {
+        auto temp_files = get_files(pathspec);
 
         // Use range-based transformation to clean up file names
         auto transformed_filenames = std::views::transform(temp_files, [](const std::string &file_name) {
@@ -81,13 +266,21 @@ namespace manager {
      * @throws std::runtime_error if the repository has uncommitted changes.
      */
     void ChangesManager::throw_error_if_repo_is_dirty() {
-        transform_file_names();
-        auto file_map = get_files_map(files);
-        JitStatus status;
-        IndexFileParser parser(file_map, get_jit_root() + "/index");
+        auto file_map = scan_with_fsmonitor(Pathspec());
+
+        // Without a daemon, the short-circuiting check avoids hashing the whole tree.
+        if (!file_map) {
+            if (!is_working_tree_clean()) {
+                throw std::runtime_error("You have uncommitted changes! Please commit them first");
+            }
+            return;
+        }
+
+        IndexFileParser parser(get_jit_root() + "/index");
         IndexFileContent previous_content = parser.read_index_file();
+        drop_skip_worktree_entries(previous_content);
 
-        for (auto const &file_info_pair : file_map) {
+        for (auto const &file_info_pair : *file_map) {
             auto file_name = file_info_pair.first;
             auto file_info = file_info_pair.second;
 
@@ -112,19 +305,117 @@ namespace manager {
         }
     }
 
+    /**
+     * Checks whether the working tree matches the index, stopping at the first difference.
+     *
+     * The checks go from cheapest to most expensive: staged entries in the index (no I/O), then a single directory
+     * walk with one stat per file that stops at the first untracked file or size mismatch, then the count of files
+     * against the index to detect deletions. Only the files whose size and modification time cannot prove them
+     * unchanged are hashed, in batches, stopping at the first batch with a checksum mismatch. A modification time is
+     * only trusted when it is older than the index itself, since a file written in the same second as the index may
+     * have changed after it was recorded. Entries outside the sparse checkout are not expected on disk and the walk
+     * does not enter the directories that hold only such entries.
+     *
+     * @return True if nothing in the working tree differs from the index.
+     */
+    bool ChangesManager::is_working_tree_clean() {
+        IndexFileParser parser(get_jit_root() + "/index");
+        IndexFileContent index = parser.read_index_file();
+
+        for (const auto &[_, file_info]: index.files_map) {
+            if (file_info.is_dirty) {
+                return false;
+            }
+        }
+        drop_skip_worktree_entries(index);
+
+        struct stat index_stat{};
+        bool can_trust_mtime = ::stat((get_jit_root() + "/index").c_str(), &index_stat) == 0;
+
+        load_ignore_rules();
+        const SparseCheckout sparse_checkout = get_sparse_checkout();
+        const std::string root_directory = get_root_directory();
+        std::vector<std::string> files_to_hash;
+        size_t tracked_files_seen = 0;
+
+        for (auto it = fs::recursive_directory_iterator(root_directory); it != fs::recursive_directory_iterator(); ++it) {
+            const auto &entry = *it;
+            std::string relative_path = entry.path().lexically_relative(root_directory).generic_string();
+
+            if (entry.is_directory()) {
+                if (relative_path == ".jit" || !sparse_checkout.could_include_directory(relative_path)) {
+                    it.disable_recursion_pending();
+                }
+                continue;
+            }
+
+            if (is_ignored(entry.path()) || !sparse_checkout.includes(relative_path)) {
+                continue;
+            }
+
+            auto index_entry = index.files_map.find(relative_path);
+            if (index_entry == index.files_map.end()) {
+                return false;
+            }
+            ++tracked_files_seen;
+
+            struct stat file_stat{};
+            if (::stat(entry.path().c_str(), &file_stat) != 0) {
+                return false;
+            }
+
+            const FileInfo &file_info = index_entry->second;
+            if (file_info.size && *file_info.size != static_cast<uint64_t>(file_stat.st_size)) {
+                return false;
+            }
+
+            bool unchanged_since_add = can_trust_mtime && file_info.size && file_stat.st_mtime < index_stat.st_mtime &&
+                                       std::chrono::system_clock::to_time_t(file_info.last_modified) ==
+                                       file_stat.st_mtime;
+            if (!unchanged_since_add) {
+                files_to_hash.push_back(relative_path);
+            }
+        }
+
+        if (tracked_files_seen != index.files_map.size()) {
+            return false;
+        }
+
+        for (size_t start = 0; start < files_to_hash.size(); start += CLEAN_CHECK_HASH_BATCH) {
+            std::vector<std::string> batch(files_to_hash.begin() + static_cast<long>(start),
+                                           files_to_hash.begin() + static_cast<long>(
+                                                   std::min(start + CLEAN_CHECK_HASH_BATCH, files_to_hash.size())));
+
+            auto results = scan_files(batch, true);
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (results[i].checksum != index.files_map.at(batch[i]).checksum) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
     /**
      * Retrieves the current status of the repository, categorizing files into new, modified, staged, and deleted.
      *
+     * @param pathspec Limits the status to the matching paths.
      * @return A JitStatus object containing sets of new, modified, staged, and deleted files.
      */
-    JitStatus ChangesManager::repo_status() {
-        transform_file_names();
-
-        auto file_map = get_files_map(files);
+    JitStatus ChangesManager::repo_status(const Pathspec &pathspec) {
+        auto file_map = scan_working_tree(pathspec);
 
         JitStatus status;
         IndexFileParser parser(file_map, get_jit_root() + "/index");
         IndexFileContent previous_content = parser.read_index_file();
+        drop_skip_worktree_entries(previous_content);
+
+        if (!pathspec.matches_everything()) {
+            std::erase_if(previous_content.files_map, [&pathspec](const auto &pair) {
+                return !pathspec.matches(pair.first);
+            });
+        }
         std::set<FileInfo> new_files;
         std::set<FileInfo> modified_files;
         std::set<FileInfo> deleted_files;
@@ -168,11 +459,12 @@ namespace manager {
     /**
      * Prints the status of the repository, including staged, modified, and new files.
      *
+     * @param pathspec Limits the status to the matching paths.
      * @throws std::runtime_error if unable to open the HEAD file.
      */
-    void ChangesManager::print_jit_status() {
+    void ChangesManager::print_jit_status(const Pathspec &pathspec) {
 
-        auto status = repo_status();
+        auto status = repo_status(pathspec);
 
         auto new_files = status.new_files;
         auto modified_files = status.modified_files;
@@ -235,24 +527,18 @@ namespace manager {
     /**
      * Adds files to the repository index and stages them.
      *
-     * @param file_names A set of file names to be added to the index and staged.
+     * Plain files, directories and glob patterns are all accepted; only the parts of the tree that can match them are
+     * walked.
+     *
+     * @param file_names Pathspec patterns selecting the files to be added to the index and staged.
+     * @throws std::runtime_error if the patterns do not match any file.
      */
     void ChangesManager::jit_add(const std::set<std::string> &file_names) {
-        std::set<std::string> files_to_add;
-        transform_file_names();
-
-        // Process directories and files
-        for (auto &file_name : file_names) {
-            fs::path path = get_root_directory() + "/" + file_name;
+        Pathspec pathspec(std::vector<std::string>(file_names.begin(), file_names.end()));
+        std::set<std::string> files_to_add = transform_file_names(pathspec);
 
-            if (fs::is_directory(path)) {
-                for (auto &directory : fs::recursive_directory_iterator(path)) {
-                    auto cur_file_name = directory.path().lexically_normal().string();
-
-                    if (!fs::is_directory(directory) && files.contains(cur_file_name))
-                        files_to_add.insert(cur_file_name);
-                }
-            }
+        if (files_to_add.empty()) {
+            throw std::runtime_error("Pathspec did not match any files");
         }
 
         // Create and add file information to the index
@@ -268,6 +554,73 @@ namespace manager {
         update_file_objects(staged_files);
     }
 
+    /**
+     * Replaces the directories collapsed by the sparse index with the entries they hold.
+     *
+     * @param content The index content to expand.
+     * @throws std::runtime_error if the snapshot of a collapsed directory is missing.
+     */
+    void ChangesManager::expand_sparse_index(IndexFileContent &content) {
+        SnapshotStore store(get_jit_root() + "/objects");
+
+        for (const auto &[directory, tree_id]: content.sparse_directories) {
+            if (!fs::exists(get_jit_root() + "/objects/" + generate_file_path(tree_id).string())) {
+                throw std::runtime_error("Missing sparse index snapshot for " + directory);
+            }
+
+            for (auto &[file_name, file_info]: store.read_snapshot(tree_id, directory).files_map) {
+                file_info.skip_worktree = true;
+                content.files_map[file_name] = std::move(file_info);
+            }
+        }
+
+        content.sparse_directories.clear();
+    }
+
+    /**
+     * Collapses every directory that lies entirely outside the sparse checkout.
+     *
+     * The content is expanded first, then each skip-worktree entry is moved to the tree of its topmost ancestor that
+     * the cone cannot reach. The trees are the ones commits are made of, so a commit can reuse them without expanding
+     * the index.
+     *
+     * @param content The index content to collapse.
+     */
+    void ChangesManager::collapse_sparse_index(IndexFileContent &content) {
+        expand_sparse_index(content);
+
+        const SparseCheckout sparse_checkout = get_sparse_checkout();
+        if (get_config_value("index.sparse", "false") != "true" || !sparse_checkout.is_enabled() ||
+            !sparse_checkout.is_cone_mode()) {
+            return;
+        }
+
+        std::map<std::string, std::unordered_map<std::string, FileInfo>> collapsed_directories;
+        for (auto it = content.files_map.begin(); it != content.files_map.end();) {
+            std::string directory;
+            if (it->second.skip_worktree) {
+                for (size_t end = it->first.find('/'); end != std::string::npos; end = it->first.find('/', end + 1)) {
+                    if (!sparse_checkout.could_include_directory(it->first.substr(0, end))) {
+                        directory = it->first.substr(0, end);
+                        break;
+                    }
+                }
+            }
+
+            if (directory.empty()) {
+                ++it;
+            } else {
+                collapsed_directories[directory].emplace(it->first.substr(directory.size() + 1), it->second);
+                it = content.files_map.erase(it);
+            }
+        }
+
+        SnapshotStore store(get_jit_root() + "/objects");
+        for (const auto &[directory, files]: collapsed_directories) {
+            content.sparse_directories[directory] = store.write_tree(files);
+        }
+    }
+
     /**
      * Updates the file objects (storing files as binary objects in the repository).
      *
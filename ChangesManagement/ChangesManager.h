@@ -8,6 +8,7 @@
 #include <string>
 #include <map>
 #include <set>
+#include <optional>
 #include "../DirectoryManagement/DirManager.h"
 #include "IndexFileParser.h"
 #include "data.h"
@@ -34,9 +35,10 @@ namespace manager {
         /**
          * Transforms file names by removing directory structure and leading slashes/dots.
          *
+         * @param pathspec Limits the scan to the matching files.
          * @return A set of transformed file names without directories.
          */
-        std::set<std::string> transform_file_names();
+        std::set<std::string> transform_file_names(const Pathspec &pathspec = Pathspec());
 
         /**
          * Checks if the repository has uncommitted changes and throws an error if it does.
@@ -48,21 +50,27 @@ namespace manager {
         /**
          * Retrieves the current status of the repository, categorizing files into new, modified, staged, and deleted.
          *
+         * Only the working tree files and index entries matching the pathspec are looked at.
+         *
+         * @param pathspec Limits the status to the matching paths.
          * @return A JitStatus object containing sets of new, modified, staged, and deleted files.
          */
-        JitStatus repo_status();
+        JitStatus repo_status(const Pathspec &pathspec = Pathspec());
 
         /**
          * Prints the status of the repository, including staged, modified, and new files.
          *
+         * @param pathspec Limits the status to the matching paths.
          * @throws std::runtime_error if unable to open the HEAD file.
          */
-        void print_jit_status();
+        void print_jit_status(const Pathspec &pathspec = Pathspec());
 
         /**
          * Adds files to the repository index and stages them.
          *
-         * @param file_names A set of file names to be added to the index and staged.
+         * @param file_names Pathspec patterns (files, directories or globs) selecting the files to be added to the
+         *                   index and staged.
+         * @throws std::runtime_error if the patterns do not match any file.
          */
         void jit_add(const std::set<std::string> &file_names);
 
@@ -73,9 +81,60 @@ namespace manager {
          */
         void update_file_objects(const std::set<FileInfo> &file_infos);
 
+    protected:
+        /**
+         * Replaces the directories collapsed by the sparse index with the entries they hold.
+         *
+         * @param content The index content to expand.
+         * @throws std::runtime_error if the snapshot of a collapsed directory is missing.
+         */
+        void expand_sparse_index(IndexFileContent &content);
+
+        /**
+         * Collapses every directory that lies entirely outside the sparse checkout into a single entry pointing at the
+         * tree object of its files.
+         *
+         * This only happens when `index.sparse = true` and the sparse checkout is in cone mode; otherwise the content
+         * is fully expanded instead.
+         *
+         * @param content The index content to collapse.
+         */
+        void collapse_sparse_index(IndexFileContent &content);
+
     private:
         std::string jit_root;
         std::set<std::string> files;
+
+        /**
+         * Builds the file map of the whole working tree.
+         *
+         * When an fsmonitor daemon is running, only the paths it reports as changed since the last scan are hashed
+         * again and the rest is taken from the state saved by that scan. Otherwise, or when the daemon's answer
+         * cannot be trusted, every file is hashed.
+         *
+         * @param pathspec Limits the scan to the matching files.
+         * @return A map of filenames to FileInfo objects for every matching file in the working tree.
+         */
+        std::unordered_map<std::string, FileInfo> scan_working_tree(const Pathspec &pathspec = Pathspec());
+
+        /**
+         * Builds the file map of the working tree with the help of the fsmonitor daemon.
+         *
+         * @param pathspec Limits the scan to the matching files.
+         * @return A map of filenames to FileInfo objects for every matching file, or an empty optional when no
+         *         daemon is running.
+         */
+        std::optional<std::unordered_map<std::string, FileInfo>> scan_with_fsmonitor(const Pathspec &pathspec);
+
+        /**
+         * Checks whether the working tree matches the index, stopping at the first difference found.
+         *
+         * Cheap checks (staged entries, untracked files, file count, sizes) come before hashing, and files whose
+         * modification time proves them unchanged are not hashed at all.
+         *
+         * @return True if nothing in the working tree differs from the index.
+         */
+        bool is_working_tree_clean();
     };
 
 } // namespace manager
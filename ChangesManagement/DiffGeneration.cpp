@@ -2,75 +2,193 @@
 // Created by thaiku on 05/12/24.
 //
 #include <regex>
-#include <future>
 #include <iostream>
 #include <utility>
 
 #include "JitActions.h"
 #include "data.h"
 #include "IndexFileParser.h"
+#include "../CommitManagement/SnapshotStore.h"
+#include "../JitUtility/worker_pool.h"
 
 namespace manager {
 
-    /**
-     * Print the differences between files, showing additions and deletions in a diff-like format.
-     *
-     * @param diff A map where the key is the file name, and the value is a vector of strings representing the differences.
-     *             Lines starting with '+' are additions, while lines starting with '-' are deletions.
-     */
-    void jit_print_diff(const std::map<std::string, std::vector<std::string>> &diff) {
-        for (const auto &[file_name, changes] : diff) {
-            std::cout << CYAN << "diff --jit a/" << file_name << " b/" << file_name << RESET << std::endl;
-
-            for (const auto &line : changes) {
-                if (line.empty()) continue;
-
-                if (line[0] == '+') {
-                    std::cout << GREEN << line << RESET << std::endl;
-                } else if (line[0] == '-') {
-                    std::cout << RED << line << RESET << std::endl;
-                } else {
-                    std::cout << line << std::endl;
-                }
+    namespace {
+        void append_hunk_range(std::string &buffer, size_t begin, size_t count) {
+            // An empty range is given as the line before it.
+            buffer.append(std::to_string(count == 0 ? begin : begin + 1));
+            if (count != 1) {
+                buffer.append(",").append(std::to_string(count));
             }
+        }
+
+        /**
+         * Renders the differences between two versions of a file as unified-diff hunks.
+         *
+         * The hunks are generated one at a time, so the output, and the time it takes, follow the size of the
+         * changes. Identical contents render as nothing.
+         *
+         * @param file_name The name of the file.
+         * @param old_lines The old content of the file.
+         * @param new_lines The new content of the file.
+         * @param options The diff algorithm, whitespace handling and number of context lines.
+         * @return The diff of the file, with its header.
+         */
+        std::string render_file_diff(const std::string &file_name, const std::vector<std::string> &old_lines,
+                                     const std::vector<std::string> &new_lines, const DiffOptions &options) {
+            std::string buffer;
+
+            auto render_hunk = [&](const DiffHunk &hunk) {
+                if (buffer.empty()) {
+                    buffer.append(CYAN).append("diff --jit a/").append(file_name).append(" b/").append(file_name)
+                          .append(RESET).append("\n--- a/").append(file_name).append("\n+++ b/").append(file_name)
+                          .append("\n");
+                }
+
+                buffer.append(CYAN).append("@@ -");
+                append_hunk_range(buffer, hunk.old_begin, hunk.old_count);
+                buffer.append(" +");
+                append_hunk_range(buffer, hunk.new_begin, hunk.new_count);
+                buffer.append(" @@").append(RESET).append("\n");
+
+                for (const auto &line: hunk.lines) {
+                    if (line.type == ' ') {
+                        buffer.append(" ").append(line.text).append("\n");
+                    } else {
+                        buffer.append(line.type == '+' ? GREEN : RED).append(1, line.type).append(line.text)
+                              .append(RESET).append("\n");
+                    }
+                }
+            };
 
-            std::cout << std::endl;
+            compute_diff(old_lines, new_lines, options.algorithm, options.whitespace, options.context_lines,
+                         render_hunk);
+            return buffer;
         }
-    }
 
-    /**
-     * Get the changed files between two sets of file maps, comparing file content based on checksum.
-     * Returns a map where the key is the file name and the value is a pair of original and updated file content.
-     *
-     * @param map1 A map containing the file information for the first set of files.
-     * @param map2 A map containing the file information for the second set of files.
-     * @return A map of filenames with pairs of their content before and after the changes.
-     */
-    std::unordered_map<std::string, std::pair<std::vector<std::string>, std::vector<std::string>>>
-    JitActions::get_changed_files_data(const std::unordered_map<std::string, FileInfo> &map1,
-                                       std::unordered_map<std::string, FileInfo> map2) {
-        std::unordered_map<std::string, std::pair<std::vector<std::string>, std::vector<std::string>>> result;
-
-        for (const auto &[file_name, file_info] : map1) {
-            if (!(map2.contains(file_name) && map2[file_name].checksum == file_info.checksum)) {
-                // Retrieve file content for both versions
-                auto v1 = read_binary_as_text(get_jit_root() + "/objects/" + generate_file_path(file_info.checksum).string());
-                auto v2 = map2.contains(file_name)
-                          ? read_binary_as_text(get_jit_root() + "/objects/" + generate_file_path(map2[file_name].checksum).string())
-                          : std::vector<std::string>{};
-
-                result[file_name] = {v1, v2};
+        constexpr size_t STAT_LINE_WIDTH = 80;       ///< Columns `--stat` fits its lines into.
+        constexpr size_t STAT_MIN_GRAPH_WIDTH = 10;  ///< Columns kept for the `--stat` bars, however long the paths.
+
+        /**
+         * A file that differs between the two sides of a diff.
+         */
+        struct ChangedFile {
+            std::string name;
+            std::string old_id;  ///< Content id on the old side, empty if the file does not exist there.
+            std::string new_id;  ///< Content id on the new side, empty if the file does not exist there.
+        };
+
+        /**
+         * Reads the old and the new content of the file at an index of the list.
+         */
+        using ContentLoader = std::function<std::pair<std::vector<std::string>, std::vector<std::string>>(size_t)>;
+
+        /**
+         * Prints the `--stat` summary: a line per file with its number of changed lines and a bar of `+` and `-`,
+         * scaled down when the largest change does not fit, then the totals.
+         *
+         * @param files The changed files.
+         * @param stats The added and deleted lines of each file.
+         */
+        void print_diff_stat(const std::vector<ChangedFile> &files, const std::vector<DiffStat> &stats) {
+            size_t name_width = 0, max_changes = 0, added = 0, deleted = 0;
+            for (size_t file = 0; file < files.size(); ++file) {
+                name_width = std::max(name_width, files[file].name.size());
+                max_changes = std::max(max_changes, stats[file].added + stats[file].deleted);
+                added += stats[file].added;
+                deleted += stats[file].deleted;
+            }
+
+            // " <name> | <count> <bar>"
+            size_t count_width = std::to_string(max_changes).size();
+            size_t graph_width = std::max(STAT_MIN_GRAPH_WIDTH,
+                                          STAT_LINE_WIDTH - std::min(STAT_LINE_WIDTH, name_width + count_width + 5));
+            auto scale = [&](size_t changes) {
+                return max_changes <= graph_width || changes == 0 ? changes
+                                                                  : 1 + changes * (graph_width - 1) / max_changes;
+            };
+
+            std::string output;
+            for (size_t file = 0; file < files.size(); ++file) {
+                std::string count = std::to_string(stats[file].added + stats[file].deleted);
+                // The smaller side is scaled and the larger one gets the rest, so that both stay visible.
+                size_t bar = scale(stats[file].added + stats[file].deleted);
+                if (bar < 2 && stats[file].added > 0 && stats[file].deleted > 0) {
+                    bar = 2;
+                }
+                size_t plus = stats[file].added < stats[file].deleted ? scale(stats[file].added)
+                                                                      : bar - scale(stats[file].deleted);
+                size_t minus = bar - plus;
+
+                output.append(" ").append(files[file].name).append(name_width - files[file].name.size(), ' ')
+                      .append(" | ").append(count_width - count.size(), ' ').append(count).append(" ")
+                      .append(GREEN).append(plus, '+').append(RED).append(minus, '-').append(RESET).append("\n");
             }
-            map2.erase(file_name); // Erase processed files
-        }
 
-        // Remaining files in map2 are new additions
-        for (const auto &[file_name, file_info] : map2) {
-            auto v2 = read_binary_as_text(get_jit_root() + "/objects/" + generate_file_path(file_info.checksum).string());
-            result[file_name] = {{}, v2};
+            output.append(" ").append(std::to_string(files.size())).append(files.size() == 1 ? " file" : " files")
+                  .append(" changed");
+            if (added > 0) {
+                output.append(", ").append(std::to_string(added)).append(added == 1 ? " insertion(+)" : " insertions(+)");
+            }
+            if (deleted > 0) {
+                output.append(", ").append(std::to_string(deleted))
+                      .append(deleted == 1 ? " deletion(-)" : " deletions(-)");
+            }
+            std::cout << output << "\n";
         }
 
-        return result;
+        /**
+         * Prints the changed files in list order, in the format of the options.
+         *
+         * `--name-status` comes from the content ids alone and reads no file. The other formats load and diff each
+         * file on a pool of worker threads. Patches are rendered into one buffer per file, and a file is printed as
+         * soon as it and every file before it are done, so the output starts early and is the same whatever the
+         * scheduling. `--stat` and `--numstat` only count the lines outside the common runs.
+         *
+         * @param files The changed files.
+         * @param thread_count The number of worker threads, 0 for one per hardware thread.
+         * @param options How the files are compared and printed.
+         * @param load Reads the old and the new content of a file.
+         */
+        void print_changed_files(const std::vector<ChangedFile> &files, size_t thread_count,
+                                 const DiffOptions &options, const ContentLoader &load) {
+            thread_count = resolve_thread_count(thread_count, files.size());
+            auto print = [](size_t, std::string &output) {
+                std::cout.write(output.data(), static_cast<std::streamsize>(output.size()));
+            };
+
+            switch (options.format) {
+                case DiffFormat::NAME_STATUS:
+                    for (const auto &file: files) {
+                        std::cout << (file.old_id.empty() ? 'A' : file.new_id.empty() ? 'D' : 'M') << "\t"
+                                  << file.name << "\n";
+                    }
+                    break;
+                case DiffFormat::NUMSTAT:
+                    run_in_parallel_ordered(files.size(), thread_count, [&](size_t, size_t file) {
+                        auto [old_lines, new_lines] = load(file);
+                        DiffStat stat = count_diff(old_lines, new_lines, options.algorithm, options.whitespace);
+                        return std::to_string(stat.added) + "\t" + std::to_string(stat.deleted) + "\t" +
+                               files[file].name + "\n";
+                    }, print);
+                    break;
+                case DiffFormat::STAT: {
+                    std::vector<DiffStat> stats(files.size());
+                    run_in_parallel(files.size(), thread_count, [&](size_t, size_t file) {
+                        auto [old_lines, new_lines] = load(file);
+                        stats[file] = count_diff(old_lines, new_lines, options.algorithm, options.whitespace);
+                    });
+                    print_diff_stat(files, stats);
+                    break;
+                }
+                default:
+                    run_in_parallel_ordered(files.size(), thread_count, [&](size_t, size_t file) {
+                        auto [old_lines, new_lines] = load(file);
+                        return render_file_diff(files[file].name, old_lines, new_lines, options);
+                    }, print);
+            }
+            std::cout << std::flush;
+        }
     }
 
     /**
@@ -78,16 +196,18 @@ namespace manager {
      *
      * @param branch_name A string representing the branch comparison (e.g., "branch1..branch2").
      *                    If the format is incorrect, it attempts to use the current HEAD and the given branch.
+     * @param pathspec Limits the diff to the matching files.
+     * @param options How the files are compared.
      */
-    void JitActions::jit_diff(const std::string &branch_name) {
+    void JitActions::jit_diff(const std::string &branch_name, const Pathspec &pathspec, const DiffOptions &options) {
         std::regex diff_branch_extractor(R"(([A-Za-z0-9\._\-]+)\.\.([A-Za-z0-9\._\-]+))");
         std::smatch match;
 
         if (std::regex_search(branch_name, match, diff_branch_extractor)) {
-            jit_diff(match[1], match[2]);
+            jit_diff(match[1], match[2], pathspec, options);
         } else {
             std::string head = get_head();
-            jit_diff(std::regex_replace(head, std::regex(".+/"), ""), branch_name);
+            jit_diff(std::regex_replace(head, std::regex(".+/"), ""), branch_name, pathspec, options);
         }
     }
 
@@ -96,97 +216,88 @@ namespace manager {
      *
      * @param branch1 The first branch to compare.
      * @param branch2 The second branch to compare.
+     * @param pathspec Limits the diff to the matching files.
+     * @param options How the files are compared.
      */
-    void JitActions::jit_diff(const std::string &branch1, const std::string &branch2) {
-        // Create temporary files for branch indices
-        auto branch1_index_temp = create_temp_file(get_branch_head(branch1));
-        auto branch2_index_temp = create_temp_file(get_branch_head(branch2));
-
-        // Read file maps from indices
-        auto branch1_content = IndexFileParser(branch1_index_temp).read_index_file();
-        auto branch2_content = IndexFileParser(branch2_index_temp).read_index_file();
-
-        // Get changed files data
-        auto changed_files_data = get_changed_files_data(branch1_content.files_map, branch2_content.files_map);
-
-        // Compute diffs for changed files
-        std::map<std::string, std::vector<std::string>> diff;
-        for (const auto &[file_name, file_data] : changed_files_data) {
-            diff[file_name] = compute_diff(file_data.first, file_data.second);
-        }
-
-        jit_print_diff(diff);
-        fs::remove_all(get_root_directory() + "/temp/");
+    void JitActions::jit_diff(const std::string &branch1, const std::string &branch2, const Pathspec &pathspec,
+                              const DiffOptions &options) {
+        std::string objects_directory = get_jit_root() + "/objects";
+        auto read_object = [&objects_directory](const std::string &id) {
+            return id.empty() ? std::vector<std::string>{}
+                              : read_binary_as_text(objects_directory + "/" + generate_file_path(id).string());
+        };
+
+        // Only the subtrees whose ids differ between the two commits are read; they are reported in path order.
+        std::vector<ChangedFile> files;
+        SnapshotStore(objects_directory).diff_commits(
+                get_branch_head(branch1), get_branch_head(branch2), pathspec,
+                [&](const std::string &file_name, const std::string &old_id, const std::string &new_id) {
+                    files.push_back({file_name, old_id, new_id});
+                });
+
+        print_changed_files(files, get_config_number("core.threads", 0), options, [&](size_t file) {
+            return std::make_pair(read_object(files[file].old_id), read_object(files[file].new_id));
+        });
     }
 
     /**
      * Print differences between the current working directory and the repository state.
      * It checks the modified, deleted, and staged files, and shows the differences.
+     *
+     * @param pathspec Limits the diff to the matching files; only those are scanned and compared.
+     * @param options How the files are compared.
      */
-    void JitActions::jit_diff() {
-        const auto status = repo_status();
+    void JitActions::jit_diff(const Pathspec &pathspec, const DiffOptions &options) {
+        const auto status = repo_status(pathspec);
 
         if (status.modified_files.empty() && status.deleted_files.empty() && status.staged_files.empty()) {
             throw std::runtime_error("No diff to show");
         }
 
-        // Launch asynchronous tasks to fetch original file content
-        auto modified_files_future = std::async(std::launch::async, [this]() { return get_changed_files_content(); });
-
-
-        // Prepare current file content
-        std::map<std::string, std::vector<std::string>> current_content;
+        // Only the files that differ from the index are looked up in HEAD, reading just the trees on their path.
+        std::string head = get_head();
+        std::string head_commit = head.starts_with("refs") ?
+                                  get_branch_head(std::regex_replace(head, std::regex(".+/"), "")) : head;
+        std::string objects_directory = get_jit_root() + "/objects";
+        SnapshotStore store(objects_directory);
+        // Before the first commit HEAD holds the null id, and every file is new.
+        bool has_head = has_commit_object(head_commit);
+        auto head_file_id = [&](const std::string &filename) {
+            return has_head ? store.get_file_id(head_commit, filename) : std::string();
+        };
+
+        // The files to diff, in path order; deleted files have no new content.
+        std::map<std::string, std::string> working_ids;
         for (const auto &file_set : {status.modified_files, status.staged_files}) {
             for (const auto &file : file_set) {
-                current_content[file.filename] = read_file_to_vector(get_root_directory() + "/" + file.filename);
+                working_ids[file.filename] = file.checksum;
             }
         }
-
-        // Add deleted files with empty content
         for (const auto &deleted_file : status.deleted_files) {
-            current_content[deleted_file.filename] = {};
-        }
-
-        // Fetch original file content
-        auto modified_files_content = modified_files_future.get();
-
-
-        // Merge original content into a single map
-        const std::map<std::string, std::vector<std::string>>& original_files = modified_files_content;
-
-
-        // Calculate diffs
-        std::map<std::string, std::vector<std::string>> diff_content_per_file;
-        for (const auto &[filename, current_lines] : current_content) {
-            const auto &original_lines = original_files.contains(filename) ? original_files.at(filename) : std::vector<std::string>{};
-            diff_content_per_file[filename] = compute_diff(original_lines, current_lines);
+            working_ids[deleted_file.filename] = "";
         }
 
-        jit_print_diff(diff_content_per_file);
-    }
-
-    /**
-     * Retrieve the content of all files from the repository as a map of filenames to their content.
-     * This method collects the file content for all files tracked in the repository at the current HEAD.
-     *
-     * @return A map where the key is the filename, and the value is a vector of strings representing the file's content.
-     */
-    std::map<std::string, std::vector<std::string>> JitActions::get_changed_files_content() {
-        std::string head = get_head();
-        fs::create_directory(get_root_directory() + "/temp");
-
-        if (head.starts_with("refs")) {
-            head = get_branch_head(std::regex_replace(head, std::regex(".+/"), ""));
+        std::vector<ChangedFile> files;
+        for (const auto &[filename, working_id] : working_ids) {
+            std::string original_id = head_file_id(filename);
+            if (original_id != working_id) {
+                files.push_back({filename, original_id, working_id});
+            }
         }
 
-        IndexFileContent content = IndexFileParser(create_temp_file(head)).read_index_file();
-        std::map<std::string, std::vector<std::string>> files_content;
-
-        for (const auto &[_, file_info] : content.files_map) {
-            std::string filename = get_jit_root() + "/objects/" + generate_file_path(file_info.checksum).string();
-            files_content[file_info.filename] = read_binary_as_text(filename);
-        }
+        // Each file's HEAD object is inflated by its own task, so the cost follows the number of changed files.
+        print_changed_files(files, get_config_number("core.threads", 0), options, [&](size_t file) {
+            std::vector<std::string> original_lines;
+            if (!files[file].old_id.empty()) {
+                original_lines = read_binary_as_text(objects_directory + "/" +
+                                                     generate_file_path(files[file].old_id).string());
+            }
 
-        return files_content;
+            std::vector<std::string> current_lines;
+            if (!files[file].new_id.empty()) {
+                current_lines = read_file_to_vector(get_root_directory() + "/" + files[file].name);
+            }
+            return std::make_pair(std::move(original_lines), std::move(current_lines));
+        });
     }
 }
@@ -35,7 +35,7 @@ namespace manager {
                     file.second.is_dirty = true;
                     file.second.is_new = false;
                     a_file_changed = true;
-                    files.insert(file);
+                    files[file.first] = file.second;
                 }
             } else {
                 file.second.is_dirty = true;
@@ -123,8 +123,22 @@ namespace manager {
             file << "checksum = " << fileInfo.checksum << "\n";
             file << "addition_date = " << time_point_to_string(fileInfo.addition_date) << "\n";
             file << "last_modified = " << time_point_to_string(fileInfo.last_modified) << "\n";
+            if (fileInfo.size) {
+                file << "size = " << *fileInfo.size << "\n";
+            }
             file << "is_dirty = " << (fileInfo.is_dirty ? "true" : "false") << "\n";
             file << "is_new = " << (fileInfo.is_new ? "true" : "false") << "\n";
+            if (fileInfo.skip_worktree) {
+                file << "skip_worktree = true\n";
+            }
+            file << "\n";
+        }
+
+        // Write the directories collapsed by the sparse index
+        for (const auto &[directory, checksum]: content.sparse_directories) {
+            file << "\n[SPARSE_DIRECTORY]\n";
+            file << "directory = " << directory << "\n";
+            file << "checksum = " << checksum << "\n";
             file << "\n";
         }
         file.close();
@@ -150,6 +164,8 @@ namespace manager {
         std::string line;
         FileInfo tempFileInfo;
         bool readingFiles = false;
+        bool readingSparseDirectory = false;
+        std::string sparseDirectory;
 
         while (std::getline(file, line)) {
             line.erase(0, line.find_first_not_of(" \t"));
@@ -159,6 +175,17 @@ namespace manager {
                 readingFiles = false;
             } else if (line == "[ENTRY]") {
                 readingFiles = true;
+            } else if (line == "[SPARSE_DIRECTORY]") {
+                readingSparseDirectory = true;
+            } else if (readingSparseDirectory && line.find('=') != std::string::npos) {
+                auto delimiterPos = line.find('=');
+                std::string key = line.substr(0, delimiterPos);
+                std::string value = line.substr(delimiterPos + 1);
+                key.erase(key.find_last_not_of(" \t") + 1);
+                value.erase(0, value.find_first_not_of(" \t"));
+
+                if (key == "directory") sparseDirectory = value;
+                else if (key == "checksum") content.sparse_directories[sparseDirectory] = value;
             } else if (line.find('=') != std::string::npos) {
                 auto delimiterPos = line.find('=');
                 std::string key = line.substr(0, delimiterPos);
@@ -177,14 +204,18 @@ namespace manager {
                     else if (key == "checksum") tempFileInfo.checksum = value;
                     else if (key == "addition_date") tempFileInfo.addition_date = string_to_time_point(value);
                     else if (key == "last_modified") tempFileInfo.last_modified = string_to_time_point(value);
+                    else if (key == "size") tempFileInfo.size = std::stoull(value);
                     else if (key == "is_dirty") tempFileInfo.is_dirty = (value == "true");
                     else if (key == "is_new") tempFileInfo.is_new = (value == "true");
+                    else if (key == "skip_worktree") tempFileInfo.skip_worktree = (value == "true");
                 }
             } else if (line.empty() && readingFiles) {
                 readingFiles = false;
                 content.files_map[tempFileInfo.filename] = tempFileInfo;
 
                 tempFileInfo = FileInfo{};
+            } else if (line.empty()) {
+                readingSparseDirectory = false;
             }
         }
 
@@ -262,8 +293,10 @@ namespace manager {
                         else if (key == "checksum") tempFileInfo.checksum = value;
                         else if (key == "addition_date") tempFileInfo.addition_date = string_to_time_point(value);
                         else if (key == "last_modified") tempFileInfo.last_modified = string_to_time_point(value);
+                        else if (key == "size") tempFileInfo.size = std::stoull(value);
                         else if (key == "is_dirty") tempFileInfo.is_dirty = (value == "true");
                         else if (key == "is_new") tempFileInfo.is_new = (value == "true");
+                        else if (key == "skip_worktree") tempFileInfo.skip_worktree = (value == "true");
                     }
                 } else if (line.empty() && readingFiles) {
                     readingFiles = false;
@@ -3,15 +3,28 @@
 //
 
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <regex>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "JitActions.h"
 #include "IndexFileParser.h"
 #include "../CommitManagement/commit.h"
+#include "../CommitManagement/ChangedPathFilter.h"
 #include "../CommitManagement/CommitGraph.h"
+#include "../CommitManagement/ReachabilityBitmaps.h"
+#include "../CommitManagement/RevisionWalker.h"
+#include "../CommitManagement/SnapshotStore.h"
 
 namespace manager {
 
+    namespace {
+        constexpr size_t LOG_BUFFER_SIZE = 64 * 1024;  ///< Bytes of log output held before writing them out.
+    }
+
     /**
      * Constructor initializes JitActions with the root directory and validates the Jit root.
      *
@@ -36,6 +49,17 @@ namespace manager {
         return head;
     }
 
+    /**
+     * Checks whether a commit id names a commit stored in the repository.
+     *
+     * @param commit The commit id.
+     * @return True if the commit object exists; false for an empty or null id.
+     */
+    bool JitActions::has_commit_object(const std::string &commit) {
+        return commit.size() == 40 &&
+               fs::exists(get_jit_root() + "/objects/" + generate_file_path(commit).string());
+    }
+
     /**
      * Reads and returns the head of a specific branch.
      *
@@ -71,47 +95,121 @@ namespace manager {
 
         indexFileParser.prepare_commit_index_file();
         indexFileParser.write_index_file();
+        IndexFileContent committed_content = indexFileParser.read_index_file();
 
-        std::string index_checksum = generateSHA1(get_jit_root() + "/index");
         std::string head = get_head();
-
         std::string old_checksum;
 
-
         if (head.starts_with("refs")) {
-            std::string branch_name = std::regex_replace(head, std::regex(".+/"), "");
-
-            old_checksum = get_branch_head(branch_name);
-            update_branch_head_file(branch_name, index_checksum);
+            old_checksum = get_branch_head(std::regex_replace(head, std::regex(".+/"), ""));
         }
 
+        std::string commit_checksum = write_commit_object(committed_content, {old_checksum}, message);
 
-        // Save the commit as a binary object and update the log.
-        save_as_binary(get_jit_root() + "/objects", index_checksum, get_jit_root() + "/index");
-        jit_log(get_jit_root() + "/logs/" + head, old_checksum, index_checksum, "commit: " + message);
+        if (head.starts_with("refs")) {
+            update_branch_head_file(std::regex_replace(head, std::regex(".+/"), ""), commit_checksum);
+        }
+        jit_log(get_jit_root() + "/logs/" + head, old_checksum, commit_checksum, "commit: " + message);
 
         std::string commit_file_path = get_jit_root() + "/objects/" + generate_file_path(COMMIT_FILE_HASH).string();
 
         CommitGraph commit_graph(commit_file_path);
 
         Commit commit;
-        commit.checksum = index_checksum;
+        commit.checksum = commit_checksum;
         commit.message = message;
         commit.timestamp = std::chrono::system_clock::now();
+        auto parent_commit = commit_graph.get_commit(old_checksum);
         commit.branch_name = head.starts_with("refs") ? std::regex_replace(head, std::regex(".+/"), "") :
-                             commit_graph.get_commit(old_checksum) !=
-                             nullptr ? commit_graph.get_commit(old_checksum)->branch_name : "wild";
+                             parent_commit ? std::string(commit_graph.get_branch_name(*parent_commit)) : "wild";
+
+        commit.changed_paths = get_changed_paths_filter(old_checksum, commit_checksum);
 
         commit_graph.add_commit(commit, {old_checksum});
-        commit_graph.save_commits(commit_file_path);
+        compact_commit_graph_in_background(commit_graph);
 
         if (head.starts_with("refs")) {
             update_head_file(head);
         } else {
-            update_head_file(index_checksum);
+            update_head_file(commit_checksum);
+        }
+    }
+
+    /**
+     * Starts `jit commit-graph write` in a detached process if the commit graph needs compacting.
+     *
+     * The executable is started again rather than the compaction run in a fork of this process: a fork only gets the
+     * calling thread, and a lock held by another worker thread at that moment would never be released in the child.
+     * Between fork and exec the child only makes async-signal-safe calls.
+     *
+     * @param commit_graph The commit graph a commit was just added to.
+     */
+    void JitActions::compact_commit_graph_in_background(const CommitGraph &commit_graph) {
+        if (!commit_graph.needs_compaction()) {
+            return;
+        }
+
+        char *const arguments[] = {const_cast<char *>("jit"), const_cast<char *>("commit-graph"),
+                                   const_cast<char *>("write"), nullptr};
+
+        // Double fork so that the compaction is not left as a zombie of a long-running caller.
+        pid_t child = fork();
+        if (child == 0) {
+            if (fork() == 0) {
+                setsid();
+                int null_fd = open("/dev/null", O_RDWR);
+                if (null_fd >= 0) {
+                    dup2(null_fd, STDIN_FILENO);
+                    dup2(null_fd, STDOUT_FILENO);
+                    dup2(null_fd, STDERR_FILENO);
+                    close(null_fd);
+                }
+                execv("/proc/self/exe", arguments);
+            }
+            _exit(0);
+        } else if (child > 0) {
+            waitpid(child, nullptr, 0);
         }
     }
 
+    /**
+     * Builds the changed-path filter of a commit. Only the subtrees whose ids differ from the parent's are read.
+     *
+     * @param parent The first parent, or an empty or null id for a root commit.
+     * @param commit The commit.
+     * @return The filter bytes.
+     */
+    std::string JitActions::get_changed_paths_filter(const std::string &parent, const std::string &commit) {
+        std::string objects_directory = get_jit_root() + "/objects";
+        bool has_parent = has_commit_object(parent);
+
+        std::vector<std::string> changed_files;
+        SnapshotStore(objects_directory).diff_commits(has_parent ? parent : "", commit, Pathspec(),
+                                                      [&changed_files](const std::string &path, const std::string &,
+                                                                       const std::string &) {
+                                                          changed_files.push_back(path);
+                                                      });
+        return ChangedPathFilter::build(changed_files);
+    }
+
+    /**
+     * Stores the tree objects of an index and a commit object pointing at its root tree.
+     *
+     * Directories collapsed by the sparse index are already trees and are used as they are. Only the trees that
+     * changed since the parent commit are new objects; the others already exist under the same id.
+     *
+     * @param content The index content to commit.
+     * @param parents The parent commits.
+     * @param message The commit message.
+     * @return The id of the new commit.
+     */
+    std::string JitActions::write_commit_object(IndexFileContent content, const std::vector<std::string> &parents,
+                                                const std::string &message) {
+        SnapshotStore store(get_jit_root() + "/objects");
+        std::string tree_id = store.write_tree(content.files_map, content.sparse_directories);
+        return store.write_commit(tree_id, parents, message);
+    }
+
     /**
      * Updates the HEAD file with a new reference.
      *
@@ -188,32 +286,32 @@ namespace manager {
      */
     void JitActions::checkout_to_a_commit(const std::string &target) {
         fs::path objects_path = fs::path(get_jit_root() + "/objects");
-        fs::path path = objects_path / generate_file_path(target);
         std::string current_head = target;
-
-        // Check if target is a branch.
-        if (!fs::exists(path)) {
-            std::ifstream branch_file(get_jit_root() + "/refs/heads/" + target);
-            if (branch_file) {
-                std::string branch_head;
-                std::getline(branch_file, branch_head);
-                path = objects_path / generate_file_path(branch_head);
-                current_head = "refs/heads/" + target;
-            } else {
+        std::string commit_id;
+
+        // Check if target is a full commit id, then a branch, then an abbreviated commit id.
+        if (target.size() == 40 && fs::exists(objects_path / generate_file_path(target))) {
+            commit_id = target;
+        } else if (fs::exists(get_jit_root() + "/refs/heads/" + target)) {
+            commit_id = get_branch_head(target);
+            current_head = "refs/heads/" + target;
+        } else {
+            commit_id = resolve_commit(target);
+            if (commit_id.size() != 40) {
                 throw std::runtime_error("Target " + target + " was not found!");
             }
+            current_head = commit_id;
         }
 
         throw_error_if_repo_is_dirty();
 
         // Perform checkout if target exists.
-        if (fs::exists(path)) {
-            decompress_and_copy(path, get_jit_root() + "/index");
-
-            IndexFileParser indexFileParser(get_jit_root() + "/index");
-            IndexFileContent content = indexFileParser.read_index_file();
+        if (fs::exists(objects_path / generate_file_path(commit_id))) {
+            std::string head = get_head();
+            std::string head_commit = head.starts_with("refs") ?
+                                      get_branch_head(std::regex_replace(head, std::regex(".+/"), "")) : head;
 
-            checkout(content);
+            checkout(head_commit, commit_id);
 
             std::cout << "Head now at " << target << std::endl;
             update_head_file(current_head);
@@ -222,45 +320,191 @@ namespace manager {
         }
     }
 
-    void JitActions::checkout(const IndexFileContent &content) {
-
+    /**
+     * Replaces the whole working tree with the files of an index.
+     *
+     * Every file on disk that is not in the index is deleted and every entry inside the sparse checkout is written;
+     * the others are flagged skip-worktree.
+     *
+     * @param content The index content to check out.
+     */
+    void JitActions::checkout(IndexFileContent content) {
+        const SparseCheckout sparse_checkout = get_sparse_checkout();
         std::set<std::string> current_files = transform_file_names();
-        std::map<std::string, std::string> files_to_replace;
+        std::map<std::string, std::string> files_to_write;
         fs::path objects_path(get_jit_root() + "/objects");
 
-        for (const auto &[_, file_info]: content.files_map) {
-            current_files.erase(file_info.filename);
-            files_to_replace.emplace(
-                    objects_path / generate_file_path(file_info.checksum), file_info.filename);
+        for (const auto &[file_name, file_info]: content.files_map) {
+            current_files.erase(file_name);
+            if (sparse_checkout.includes(file_name)) {
+                files_to_write[file_name] = (objects_path / generate_file_path(file_info.checksum)).string();
+            }
         }
 
-        update_repository(current_files, files_to_replace);
+        update_repository(current_files, files_to_write);
+        write_checkout_index(content, files_to_write);
     }
 
     /**
-     * Prints the commit log for the current branch.
+     * Moves the working tree from one commit to another.
      *
-     * @throws std::runtime_error if the HEAD file cannot be opened.
+     * The two commits are compared tree by tree, so identical subtrees are skipped without being read and only the
+     * files that differ are written or deleted. The working tree must match `from_commit`; when there is no such
+     * commit yet, the whole snapshot is checked out instead.
+     *
+     * @param from_commit The commit the working tree currently matches.
+     * @param to_commit The commit to check out.
      */
-    void JitActions::jit_commit_log() {
-        std::ifstream head_file(get_jit_root() + "/HEAD");
-        if (!head_file) {
-            throw std::runtime_error("Could not open the HEAD file");
+    void JitActions::checkout(const std::string &from_commit, const std::string &to_commit) {
+        fs::path objects_path(get_jit_root() + "/objects");
+        SnapshotStore store(objects_path.string());
+        IndexFileContent content = store.read_snapshot(to_commit);
+
+        if (from_commit.empty() || !fs::exists(objects_path / generate_file_path(from_commit))) {
+            checkout(content);
+            return;
         }
 
-        std::string head;
-        std::getline(head_file, head);
+        const SparseCheckout sparse_checkout = get_sparse_checkout();
+        std::set<std::string> files_to_delete;
+        std::map<std::string, std::string> files_to_write;
+
+        store.diff_commits(from_commit, to_commit, Pathspec(),
+                           [&](const std::string &path, const std::string &, const std::string &new_id) {
+                               if (!sparse_checkout.includes(path)) {
+                                   return;
+                               }
+                               if (new_id.empty()) {
+                                   files_to_delete.insert(path);
+                               } else {
+                                   files_to_write[path] = (objects_path / generate_file_path(new_id)).string();
+                               }
+                           });
+
+        update_repository(files_to_delete, files_to_write);
+        write_checkout_index(content, files_to_write);
+    }
 
+    /**
+     * Writes the index after a checkout.
+     *
+     * Entries outside the sparse checkout are flagged skip-worktree so that status does not report them as deleted.
+     * The size and modification time of the files just written are recorded, and those of the files left untouched
+     * are kept from the previous index, so that the next clean check does not have to hash them.
+     *
+     * @param content The index content that was checked out.
+     * @param written_files The files written by the checkout.
+     */
+    void JitActions::write_checkout_index(IndexFileContent content,
+                                          const std::map<std::string, std::string> &written_files) {
+        const SparseCheckout sparse_checkout = get_sparse_checkout();
+        IndexFileParser parser(get_jit_root() + "/index");
+        IndexFileContent previous_content = fs::exists(get_jit_root() + "/index") ? parser.read_index_file()
+                                                                                 : IndexFileContent{};
+
+        for (auto &[file_name, file_info]: content.files_map) {
+            file_info.skip_worktree = !sparse_checkout.includes(file_name);
+
+            auto previous_entry = previous_content.files_map.find(file_name);
+            if (!file_info.skip_worktree && !written_files.contains(file_name) &&
+                previous_entry != previous_content.files_map.end() &&
+                previous_entry->second.checksum == file_info.checksum) {
+                file_info.addition_date = previous_entry->second.addition_date;
+                file_info.last_modified = previous_entry->second.last_modified;
+                file_info.size = previous_entry->second.size;
+            }
+        }
+
+        std::vector<std::string> file_names;
+        for (const auto &[file_name, _]: written_files) {
+            file_names.push_back(file_name);
+        }
+
+        auto scan_results = scan_files(file_names, false);
+        for (size_t i = 0; i < file_names.size(); ++i) {
+            if (scan_results[i].exists) {
+                auto &file_info = content.files_map.at(file_names[i]);
+                file_info.last_modified = scan_results[i].last_modified;
+                file_info.size = scan_results[i].size;
+            }
+        }
+
+        collapse_sparse_index(content);
+        parser.write_index_file(content);
+    }
+
+    /**
+     * Prints the commits selected by a list of revisions, newest first.
+     *
+     * A revision is a branch or commit to start from, `^<commit>` to leave out a commit and its ancestors,
+     * `A..B` for the commits of B that are not in A, or `A...B` for the commits of either that are not in both. An
+     * empty side stands for HEAD. The commits are walked lazily and written through a buffer, so that the first ones
+     * are printed without reading the rest of the history.
+     *
+     * @param revisions The revisions to walk; HEAD if empty.
+     * @param options The filters and ordering of the log.
+     */
+    void JitActions::jit_commit_log(const std::vector<std::string> &revisions, const LogOptions &options) {
         std::string commit_file_path = get_jit_root() + "/objects/" + generate_file_path(COMMIT_FILE_HASH).string();
         CommitGraph commitGraph(commit_file_path);
+        SnapshotStore store(get_jit_root() + "/objects");
+        RevisionWalker walker(commitGraph, store, options);
 
-        if (head.starts_with("refs")) {
-            head = get_branch_head(std::regex_replace(head, std::regex(".+/"), ""));
+        auto find = [&commitGraph, this](const std::string &revision) {
+            auto position = commitGraph.get_commit(resolve_commit(revision));
+            if (!position) {
+                throw std::runtime_error("Unknown revision: " + revision);
+            }
+            return *position;
+        };
+
+        for (const auto &revision: revisions.empty() ? std::vector<std::string>{""} : revisions) {
+            size_t range = revision.find("..");
+            if (range == std::string::npos) {
+                if (revision.starts_with("^")) {
+                    walker.hide(find(revision.substr(1)));
+                } else {
+                    walker.push(find(revision));
+                }
+            } else if (revision.compare(range, 3, "...") == 0) {
+                uint32_t first = find(revision.substr(0, range));
+                uint32_t second = find(revision.substr(range + 3));
+                walker.push(first);
+                walker.push(second);
+                for (uint32_t merge_base: commitGraph.get_merge_bases(first, second)) {
+                    walker.hide(merge_base);
+                }
+            } else {
+                walker.hide(find(revision.substr(0, range)));
+                walker.push(find(revision.substr(range + 2)));
+            }
         }
 
-        commitGraph.print_commit_history(head);
+        std::string head = get_head();
+        std::string current_branch = head.starts_with("refs") ? std::regex_replace(head, std::regex(".+/"), "") : "";
+
+        std::string buffer;
+        while (auto commit = walker.next()) {
+            std::string_view branch = commitGraph.get_branch_name(*commit);
+            std::string_view author = commitGraph.get_author(*commit);
 
-//        print_commit_log(get_jit_root() + "/logs/" + head);
+            std::string checksum = commitGraph.get_checksum(*commit);
+            buffer.append(GREEN).append(checksum, 0, commitGraph.unique_prefix_length(*commit)).append(YELLOW);
+            if (!branch.empty() && branch != current_branch) {
+                buffer.append(" (").append(branch).append(")");
+            }
+            buffer.append("\n").append(BLUE).append("Author: ").append(RESET);
+            buffer.append(author.empty() ? "Unknown" : author).append("\n");
+            buffer.append(CYAN).append("Date:  ").append(RESET);
+            buffer.append(time_point_to_string(commitGraph.get_timestamp(*commit))).append("\n\n");
+            buffer.append(YELLOW).append("\t").append(commitGraph.get_message(*commit)).append(RESET).append("\n\n");
+
+            if (buffer.size() >= LOG_BUFFER_SIZE) {
+                std::cout.write(buffer.data(), static_cast<std::streamsize>(buffer.size())) << std::flush;
+                buffer.clear();
+            }
+        }
+        std::cout.write(buffer.data(), static_cast<std::streamsize>(buffer.size())) << std::flush;
     }
 
     /**
@@ -279,9 +523,13 @@ namespace manager {
     /**
      * Lists all branches, highlighting the current branch.
      *
+     * With `verbose`, every branch also shows its head, its message and, in one walk for all branches, how many
+     * commits it is ahead of and behind the current branch.
+     *
+     * @param verbose Whether to print the heads and the ahead/behind counts.
      * @throws std::runtime_error if the HEAD file cannot be opened.
      */
-    void JitActions::list_jit_branches() {
+    void JitActions::list_jit_branches(bool verbose) {
         std::string cur_branch = get_head();
         auto all_branches = get_branches();
 
@@ -289,12 +537,111 @@ namespace manager {
             cur_branch = std::regex_replace(cur_branch, std::regex(".+/"), "");
         }
 
-        for (const auto &branch: all_branches) {
-            if (branch == cur_branch) {
-                std::cout << "* " << GREEN << branch << RESET << std::endl;
-            } else {
-                std::cout << "  " << branch << std::endl;
+        if (!verbose) {
+            for (const auto &branch: all_branches) {
+                if (branch == cur_branch) {
+                    std::cout << "* " << GREEN << branch << RESET << std::endl;
+                } else {
+                    std::cout << "  " << branch << std::endl;
+                }
             }
+            return;
+        }
+
+        CommitGraph commit_graph(get_jit_root() + "/objects/" + generate_file_path(COMMIT_FILE_HASH).string());
+        auto head_position = commit_graph.get_commit(resolve_commit("HEAD"));
+
+        std::vector<std::string> branches(all_branches.begin(), all_branches.end());
+        std::vector<std::optional<uint32_t>> positions;
+        std::vector<uint32_t> tips;
+        size_t name_width = 0;
+        for (const auto &branch: branches) {
+            positions.push_back(commit_graph.get_commit(get_branch_head(branch)));
+            if (positions.back()) {
+                tips.push_back(*positions.back());
+            }
+            name_width = std::max(name_width, branch.size());
         }
+
+        std::vector<std::pair<uint32_t, uint32_t>> counts;
+        if (head_position) {
+            counts = commit_graph.ahead_behind(*head_position, tips);
+        }
+
+        std::ostringstream listing;
+        size_t tip = 0;
+        for (size_t i = 0; i < branches.size(); ++i) {
+            bool current = branches[i] == cur_branch;
+            listing << (current ? "* " : "  ") << (current ? GREEN : "") << std::left
+                    << std::setw(static_cast<int>(name_width)) << branches[i] << (current ? RESET : "") << " ";
+
+            if (!positions[i]) {
+                listing << "(no commits)\n";
+                continue;
+            }
+
+            uint32_t position = *positions[i];
+            listing << YELLOW << commit_graph.get_checksum(position).substr(0, commit_graph.unique_prefix_length(position))
+                    << RESET << " ";
+            if (head_position) {
+                auto [ahead, behind] = counts[tip];
+                if (ahead > 0 && behind > 0) {
+                    listing << "[ahead " << ahead << ", behind " << behind << "] ";
+                } else if (ahead > 0) {
+                    listing << "[ahead " << ahead << "] ";
+                } else if (behind > 0) {
+                    listing << "[behind " << behind << "] ";
+                }
+            }
+            ++tip;
+            listing << commit_graph.get_message(position) << "\n";
+        }
+        std::cout << listing.str() << std::flush;
+    }
+
+    /**
+     * Checks whether a commit can be reached from another by following parents.
+     *
+     * @param ancestor The possible ancestor, a commit or branch.
+     * @param descendant The possible descendant, a commit or branch.
+     * @throws std::runtime_error if either is not a commit.
+     */
+    bool JitActions::is_ancestor(const std::string &ancestor, const std::string &descendant) {
+        CommitGraph commit_graph(get_jit_root() + "/objects/" + generate_file_path(COMMIT_FILE_HASH).string());
+
+        auto ancestor_position = commit_graph.get_commit(resolve_commit(ancestor));
+        auto descendant_position = commit_graph.get_commit(resolve_commit(descendant));
+        if (!ancestor_position || !descendant_position) {
+            throw std::runtime_error("Not a commit: " + (ancestor_position ? descendant : ancestor));
+        }
+        return commit_graph.is_ancestor(*ancestor_position, *descendant_position);
+    }
+
+    /**
+     * Merges the commit-graph tail into the graph file.
+     */
+    void JitActions::write_commit_graph() {
+        std::string commit_file = get_jit_root() + "/objects/" + generate_file_path(COMMIT_FILE_HASH).string();
+        CommitGraph(commit_file).save_commits(commit_file);
+    }
+
+    /**
+     * Merges the commit-graph tail into the graph file and writes reachability bitmaps for every branch head, so that
+     * later reachability queries and branch clones OR stored bitmaps instead of walking the history.
+     */
+    void JitActions::gc() {
+        std::string commit_file = get_jit_root() + "/objects/" + generate_file_path(COMMIT_FILE_HASH).string();
+        CommitGraph commit_graph(commit_file);
+        commit_graph.save_commits(commit_file);
+
+        std::vector<std::string> heads;
+        for (const auto &branch: get_branches()) {
+            heads.push_back(get_branch_head(branch));
+        }
+
+        SnapshotStore store(get_jit_root() + "/objects");
+        size_t bitmap_count = ReachabilityBitmaps(commit_graph, store, commit_file + ".bitmap").write(heads);
+        std::cout << "Wrote " << bitmap_count << " reachability bitmaps for " << commit_graph.size() << " commits"
+                  << std::endl;
     }
 }
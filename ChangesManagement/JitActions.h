@@ -5,17 +5,39 @@
 #ifndef JIT_JITACTIONS_H
 #define JIT_JITACTIONS_H
 
+#include <optional>
 #include <string>
 #include <stack>
 #include <unordered_set>
 #include "../JitUtility/jit_utility.h"
 #include "ChangesManager.h"
+#include "../CommitManagement/RevisionWalker.h"
 
 
 namespace fs = std::filesystem;
 
 namespace manager {
 
+    /**
+     * What a `jit diff` prints for each changed file.
+     */
+    enum class DiffFormat {
+        PATCH,        ///< Unified-diff hunks.
+        STAT,         ///< A histogram of added and deleted lines, then totals (`--stat`).
+        NUMSTAT,      ///< Added and deleted line counts, tab-separated (`--numstat`).
+        NAME_STATUS,  ///< A, D or M and the path, from the content ids alone (`--name-status`).
+    };
+
+    /**
+     * Options of a `jit diff`.
+     */
+    struct DiffOptions {
+        DiffAlgorithm algorithm = DiffAlgorithm::AUTO;  ///< How the two versions of each file are aligned.
+        WhitespaceMode whitespace = WhitespaceMode::EXACT;  ///< Whitespace differences ignored when comparing lines.
+        size_t context_lines = DEFAULT_DIFF_CONTEXT;     ///< Unchanged lines shown around each change.
+        DiffFormat format = DiffFormat::PATCH;           ///< What is printed for each changed file.
+    };
+
     /**
      * @class JitActions
      * @brief Provides various actions related to managing a Git-like repository (commit, checkout, branch management, etc.).
@@ -47,11 +69,13 @@ namespace manager {
         void commit(const std::string &message);
 
         /**
-         * @brief Prints the commit log of the current branch.
+         * @brief Prints the commits selected by a list of revisions, newest first.
          *
-         * Displays the list of commits made on the current branch, starting from the most recent one.
+         * @param revisions Branches or commits to start from, `^<commit>` to leave out, `A..B` or `A...B` ranges;
+         *                  HEAD if empty.
+         * @param options The filters and ordering of the log.
          */
-        void jit_commit_log();
+        void jit_commit_log(const std::vector<std::string> &revisions, const LogOptions &options);
 
         /**
          * @brief Checks out a specific commit or branch.
@@ -63,14 +87,6 @@ namespace manager {
          */
         void checkout_to_a_commit(const std::string &target);
 
-        /**
-         * @brief Retrieves a map of changed files' content between the current repository state and the specified
-         *        commit or branch.
-         *
-         * @return A map of file names and their respective content from the changed files.
-         */
-        std::map<std::string, std::vector<std::string>> get_changed_files_content();
-
         /**
          * @brief Creates a new branch with the specified name.
          *
@@ -90,22 +106,58 @@ namespace manager {
          */
         void merge(const std::string &feature_branch);
 
+        /**
+         * @brief Prints the best common ancestors of two commits or branches.
+         *
+         * @param first The first commit or branch.
+         * @param second The second commit or branch.
+         * @param all Whether to print every merge base rather than only the first.
+         */
+        void print_merge_base(const std::string &first, const std::string &second, bool all);
+
+        /**
+         * @brief Checks whether a commit can be reached from another by following parents.
+         *
+         * @param ancestor The possible ancestor, a commit or branch.
+         * @param descendant The possible descendant, a commit or branch.
+         */
+        bool is_ancestor(const std::string &ancestor, const std::string &descendant);
+
+        /**
+         * @brief Compacts the commit graph and writes the reachability bitmaps of the branch heads.
+         */
+        void gc();
+
+        /**
+         * @brief Merges the commit-graph tail into the graph file.
+         */
+        void write_commit_graph();
+
         /**
          * @brief Displays the difference between the current repository state and the HEAD of the repository.
+         *
+         * @param pathspec Limits the diff to the matching files.
+         * @param options How the files are compared.
          */
-        void jit_diff();
+        void jit_diff(const Pathspec &pathspec = Pathspec(), const DiffOptions &options = DiffOptions());
 
         /**
          * @brief Lists all the branches in the repository and highlights the current branch.
+         *
+         * @param verbose Whether to also print the head of each branch, its message and how many commits it is ahead
+         *                of and behind the current branch.
          */
-        void list_jit_branches();
+        void list_jit_branches(bool verbose = false);
 
         /**
          * @brief Displays the difference between the current branch and a specified branch.
          *
          * @param branch_name The name of the branch to compare against.
+         * @param pathspec Limits the diff to the matching files.
+         * @param options How the files are compared.
          */
-        void jit_diff(const std::string &branch_name);
+        void jit_diff(const std::string &branch_name, const Pathspec &pathspec = Pathspec(),
+                      const DiffOptions &options = DiffOptions());
 
         void jit_clone(const std::string &repository_dir);
 
@@ -116,6 +168,36 @@ namespace manager {
         void jit_branch_clone(const std::string &branch_name, const std::string &repository_dir,
                               const std::string &target_dir, int depth);
 
+        /**
+         * @brief Prints every line of a file at HEAD with the commit that last changed it.
+         *
+         * @param file_name The file, relative to the repository root.
+         */
+        void blame(const std::string &file_name);
+
+        /**
+         * @brief Restricts the working tree to the given patterns and enables sparse checkout.
+         *
+         * Files leaving the sparse set are removed from disk and flagged skip-worktree in the index; files entering it
+         * are written from the object store. The working tree must be clean.
+         *
+         * @param patterns Directories in cone mode, glob patterns (`!` to exclude) otherwise.
+         * @param cone_mode Whether the patterns are cone directories.
+         * @param sparse_index Whether to keep a sparse index (`index.sparse`); unset keeps the current setting.
+         */
+        void sparse_checkout_set(const std::vector<std::string> &patterns, bool cone_mode,
+                                 std::optional<bool> sparse_index = std::nullopt);
+
+        /**
+         * @brief Prints the patterns of the sparse checkout.
+         */
+        void sparse_checkout_list();
+
+        /**
+         * @brief Disables sparse checkout and writes every file of the index back to disk.
+         */
+        void sparse_checkout_disable();
+
     private:
 //        std::string jit_root; ///< The root directory of the Jit repository.
 
@@ -144,6 +226,40 @@ namespace manager {
          */
         [[nodiscard]] std::string get_branch_head(const std::string &branch_name);
 
+        /**
+         * @brief Checks whether a commit id names a commit stored in the repository.
+         *
+         * @param commit The commit id; the null id of a branch without commits is never stored.
+         * @return True if the commit object exists.
+         */
+        [[nodiscard]] bool has_commit_object(const std::string &commit);
+
+        /**
+         * @brief Builds the changed-path filter of a commit from the files it changed relative to its first parent.
+         *
+         * @param parent The first parent, or an empty or null id for a root commit.
+         * @param commit The commit.
+         * @return The filter bytes.
+         */
+        [[nodiscard]] std::string get_changed_paths_filter(const std::string &parent, const std::string &commit);
+
+        /**
+         * @brief Starts `jit commit-graph write` in a detached process if the commit graph needs compacting; the
+         *        caller does not wait for it.
+         *
+         * @param commit_graph The commit graph a commit was just added to.
+         */
+        static void compact_commit_graph_in_background(const CommitGraph &commit_graph);
+
+        /**
+         * @brief Resolves a branch name to the commit at its head and `HEAD` or an empty string to the current
+         *        commit; anything else is taken as a commit id.
+         *
+         * @param target The branch name, `HEAD` or commit id.
+         * @return The commit id.
+         */
+        [[nodiscard]] std::string resolve_commit(const std::string &target);
+
         /**
          * @brief Creates a temporary file with the specified checksum as its content.
          *
@@ -178,18 +294,6 @@ namespace manager {
          */
         std::string get_intersection_commit(const std::string &branch1, const std::string &branch2);
 
-        /**
-         * @brief Retrieves the changed files' content between two branches.
-         *
-         * This function compares the file content between two branches, returning the changes made.
-         *
-         * @param map1 The file map of the first branch.
-         * @param map2 The file map of the second branch.
-         * @return A map of file names with changes detected between the branches.
-         */
-        std::unordered_map<std::string, std::pair<std::vector<std::string>, std::vector<std::string>>>
-        get_changed_files_data(const std::unordered_map<std::string, FileInfo> &map1, std::unordered_map<std::string, FileInfo> map2);
-
         /**
          * @brief Displays the difference between two branches.
          *
@@ -197,8 +301,11 @@ namespace manager {
          *
          * @param branch1 The name of the first branch.
          * @param branch2 The name of the second branch.
+         * @param pathspec Limits the diff to the matching files.
+         * @param options How the files are compared.
          */
-        void jit_diff(const std::string &branch1, const std::string &branch2);
+        void jit_diff(const std::string &branch1, const std::string &branch2, const Pathspec &pathspec,
+                      const DiffOptions &options);
 
         /**
         * @brief Merges three versions of a file (base, branch_1, and branch_2) using a three-way merge algorithm.
@@ -234,7 +341,44 @@ namespace manager {
 
         static std::stack<std::string> get_commit_stack(const std::string &file_name);
 
-        void checkout(const IndexFileContent &content);
+        /**
+         * @brief Replaces the working tree with the files of an index, writing only the sparse checkout.
+         *
+         * @param content The index content to check out.
+         */
+        void checkout(IndexFileContent content);
+
+        /**
+         * @brief Moves the working tree from one commit to another, touching only the files that differ.
+         *
+         * @param from_commit The commit the working tree currently matches.
+         * @param to_commit The commit to check out.
+         */
+        void checkout(const std::string &from_commit, const std::string &to_commit);
+
+        /**
+         * @brief Writes the index after a checkout, keeping the stat information of the files left untouched.
+         *
+         * @param content The index content that was checked out.
+         * @param written_files The files written by the checkout.
+         */
+        void write_checkout_index(IndexFileContent content, const std::map<std::string, std::string> &written_files);
+
+        /**
+         * @brief Writes the tree objects of an index and a commit object pointing at its root tree.
+         *
+         * @param content The index content to commit.
+         * @param parents The parent commits.
+         * @param message The commit message.
+         * @return The id of the commit.
+         */
+        std::string write_commit_object(IndexFileContent content, const std::vector<std::string> &parents,
+                                        const std::string &message);
+
+        /**
+         * @brief Brings the working tree and the skip-worktree flags of the index in line with the sparse checkout.
+         */
+        void apply_sparse_checkout();
 
         static void copy_file(const std::string &source_path, const std::string &destination_path);
 
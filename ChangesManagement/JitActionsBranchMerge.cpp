@@ -10,9 +10,15 @@
 
 #include "JitActions.h"
 #include "../CommitManagement/CommitGraph.h"
+#include "../CommitManagement/SnapshotStore.h"
 
 namespace manager {
 
+    namespace {
+        constexpr size_t MIN_ABBREVIATED_ID = 4;        ///< Shortest commit id prefix that is looked up.
+        constexpr size_t MAX_AMBIGUOUS_CANDIDATES = 10; ///< Candidates listed for an ambiguous prefix.
+    }
+
     /**
      * Retrieves the commit tree from a specified branch file.
      *
@@ -120,165 +126,157 @@ namespace manager {
         if (head.starts_with("refs")) {
             std::string branch_name = std::regex_replace(head, std::regex(".+/"), "");
 
-            std::string feature_branch_head = get_branch_head(feature_branch);
+            feature_branch_sum = resolve_commit(feature_branch);
             std::string head_checksum = get_branch_head(branch_name);
             throw_error_if_repo_is_dirty();
 
             std::string commit_file = get_jit_root() + "/objects/" + generate_file_path(COMMIT_FILE_HASH).string();
             CommitGraph commit_graph(commit_file);
 
-            if (commit_graph.get_commit(feature_branch) == nullptr) {
-                feature_branch_sum = get_branch_head(feature_branch);
+            auto feature_position = commit_graph.get_commit(feature_branch_sum);
+            auto head_position = commit_graph.get_commit(head_checksum);
+            std::vector<uint32_t> merge_bases;
+            if (feature_position && head_position) {
+                merge_bases = commit_graph.get_merge_bases(*feature_position, *head_position);
             }
 
-            auto base_commit_ptr = commit_graph.get_intersection_commit(feature_branch_sum, head_checksum);
-
-            if (base_commit_ptr == nullptr) {
+            if (merge_bases.empty()) {
                 throw std::runtime_error("The branches are not related! Orphan merge out of scope");
-            } else if (base_commit_ptr->checksum == feature_branch_sum) {
-                throw std::runtime_error("No changes");
+            } else if (merge_bases.size() > 1) {
+                std::cout << YELLOW << "Found " << merge_bases.size() << " merge bases, merging from the most recent one"
+                          << RESET << std::endl;
             }
 
-            std::string base_commit = base_commit_ptr->checksum;
-
-            fs::path base_index_file = fs::path(get_jit_root() + "/objects") / generate_file_path(base_commit);
-            fs::path feature_branch_index_file =
-                    fs::path(fs::path(get_jit_root() + "/objects")) / generate_file_path(feature_branch_head);
-
-
-            IndexFileContent base_content = IndexFileParser::read_binary_index_file(get_jit_root() + "/objects/" +
-                                                                                    generate_file_path(
-                                                                                            base_commit).string());
-            IndexFileContent feature_branch_content = IndexFileParser::read_binary_index_file(
-                    get_jit_root() + "/objects/" +
-                    generate_file_path(feature_branch_sum).string());
+            std::string base_commit = commit_graph.get_checksum(merge_bases.front());
+            if (base_commit == feature_branch_sum) {
+                throw std::runtime_error("No changes");
+            }
+            std::string objects_directory = get_jit_root() + "/objects";
+            SnapshotStore store(objects_directory);
 
             IndexFileParser main_parser(get_jit_root() + "/index");
             IndexFileContent main_branch = main_parser.read_index_file();
-
-            auto f_branch = feature_branch_content.files_map;
-            auto b_branch = base_content.files_map;
-
-            std::vector<FileInfo> merged_files;
-            std::unordered_map<std::string, FileInfo> merged_files_map;
+            expand_sparse_index(main_branch);
+            const SparseCheckout sparse_checkout = get_sparse_checkout();
+            auto &files_map = main_branch.files_map;
             std::unordered_set<std::string> files_with_conflicts;
 
-            for (auto &main_pair: main_branch.files_map) {
-                std::string absolute_path = get_root_directory() + "/" + main_pair.first;
-                std::shared_ptr<bool> has_conflicts = std::make_unique<bool>(false);
-
-
-                if (b_branch.contains(main_pair.first)) {
-                    const auto &base = b_branch.at(main_pair.first);
-                    bool file_in_f = f_branch.contains(main_pair.first);
+            // Only the files the feature branch changed since the merge base need merging; the trees it left
+            // untouched are skipped without being read.
+            // After a criss-cross merge, a file the current branch left as it was in another merge base is not a
+            // change of the current branch.
+            std::vector<IndexFileContent> other_bases;
+            for (size_t i = 1; i < merge_bases.size(); ++i) {
+                other_bases.push_back(store.read_snapshot(commit_graph.get_checksum(merge_bases[i])));
+            }
 
-                    if ((base.checksum == main_pair.second.checksum)) {
+            store.diff_commits(base_commit, feature_branch_sum, Pathspec(), [&](const std::string &file_name,
+                                                                               const std::string &first_base_id,
+                                                                               const std::string &feature_id) {
+                std::string absolute_path = get_root_directory() + "/" + file_name;
+                auto main_entry = files_map.find(file_name);
+                std::string main_id = main_entry == files_map.end() ? "" : main_entry->second.checksum;
+                std::string base_id = first_base_id;
+
+                if (main_id == feature_id) {
+                    // Both branches made the same change.
+                    return;
+                }
 
-                        // File modified by the feature branch
-                        if (file_in_f && f_branch.at(main_pair.first).checksum != main_pair.second.checksum) {
-                            auto ff = f_branch.at(main_pair.first);
-                            decompress_and_copy(
-                                    (get_jit_root() + "/objects/" + generate_file_path(ff.checksum).string()),
-                                    absolute_path);
-                            merged_files.push_back(ff);
-                            merged_files_map.insert({ff.filename, std::move(ff)});
-                        } else {
-                            merged_files.push_back(main_pair.second);
-                            merged_files_map.insert(main_pair);
-                        }
+                for (const auto &other_base: other_bases) {
+                    auto other_entry = other_base.files_map.find(file_name);
+                    if ((other_entry == other_base.files_map.end() ? "" : other_entry->second.checksum) == main_id) {
+                        base_id = main_id;
+                        break;
+                    }
+                }
 
-                        f_branch.erase(main_pair.first);
-                    } else {
-                        if (file_in_f && f_branch.at(main_pair.first).checksum != base.checksum) {
-                            std::string temp_file_path = create_temp_file(main_pair.second.checksum);
-                            std::string temp_base = create_temp_file(base.checksum);
-
-                            std::future<std::vector<std::string>> branch_file_future = std::async(
-                                    std::launch::async, read_file_to_vector, temp_file_path);
-                            std::future<std::vector<std::string>> main_file_future = std::async(std::launch::async,
-                                                                                                read_file_to_vector,
-                                                                                                absolute_path);
-                            std::future<std::vector<std::string>> base_file_future = std::async(std::launch::async,
-                                                                                                read_file_to_vector,
-                                                                                                temp_base);
-
-                            const std::vector<std::string> merged_vector = three_way_merge(branch_file_future.get(),
-                                                                                           base_file_future.get(),
-                                                                                           main_file_future.get(),
-                                                                                           has_conflicts);
-                            write_vector_to_file(absolute_path, merged_vector);
-                            auto sha = generateSHA1(absolute_path);
-
-                            if (*has_conflicts) {
-                                main_pair.second.is_dirty = true;
-                            }
-                            main_pair.second.checksum = sha;
-                            merged_files.push_back(main_pair.second);
-                            merged_files_map.insert(main_pair);
-                            f_branch.erase(main_pair.first);
-                        } else {
-                            merged_files.push_back(main_pair.second);
-                            merged_files_map.insert(main_pair);
+                if (main_id == base_id) {
+                    // Only the feature branch changed the file: take its version. Files outside the sparse checkout
+                    // are updated in the index only.
+                    if (feature_id.empty()) {
+                        if (!main_entry->second.skip_worktree) {
+                            fs::remove(absolute_path);
                         }
+                        files_map.erase(main_entry);
+                        return;
                     }
-                } else if (f_branch.contains(main_pair.first)) {
-                    // File present in both branches but absent in base
-                    std::string temp_branch_file = create_temp_file(f_branch.at(main_pair.first).checksum);
-                    const auto branch_file_vector = read_file_to_vector(temp_branch_file);
-                    const auto main_file_vector = read_file_to_vector(absolute_path);
-                    const std::vector<std::string> base;
-
-                    const auto merged_vector = three_way_merge(base, branch_file_vector, main_file_vector,
-                                                               has_conflicts);
-
-                    if (*has_conflicts) {
-                        main_pair.second.is_dirty = true;
+
+                    FileInfo &file_info = files_map[file_name];
+                    file_info.filename = file_name;
+                    file_info.checksum = feature_id;
+                    file_info.size.reset();
+                    file_info.skip_worktree = !sparse_checkout.includes(file_name);
+                    if (!file_info.skip_worktree) {
+                        fs::create_directories(fs::path(absolute_path).parent_path());
+                        decompress_and_copy(objects_directory + "/" + generate_file_path(feature_id).string(),
+                                            absolute_path);
                     }
-                    auto sha = generateSHA1(absolute_path);
-                    main_pair.second.checksum = sha;
-
-                    write_vector_to_file(absolute_path, merged_vector);
-                    f_branch.erase(main_pair.first);
-                } else {
-                    merged_files.push_back(main_pair.second);
-                    merged_files_map.insert(main_pair);
+                    return;
                 }
 
-                if (*has_conflicts) {
-                    files_with_conflicts.insert(main_pair.first);
+                if (main_id.empty() || feature_id.empty()) {
+                    // Modified on one branch, deleted on the other.
+                    files_with_conflicts.insert(file_name);
+                    return;
                 }
-            }
 
-            for (auto &f_pair: f_branch) {
-                std::string absolute_path = get_root_directory() + "/" + f_pair.first;
-                decompress_and_copy(
-                        (get_jit_root() + "/objects/" + generate_file_path(f_pair.second.checksum).string()),
-                        absolute_path);
-                merged_files.push_back(f_pair.second);
-                merged_files_map.insert({f_pair.second.filename, std::move(f_pair.second)});
-            }
+                FileInfo &main_file = main_entry->second;
+                if (main_file.skip_worktree) {
+                    decompress_and_copy(objects_directory + "/" + generate_file_path(main_id).string(),
+                                        absolute_path);
+                    main_file.skip_worktree = false;
+                }
+
+                std::shared_ptr<bool> has_conflicts = std::make_shared<bool>(false);
+                std::future<std::vector<std::string>> feature_file_future = std::async(
+                        std::launch::async, read_file_to_vector, create_temp_file(feature_id));
+                std::vector<std::string> base_lines = base_id.empty() ? std::vector<std::string>()
+                                                                      : read_file_to_vector(create_temp_file(base_id));
+                std::vector<std::string> main_lines = read_file_to_vector(absolute_path);
+
+                const std::vector<std::string> merged_vector = three_way_merge(base_lines, main_lines,
+                                                                               feature_file_future.get(),
+                                                                               has_conflicts);
+                write_vector_to_file(absolute_path, merged_vector);
+
+                main_file.checksum = generateSHA1(absolute_path);
+                main_file.size.reset();
+                save_as_binary(objects_directory, main_file.checksum, absolute_path);
+
+                if (*has_conflicts) {
+                    main_file.is_dirty = true;
+                    files_with_conflicts.insert(file_name);
+                }
+            });
 
             if (files_with_conflicts.empty()) {
-                main_branch.files_map = merged_files_map;
+                main_branch.metaData.entries = files_map.size();
                 main_parser.write_index_file(main_branch);
 
                 Commit commit;
-                commit.checksum = generateSHA1(get_jit_root() + "/index");
                 commit.message = "Merge " + feature_branch + " into " + branch_name;
+                // HEAD is the first parent, in the commit object and in the graph alike.
+                const std::vector<std::string> parents = {head_checksum, feature_branch_sum};
+                commit.checksum = write_commit_object(main_branch, parents, commit.message);
                 commit.timestamp = std::chrono::system_clock::now();
                 commit.branch_name = branch_name;
+                commit.changed_paths = get_changed_paths_filter(head_checksum, commit.checksum);
 
-                commit_graph.add_commit(commit, {feature_branch_sum, head_checksum});
-                commit_graph.save_commits(commit_file);
+                commit_graph.add_commit(commit, parents);
+                compact_commit_graph_in_background(commit_graph);
                 std::cout << "Merged " + feature_branch + " into " + branch_name << std::endl;
-                save_as_binary(get_jit_root() + "/objects", commit.checksum, get_jit_root() + "/index");
-
 
                 update_branch_head_file(branch_name, commit.checksum);
                 update_head_file(head);
 
                 jit_log(get_jit_root() + "/logs/refs/heads/" + branch_name, head_checksum, commit.checksum,
                         "merge: fast forward");
+
+                collapse_sparse_index(main_branch);
+                if (!main_branch.sparse_directories.empty()) {
+                    main_parser.write_index_file(main_branch);
+                }
             } else {
                 std::cout << "Automatic merge failed. The following files have conflicts. Resolve them and then commit"
                           << std::endl;
@@ -291,6 +289,68 @@ namespace manager {
         }
     }
 
+    /**
+     * Prints the best common ancestors of two commits or branches.
+     *
+     * @param first The first commit or branch.
+     * @param second The second commit or branch.
+     * @param all Whether to print every merge base rather than only the first.
+     * @throws std::runtime_error if a commit is not in the commit graph.
+     */
+    void JitActions::print_merge_base(const std::string &first, const std::string &second, bool all) {
+        CommitGraph commit_graph(get_jit_root() + "/objects/" + generate_file_path(COMMIT_FILE_HASH).string());
+
+        auto first_position = commit_graph.get_commit(resolve_commit(first));
+        auto second_position = commit_graph.get_commit(resolve_commit(second));
+        if (!first_position || !second_position) {
+            throw std::runtime_error("Not a commit: " + (first_position ? second : first));
+        }
+
+        std::vector<uint32_t> merge_bases = commit_graph.get_merge_bases(*first_position, *second_position);
+        if (!all && merge_bases.size() > 1) {
+            merge_bases.resize(1);
+        }
+
+        for (uint32_t merge_base: merge_bases) {
+            std::cout << commit_graph.get_checksum(merge_base) << std::endl;
+        }
+    }
+
+    /**
+     * Resolves a branch name to the commit at its head, `HEAD` or an empty string to the current commit and a prefix of
+     * at least four digits to the only commit id starting with it; anything else is taken as a commit id.
+     *
+     * @param target The branch name, `HEAD`, or full or abbreviated commit id.
+     * @return The commit id.
+     * @throws std::runtime_error if more than one commit id starts with the prefix.
+     */
+    std::string JitActions::resolve_commit(const std::string &target) {
+        if (target.empty() || target == "HEAD") {
+            std::string head = get_head();
+            return head.starts_with("refs") ? get_branch_head(std::regex_replace(head, std::regex(".+/"), "")) : head;
+        }
+        if (fs::exists(get_jit_root() + "/refs/heads/" + target)) {
+            return get_branch_head(target);
+        }
+
+        if (target.size() >= MIN_ABBREVIATED_ID && target.size() < 40) {
+            CommitGraph commit_graph(get_jit_root() + "/objects/" + generate_file_path(COMMIT_FILE_HASH).string());
+            std::vector<uint32_t> matches = commit_graph.find_prefix(target, MAX_AMBIGUOUS_CANDIDATES);
+
+            if (matches.size() == 1) {
+                return commit_graph.get_checksum(matches.front());
+            } else if (matches.size() > 1) {
+                std::string message = "Short commit id " + target + " is ambiguous; candidates are:";
+                for (uint32_t match: matches) {
+                    message += "\n  " + commit_graph.get_checksum(match) + " " +
+                               std::string(commit_graph.get_message(match));
+                }
+                throw std::runtime_error(message);
+            }
+        }
+        return target;
+    }
+
     /**
      * Creates a temporary file for a given checksum.
      *
@@ -372,29 +432,39 @@ namespace manager {
         std::vector<std::string> merged;
         size_t i = 0, j = 0, k = 0;
 
+        // Lines are compared by interned id; a missing line compares as an empty one.
+        static const std::string no_line;
+        LineInterner interner;
+        const uint32_t empty_line = interner.intern(no_line);
+        const std::vector<uint32_t> base_ids = interner.intern(base);
+        const std::vector<uint32_t> branch_1_ids = interner.intern(branch_1);
+        const std::vector<uint32_t> branch_2_ids = interner.intern(branch_2);
+
         // Loop through the base, branch_1, and branch_2 vectors to compare lines.
         while (i < base.size() || j < branch_1.size() || k < branch_2.size()) {
-            std::string base_line = (i < base.size()) ? base[i] : "";
-            std::string branch_1_line = (j < branch_1.size()) ? branch_1[j] : "";
-            std::string branch_2_line = (k < branch_2.size()) ? branch_2[k] : "";
+            uint32_t base_line = (i < base.size()) ? base_ids[i] : empty_line;
+            uint32_t branch_1_line = (j < branch_1.size()) ? branch_1_ids[j] : empty_line;
+            uint32_t branch_2_line = (k < branch_2.size()) ? branch_2_ids[k] : empty_line;
+            const std::string &branch_1_text = (j < branch_1.size()) ? branch_1[j] : no_line;
+            const std::string &branch_2_text = (k < branch_2.size()) ? branch_2[k] : no_line;
 
             // If both branches have the same line as the base, use that line.
             if (branch_1_line == branch_2_line) {
-                merged.push_back(branch_1_line);
+                merged.push_back(branch_1_text);
                 if (i < base.size() && branch_1_line == base_line) i++;
                 if (j < branch_1.size()) j++;
                 if (k < branch_2.size()) k++;
             }
                 // If branch_1 has not changed and branch_2 has, use the line from branch_2.
             else if (branch_1_line == base_line) {
-                merged.push_back(branch_2_line);
+                merged.push_back(branch_2_text);
                 i++;
                 j++;
                 if (k < branch_2.size()) k++;
             }
                 // If branch_2 has not changed and branch_1 has, use the line from branch_1.
             else if (branch_2_line == base_line) {
-                merged.push_back(branch_1_line);
+                merged.push_back(branch_1_text);
                 i++;
                 if (j < branch_1.size()) j++;
                 k++;
@@ -403,9 +473,9 @@ namespace manager {
             else {
                 *has_conflict = true;
                 merged.emplace_back("<<<<<<< BRANCH 1");
-                merged.push_back(branch_1_line);
+                merged.push_back(branch_1_text);
                 merged.emplace_back("=======");
-                merged.push_back(branch_2_line);
+                merged.push_back(branch_2_text);
                 merged.emplace_back(">>>>>>> BRANCH 2");
                 if (i < base.size()) i++;
                 if (j < branch_1.size()) j++;
@@ -0,0 +1,203 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include "JitActions.h"
+#include "../CommitManagement/ChangedPathFilter.h"
+#include "../CommitManagement/CommitGraph.h"
+#include "../CommitManagement/SnapshotStore.h"
+#include "../JitUtility/myers_diff.h"
+
+namespace manager {
+
+    namespace {
+        /**
+         * Lines of one version of the blamed file still looking for the commit that added them.
+         */
+        struct BlameRange {
+            size_t begin;        ///< First line in the version of the file held by the suspect commit.
+            size_t final_begin;  ///< The same line in the blamed version.
+            size_t length;
+        };
+
+        std::vector<std::string> split_lines(const std::string &content) {
+            std::vector<std::string> lines;
+            size_t begin = 0;
+            while (begin < content.size()) {
+                size_t end = content.find('\n', begin);
+                if (end == std::string::npos) {
+                    end = content.size();
+                }
+                lines.emplace_back(content, begin, end - begin);
+                begin = end + 1;
+            }
+            return lines;
+        }
+
+        /**
+         * Splits ranges of the new version of a file into the lines found in the old version, in old-version
+         * coordinates, and the lines that are not.
+         */
+        void pass_through(const std::vector<BlameRange> &ranges, const std::vector<DiffMatch> &matches,
+                          std::vector<BlameRange> &passed, std::vector<BlameRange> &kept) {
+            for (const auto &range: ranges) {
+                size_t position = range.begin;
+                size_t end = range.begin + range.length;
+                auto match = std::upper_bound(matches.begin(), matches.end(), position,
+                                              [](size_t line, const DiffMatch &m) {
+                                                  return line < m.new_begin + m.length;
+                                              });
+
+                while (position < end) {
+                    size_t final_position = range.final_begin + (position - range.begin);
+                    if (match == matches.end() || match->new_begin >= end) {
+                        kept.push_back({position, final_position, end - position});
+                        break;
+                    }
+                    if (match->new_begin > position) {
+                        kept.push_back({position, final_position, match->new_begin - position});
+                        position = match->new_begin;
+                        continue;
+                    }
+
+                    size_t taken = std::min(end, match->new_begin + match->length) - position;
+                    passed.push_back({match->old_begin + (position - match->new_begin), final_position, taken});
+                    position += taken;
+                    ++match;
+                }
+            }
+        }
+    }
+
+    /**
+     * Prints every line of a file with the commit that last changed it.
+     *
+     * The history of the file is walked backwards from HEAD, highest generation first, so a commit is handled once
+     * all its descendants have passed their lines to it. Each commit hands the lines it did not change to its parents
+     * through a linear-space diff and keeps the others. Commits whose changed-path filter excludes the file pass
+     * every line to their first parent without reading a tree. File contents and diffs are cached by content id, and
+     * the walk stops once every line is attributed.
+     *
+     * @param file_name The file, relative to the repository root.
+     * @throws std::runtime_error if there is no commit or HEAD has no such file.
+     */
+    void JitActions::blame(const std::string &file_name) {
+        std::string objects_directory = get_jit_root() + "/objects";
+        std::string path = fs::path(file_name).lexically_normal().generic_string();
+        CommitGraph commit_graph(objects_directory + "/" + generate_file_path(COMMIT_FILE_HASH).string());
+        SnapshotStore store(objects_directory);
+
+        auto head = commit_graph.get_commit(resolve_commit("HEAD"));
+        if (!head) {
+            throw std::runtime_error("No commits yet");
+        }
+        std::string head_file_id = store.get_file_id(commit_graph.get_checksum(*head), path);
+        if (head_file_id.empty()) {
+            throw std::runtime_error("No such path " + path + " in HEAD");
+        }
+
+        // Every version of the file is read and interned once; the interner points into the cached contents.
+        std::unordered_map<std::string, std::vector<std::string>> file_lines;
+        std::unordered_map<std::string, std::vector<uint32_t>> file_line_ids;
+        LineInterner interner;
+        auto read_line_ids = [&](const std::string &file_id) -> const std::vector<uint32_t> & {
+            auto [entry, inserted] = file_line_ids.try_emplace(file_id);
+            if (inserted) {
+                const auto &lines = file_lines[file_id] = split_lines(
+                        read_binary_as_string(objects_directory + "/" + generate_file_path(file_id).string()));
+                entry->second = interner.intern(lines);
+            }
+            return entry->second;
+        };
+        std::map<std::pair<std::string, std::string>, std::vector<DiffMatch>> diffs;
+        auto diff = [&](const std::string &old_id, const std::string &new_id) -> const std::vector<DiffMatch> & {
+            auto [entry, inserted] = diffs.try_emplace({old_id, new_id});
+            if (inserted) {
+                entry->second = diff_lines(read_line_ids(old_id), read_line_ids(new_id));
+            }
+            return entry->second;
+        };
+
+        size_t line_count = read_line_ids(head_file_id).size();
+        const auto &final_lines = file_lines[head_file_id];
+        std::vector<uint32_t> owners(line_count, *head);
+        size_t unattributed = line_count;
+
+        // The suspects and their version of the file, in a max-heap ordered by generation.
+        std::unordered_map<uint32_t, std::pair<std::string, std::vector<BlameRange>>> suspects;
+        std::vector<uint32_t> queue;
+        auto later_first = [&commit_graph](uint32_t a, uint32_t b) {
+            return commit_graph.get_generation(a) != commit_graph.get_generation(b)
+                   ? commit_graph.get_generation(a) < commit_graph.get_generation(b)
+                   : commit_graph.get_timestamp(a) < commit_graph.get_timestamp(b);
+        };
+        auto suspect = [&](uint32_t commit, const std::string &file_id, std::vector<BlameRange> &ranges) {
+            auto [entry, inserted] = suspects.try_emplace(commit, file_id, std::vector<BlameRange>());
+            entry->second.second.insert(entry->second.second.end(), ranges.begin(), ranges.end());
+            if (inserted) {
+                queue.push_back(commit);
+                std::push_heap(queue.begin(), queue.end(), later_first);
+            }
+        };
+
+        std::vector<BlameRange> initial = {{0, 0, line_count}};
+        suspect(*head, head_file_id, initial);
+
+        while (!queue.empty() && unattributed > 0) {
+            std::pop_heap(queue.begin(), queue.end(), later_first);
+            uint32_t commit = queue.back();
+            queue.pop_back();
+            auto [file_id, ranges] = std::move(suspects[commit]);
+            suspects.erase(commit);
+
+            auto changed_paths = commit_graph.get_changed_paths(commit);
+            auto parents = commit_graph.get_parents(commit);
+            for (size_t i = 0; i < parents.size() && !ranges.empty(); ++i) {
+                std::string parent_file_id =
+                        i == 0 && changed_paths && !ChangedPathFilter::may_contain(*changed_paths, path)
+                        ? file_id : store.get_file_id(commit_graph.get_checksum(parents[i]), path);
+                if (parent_file_id.empty()) {
+                    continue;
+                }
+
+                std::vector<BlameRange> passed, kept;
+                if (parent_file_id == file_id) {
+                    passed = std::move(ranges);
+                } else {
+                    pass_through(ranges, diff(parent_file_id, file_id), passed, kept);
+                }
+                ranges = std::move(kept);
+                if (!passed.empty()) {
+                    suspect(parents[i], parent_file_id, passed);
+                }
+            }
+
+            for (const auto &range: ranges) {
+                std::fill_n(owners.begin() + static_cast<long>(range.final_begin), range.length, commit);
+                unattributed -= range.length;
+            }
+        }
+
+        std::unordered_map<uint32_t, std::string> headers;
+        size_t number_width = std::to_string(line_count).size();
+        std::string buffer;
+        for (size_t line = 0; line < line_count; ++line) {
+            auto &header = headers[owners[line]];
+            if (header.empty()) {
+                uint32_t owner = owners[line];
+                std::string_view author = commit_graph.get_author(owner);
+                header = commit_graph.get_checksum(owner).substr(0, commit_graph.unique_prefix_length(owner)) + " (" +
+                         std::string(author.empty() ? "Unknown" : author) + " " +
+                         time_point_to_string(commit_graph.get_timestamp(owner)) + " ";
+            }
+
+            std::string number = std::to_string(line + 1);
+            buffer.append(YELLOW).append(header).append(number_width - number.size(), ' ').append(number)
+                  .append(")").append(RESET).append(" ").append(final_lines[line]).append("\n");
+        }
+        std::cout << buffer << std::flush;
+    }
+}
@@ -7,6 +7,9 @@
 #include <fstream>
 #include <regex>
 #include "JitActions.h"
+#include "../CommitManagement/CommitGraph.h"
+#include "../CommitManagement/ReachabilityBitmaps.h"
+#include "../CommitManagement/SnapshotStore.h"
 
 namespace manager {
     void JitActions::jit_clone(const std::string &repository_dir) {
@@ -33,9 +36,7 @@ namespace manager {
                 change_root_directory(absolute(fs::path(target_dir)));
                 std::string head = std::regex_replace(get_head(), std::regex(".+/"), "");
                 std::string head_commit = get_branch_head(head);
-                auto content = IndexFileParser::read_binary_index_file(
-                        target_dir +"/.jit/objects/"+ generate_file_path(head_commit).string());
-                checkout(content);
+                checkout(SnapshotStore(get_jit_root() + "/objects").read_snapshot(head_commit));
             } else {
                 throw std::runtime_error("No Jit repository named " + repository_dir + " was found.");
             }
@@ -77,40 +78,55 @@ namespace manager {
                 std::stack<std::string> branch_commits = get_commit_stack(
                         repository_dir + "/.jit/logs/refs/heads/" + branch_name);
 
+                SnapshotStore store(get_jit_root() + "/objects");
                 std::unique_ptr<IndexFileContent> latest_content = nullptr;
-                while ((depth == -1 && !branch_commits.empty()) || depth > 0) {
+                std::set<std::string> objects;
+
+                // A full clone takes everything reachable from the head, read from the bitmaps written by gc.
+                std::string commit_file = get_jit_root() + "/objects/" + generate_file_path(COMMIT_FILE_HASH).string();
+                CommitGraph commit_graph(commit_file);
+                std::string branch_head = get_branch_head(branch_name);
+                auto head_position = commit_graph.get_commit(branch_head);
+                if (depth < 0 && head_position) {
+                    ReachabilityBitmaps bitmaps(commit_graph, store, commit_file + ".bitmap");
+                    for (auto &object: bitmaps.get_object_ids(bitmaps.reachable(*head_position))) {
+                        objects.insert(std::move(object));
+                    }
+                    latest_content = std::make_unique<IndexFileContent>(store.read_snapshot(branch_head));
+                    depth = 0;
+                }
+
+                while (!branch_commits.empty() && depth != 0) {
                     std::string commit = branch_commits.top();
-                    IndexFileContent content = IndexFileParser::read_binary_index_file((get_jit_root() + "/objects/" +
-                                                                                        generate_file_path(
-                                                                                                commit).string()));
+                    branch_commits.pop();
+                    if (depth > 0) {
+                        depth--;
+                    }
 
+                    // The log starts from the null commit, which has no object.
+                    if (!fs::exists(get_jit_root() + "/objects/" + generate_file_path(commit).string())) {
+                        continue;
+                    }
 
                     if (latest_content == nullptr) {
-                        latest_content = std::make_unique<IndexFileContent>(content);
+                        latest_content = std::make_unique<IndexFileContent>(store.read_snapshot(commit));
                     }
 
-                    for (const auto &[_, info]: content.files_map) {
-                        std::string file_dir = generate_file_path(info.checksum).string();
-                        std::string result_path = target_dir + "/.jit/objects/" + file_dir;
+                    // Commit, trees and files; trees shared with a newer commit are only visited once.
+                    store.collect_objects(commit, objects);
+                }
+
+                for (const auto &object: objects) {
+                    std::string file_dir = generate_file_path(object).string();
+                    copy_file(get_jit_root() + "/objects/" + file_dir, target_dir + "/.jit/objects/" + file_dir);
+                }
 
-                        copy_file(get_jit_root() + "/objects/" + file_dir,
-                                  result_path);
+                //copy the commit graph and the commits appended to it since it was compacted
+                for (const std::string suffix: {"", ".tail"}) {
+                    std::string graph_file = generate_file_path(COMMIT_FILE_HASH).string() + suffix;
+                    if (fs::exists(get_jit_root() + "/objects/" + graph_file)) {
+                        copy_file(get_jit_root() + "/objects/" + graph_file, target_dir + "/.jit/objects/" + graph_file);
                     }
-//
-                    //copy index file
-                    copy_file((get_jit_root() + "/objects/" +
-                               generate_file_path(commit).string()),
-                              (target_dir + "/.jit/objects/" +
-                               generate_file_path(commit).string()));
-//
-                    //copy the commit graph
-                    copy_file((get_jit_root() + "/objects/" +
-                               generate_file_path(COMMIT_FILE_HASH).string()),
-                              (target_dir + "/.jit/objects/" +
-                               generate_file_path(COMMIT_FILE_HASH).string()));
-
-                    branch_commits.pop();
-                    depth--;
                 }
 
                 //copy the branch head
@@ -121,11 +137,6 @@ namespace manager {
                 copy_file(get_jit_root() + "/logs/refs/heads/" + branch_name,
                           target_dir + "/.jit/logs/refs/heads/" + branch_name);
 
-                //copy index file
-                decompress_and_copy((get_jit_root() + "/objects/" +
-                                     generate_file_path(get_branch_head(branch_name)).string()),
-                                    (target_dir + "/.jit/index"));
-
                 std::ofstream head(target_dir + "/.jit/HEAD");
                 if (head) {
                     head << "refs/heads/" << branch_name << std::endl;
@@ -0,0 +1,120 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include <iostream>
+#include "JitActions.h"
+#include "IndexFileParser.h"
+
+namespace manager {
+
+    /**
+     * Restricts the working tree to the given patterns and enables sparse checkout.
+     *
+     * The working tree is checked against the old sparse set before the patterns change, so no local modification can
+     * be lost when a file leaves the sparse set.
+     *
+     * @param patterns Directories in cone mode, glob patterns otherwise.
+     * @param cone_mode Whether the patterns are cone directories.
+     * @param sparse_index Whether to keep a sparse index (`index.sparse`); unset keeps the current setting.
+     * @throws std::runtime_error if the repository has uncommitted changes or a cone pattern contains glob characters.
+     */
+    void JitActions::sparse_checkout_set(const std::vector<std::string> &patterns, bool cone_mode,
+                                         std::optional<bool> sparse_index) {
+        if (cone_mode) {
+            for (const auto &pattern: patterns) {
+                if (pattern.find_first_of("*?[!") != std::string::npos) {
+                    throw std::runtime_error("Cone mode patterns must be directories, not " + pattern +
+                                             ". Use --no-cone for glob patterns");
+                }
+            }
+        }
+
+        throw_error_if_repo_is_dirty();
+
+        SparseCheckout(patterns, cone_mode).save(get_jit_root());
+        set_config_value("core.sparseCheckout", "true");
+        set_config_value("core.sparseCheckoutCone", cone_mode ? "true" : "false");
+        if (sparse_index) {
+            set_config_value("index.sparse", *sparse_index ? "true" : "false");
+        }
+
+        apply_sparse_checkout();
+    }
+
+    /**
+     * Prints the patterns of the sparse checkout.
+     *
+     * @throws std::runtime_error if sparse checkout is not enabled.
+     */
+    void JitActions::sparse_checkout_list() {
+        SparseCheckout sparse_checkout = get_sparse_checkout();
+        if (!sparse_checkout.is_enabled()) {
+            throw std::runtime_error("This repository is not sparse");
+        }
+
+        for (const auto &pattern: sparse_checkout.get_patterns()) {
+            std::cout << pattern << std::endl;
+        }
+    }
+
+    /**
+     * Disables sparse checkout and writes every file of the index back to disk.
+     *
+     * @throws std::runtime_error if the repository has uncommitted changes.
+     */
+    void JitActions::sparse_checkout_disable() {
+        throw_error_if_repo_is_dirty();
+
+        set_config_value("core.sparseCheckout", "false");
+        apply_sparse_checkout();
+    }
+
+    /**
+     * Brings the working tree and the skip-worktree flags of the index in line with the sparse checkout.
+     *
+     * Only the entries whose flag changes are touched: a file entering the sparse set is written from the object store
+     * and a file leaving it is removed, along with the directories it leaves empty. The sparse index is rebuilt for
+     * the new sparse set.
+     */
+    void JitActions::apply_sparse_checkout() {
+        const SparseCheckout sparse_checkout = get_sparse_checkout();
+        IndexFileParser parser(get_jit_root() + "/index");
+        IndexFileContent content = parser.read_index_file();
+        expand_sparse_index(content);
+
+        std::set<std::string> files_to_delete;
+        std::map<std::string, std::string> files_to_write;
+        fs::path objects_path(get_jit_root() + "/objects");
+
+        for (auto &[file_name, file_info]: content.files_map) {
+            bool skip_worktree = !sparse_checkout.includes(file_name);
+            if (skip_worktree == file_info.skip_worktree) {
+                continue;
+            }
+
+            if (skip_worktree) {
+                files_to_delete.insert(file_name);
+            } else {
+                files_to_write.emplace(file_name, objects_path / generate_file_path(file_info.checksum));
+            }
+            file_info.skip_worktree = skip_worktree;
+        }
+
+        update_repository(files_to_delete, files_to_write);
+
+        const fs::path root_directory(get_root_directory());
+        for (const auto &file_name: files_to_delete) {
+            for (auto parent = fs::path(file_name).parent_path(); !parent.empty(); parent = parent.parent_path()) {
+                std::error_code error;
+                if (!fs::is_empty(root_directory / parent, error) || error) {
+                    break;
+                }
+                fs::remove(root_directory / parent, error);
+            }
+        }
+
+        collapse_sparse_index(content);
+        parser.write_index_file(content);
+    }
+}
@@ -9,6 +9,8 @@
 #include <vector>
 #include <unordered_map>
 #include <set>
+#include <map>
+#include <optional>
 #define COMMIT_FILE_HASH "4015b57a143aec5156fd1444a017a32137a3fd0f"
 
 
@@ -17,9 +19,11 @@ struct FileInfo {
     std::string checksum;
     std::chrono::system_clock::time_point addition_date;
     std::chrono::system_clock::time_point last_modified;
+    std::optional<uint64_t> size;
     bool is_dirty;
     bool is_new;
     bool is_deleted = false;
+    bool skip_worktree = false;  // Outside the sparse checkout: tracked, but not present on disk.
 
     bool operator<(const FileInfo& other) const {
         return filename < other.filename;
@@ -35,6 +39,7 @@ struct IndexMetaData {
 struct IndexFileContent {
     IndexMetaData metaData;
     std::unordered_map<std::string, FileInfo> files_map;
+    std::map<std::string, std::string> sparse_directories;  // Collapsed directory -> tree of its entries.
 };
 
 struct JitStatus{
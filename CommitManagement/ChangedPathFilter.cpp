@@ -0,0 +1,75 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "ChangedPathFilter.h"
+
+#include <cstdint>
+#include <unordered_set>
+
+namespace manager {
+
+    namespace {
+        /**
+         * 64-bit FNV-1a; its two halves seed the double hashing of the filter.
+         */
+        uint64_t hash_path(std::string_view path) {
+            uint64_t hash = 0xcbf29ce484222325ull;
+            for (unsigned char c: path) {
+                hash ^= c;
+                hash *= 0x100000001b3ull;
+            }
+            return hash;
+        }
+    }
+
+    std::string ChangedPathFilter::build(const std::vector<std::string> &changed_files) {
+        std::unordered_set<std::string_view> paths;
+        for (const auto &file: changed_files) {
+            std::string_view path = file;
+            while (!path.empty() && paths.insert(path).second) {
+                size_t slash = path.rfind('/');
+                path = path.substr(0, slash == std::string_view::npos ? 0 : slash);
+            }
+        }
+
+        if (paths.empty()) {
+            return "";
+        }
+        if (paths.size() > MAX_PATHS) {
+            return std::string(1, '\xff');
+        }
+
+        std::string filter((paths.size() * BITS_PER_PATH + 7) / 8, '\0');
+        const uint64_t bit_count = filter.size() * 8;
+        for (std::string_view path: paths) {
+            uint64_t hash = hash_path(path);
+            auto first = static_cast<uint32_t>(hash);
+            auto step = static_cast<uint32_t>(hash >> 32) | 1;
+            for (uint32_t i = 0; i < HASH_COUNT; ++i) {
+                uint64_t bit = (first + uint64_t(i) * step) % bit_count;
+                filter[bit / 8] = static_cast<char>(filter[bit / 8] | 1 << (bit % 8));
+            }
+        }
+        return filter;
+    }
+
+    bool ChangedPathFilter::may_contain(std::string_view filter, std::string_view path) {
+        if (filter.empty()) {
+            return false;
+        }
+
+        const uint64_t bit_count = filter.size() * 8;
+        uint64_t hash = hash_path(path);
+        auto first = static_cast<uint32_t>(hash);
+        auto step = static_cast<uint32_t>(hash >> 32) | 1;
+        for (uint32_t i = 0; i < HASH_COUNT; ++i) {
+            uint64_t bit = (first + uint64_t(i) * step) % bit_count;
+            if (!(static_cast<unsigned char>(filter[bit / 8]) >> (bit % 8) & 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+} // namespace manager
@@ -0,0 +1,51 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#ifndef JIT_CHANGEDPATHFILTER_H
+#define JIT_CHANGEDPATHFILTER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace manager {
+
+    /**
+     * Bloom filter of the paths a commit changed relative to its first parent, stored with the commit in the commit
+     * graph.
+     *
+     * Every changed file is added along with each of its leading directories, so both `src/net/socket.cc` and
+     * `src/net` can be looked up. A path that is not in the filter was certainly not changed; a path that is may have
+     * been, about once in a hundred lookups it was not. A commit that changed more than MAX_PATHS paths stores a
+     * single byte with every bit set, which contains everything.
+     */
+    class ChangedPathFilter {
+    public:
+        /**
+         * Builds the filter of a list of changed files.
+         *
+         * @param changed_files The changed files, relative to the repository root.
+         * @return The filter bytes; empty if nothing changed.
+         */
+        static std::string build(const std::vector<std::string> &changed_files);
+
+        /**
+         * Checks whether a path may be in a filter.
+         *
+         * @param filter The filter bytes.
+         * @param path A file or directory relative to the repository root, without a trailing slash.
+         * @return False if the path was certainly not changed.
+         */
+        static bool may_contain(std::string_view filter, std::string_view path);
+
+    private:
+        static constexpr size_t BITS_PER_PATH = 10;
+        static constexpr uint32_t HASH_COUNT = 7;
+        static constexpr size_t MAX_PATHS = 512;
+    };
+
+} // namespace manager
+
+#endif //JIT_CHANGEDPATHFILTER_H
@@ -4,6 +4,8 @@
 
 #include "CommitGraph.h"
 #include "../JitUtility/jit_utility.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <unordered_set>
 #include <fstream>
@@ -11,121 +13,930 @@
 #include <utility>
 #include <zlib.h>
 #include <filesystem>
+#include <thread>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
 namespace manager {
+
+    namespace {
+        constexpr char GRAPH_MAGIC[4] = {'J', 'C', 'G', 'R'};
+        constexpr uint32_t GRAPH_VERSION = 1;
+        constexpr size_t ID_SIZE = 20;
+
+        struct GraphHeader {
+            char magic[4];
+            uint32_t version;
+            uint32_t commit_count;
+            uint32_t edge_count;
+            uint64_t heap_size;
+        };
+
+        constexpr char TAIL_MAGIC[4] = {'J', 'C', 'G', 'T'};
+        constexpr uint32_t TAIL_VERSION = 1;
+        constexpr size_t TAIL_COMPACTION_THRESHOLD = 128;
+        constexpr size_t LEGACY_INFLATE_CHUNK_SIZE = 64 * 1024;
+
+        /**
+         * Header of the tail file. `header_size` counts the whole header, so that fields can be added without
+         * moving the records of older readers.
+         */
+        struct TailHeader {
+            char magic[4];
+            uint32_t header_size;
+            uint32_t version;
+        };
+
+        int hex_value(char c) {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        }
+
+        /**
+         * @return The number of leading hexadecimal digits two raw ids have in common.
+         */
+        size_t common_hex_digits(const unsigned char *id1, const unsigned char *id2) {
+            for (size_t i = 0; i < ID_SIZE; ++i) {
+                if (id1[i] != id2[i]) {
+                    return 2 * i + ((id1[i] >> 4) == (id2[i] >> 4) ? 1 : 0);
+                }
+            }
+            return 2 * ID_SIZE;
+        }
+
+        static_assert(sizeof(GraphHeader) == 24);
+        static_assert(sizeof(CommitRecord) == 48);
+
+        size_t align_to_8(size_t offset) {
+            return (offset + 7) & ~size_t(7);
+        }
+
+        /**
+         * Offsets of the tables of a commit-graph image with the given counts.
+         */
+        struct GraphLayout {
+            size_t ids;
+            size_t records;
+            size_t edges;
+            size_t heap;
+            size_t end;
+
+            GraphLayout(uint32_t commit_count, uint32_t edge_count, uint64_t heap_size) {
+                ids = sizeof(GraphHeader);
+                records = align_to_8(ids + ID_SIZE * commit_count);
+                edges = records + sizeof(CommitRecord) * commit_count;
+                heap = edges + sizeof(uint32_t) * edge_count;
+                end = heap + heap_size;
+            }
+        };
+
+        /**
+         * Exclusive lock on the commit graph, held while the tail is appended to or the graph is compacted.
+         *
+         * The lock is an flock on the lock file, so it goes away with the process holding it: a compaction that
+         * crashes never leaves the graph locked. The file itself is never removed, since a process waiting on it
+         * would otherwise lock a file that the next one no longer sees.
+         */
+        class GraphLock {
+        public:
+            explicit GraphLock(const std::string &lock_path) {
+                fd = open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+                if (fd < 0) {
+                    throw std::runtime_error("Unable to lock the commit graph: " + lock_path);
+                }
+
+                // A compaction holds the lock for as long as it takes to write the segment.
+                for (int attempt = 0; attempt < 1000; ++attempt) {
+                    if (flock(fd, LOCK_EX | LOCK_NB) == 0) {
+                        return;
+                    }
+                    if (errno != EWOULDBLOCK && errno != EINTR) {
+                        break;
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+                close(fd);
+                throw std::runtime_error("Unable to lock the commit graph: " + lock_path);
+            }
+
+            ~GraphLock() {
+                close(fd);
+            }
+
+            GraphLock(const GraphLock &) = delete;
+
+            GraphLock &operator=(const GraphLock &) = delete;
+
+        private:
+            int fd;
+        };
+
+        /**
+         * Finds where the last complete record of a tail ends. A record torn by a crash, or a header torn before the
+         * first record, lies past that point; a tail whose header is not recognized is left whole.
+         *
+         * @return The size of the tail without its torn end.
+         */
+        off_t complete_tail_size(int fd, off_t tail_size) {
+            TailHeader header{};
+            if (tail_size < static_cast<off_t>(sizeof(header)) ||
+                pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+                return 0;
+            }
+            if (std::memcmp(header.magic, TAIL_MAGIC, sizeof(TAIL_MAGIC)) != 0 || header.header_size > tail_size) {
+                return tail_size;
+            }
+
+            off_t offset = header.header_size;
+            uint32_t record_size;
+            while (offset + static_cast<off_t>(sizeof(record_size)) <= tail_size &&
+                   pread(fd, &record_size, sizeof(record_size), offset) == static_cast<ssize_t>(sizeof(record_size))) {
+                off_t end = offset + static_cast<off_t>(sizeof(record_size)) + record_size;
+                if (end > tail_size) {
+                    break;
+                }
+                offset = end;
+            }
+            return offset;
+        }
+
+        void append_bytes(std::string &buffer, const void *bytes, size_t size) {
+            buffer.append(static_cast<const char *>(bytes), size);
+        }
+
+        void append_string(std::string &buffer, std::string_view value) {
+            auto size = static_cast<uint32_t>(value.size());
+            append_bytes(buffer, &size, sizeof(size));
+            buffer.append(value);
+        }
+    }
+
     void CommitGraph::add_commit(const Commit &commit) {
-        commits.insert({commit.checksum, commit});
+        std::array<unsigned char, 20> raw_id{};
+        if (!parse_id(commit.checksum, raw_id) || get_commit(commit.checksum)) {
+            return;
+        }
+
+        std::vector<uint32_t> parent_positions;
+        std::string parent_ids;
+        for (const auto &parent: commit.parents) {
+            std::array<unsigned char, 20> raw_parent{};
+            auto position = get_commit(parent);
+            if (position && parse_id(parent, raw_parent)) {
+                parent_positions.push_back(*position);
+                append_bytes(parent_ids, raw_parent.data(), raw_parent.size());
+            }
+        }
+
+        int64_t timestamp = commit.timestamp.time_since_epoch().count();
+        auto parent_count = static_cast<uint32_t>(parent_positions.size());
+
+        std::string payload;
+        append_bytes(payload, raw_id.data(), raw_id.size());
+        append_bytes(payload, &timestamp, sizeof(timestamp));
+        append_bytes(payload, &parent_count, sizeof(parent_count));
+        payload += parent_ids;
+        append_string(payload, commit.message);
+        append_string(payload, commit.branch_name);
+        append_string(payload, commit.author);
+        // Older readers skip the rest of a record, so the filter can follow the strings.
+        if (commit.changed_paths) {
+            append_string(payload, *commit.changed_paths);
+        }
+
+        // One length-prefixed record, written with a single append.
+        std::string record;
+        auto record_size = static_cast<uint32_t>(payload.size());
+        append_bytes(record, &record_size, sizeof(record_size));
+        record += payload;
+
+        fs::create_directories(fs::path(commit_file_path).parent_path());
+        {
+            GraphLock lock(commit_file_path + ".lock");
+            int fd = open(tail_path().c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+            if (fd < 0) {
+                throw std::runtime_error("Failed to open file for writing: " + tail_path());
+            }
+
+            // A record torn by a crash would hide every record appended after it, so it is cut off first.
+            struct stat tail_stat{};
+            off_t tail_size = fstat(fd, &tail_stat) == 0 ? complete_tail_size(fd, tail_stat.st_size) : -1;
+            if (tail_size < 0 || (tail_size != tail_stat.st_size && ftruncate(fd, tail_size) != 0)) {
+                close(fd);
+                throw std::runtime_error("Failed to repair file: " + tail_path());
+            }
+
+            if (tail_size == 0) {
+                TailHeader header{};
+                std::memcpy(header.magic, TAIL_MAGIC, sizeof(TAIL_MAGIC));
+                header.header_size = sizeof(TailHeader);
+                header.version = TAIL_VERSION;
+                record.insert(0, reinterpret_cast<const char *>(&header), sizeof(header));
+            }
+
+            bool written = write(fd, record.data(), record.size()) == static_cast<ssize_t>(record.size());
+            close(fd);
+            if (!written) {
+                throw std::runtime_error("Failed to write file: " + tail_path());
+            }
+        }
+
+        append_to_tail(raw_id.data(), timestamp, parent_positions, commit.message, commit.branch_name, commit.author,
+                       commit.changed_paths);
     }
 
     void CommitGraph::add_commit(Commit commit, const std::vector<std::string> &parents) {
-        std::vector<std::string> pointers_to_parents;
-        pointers_to_parents.reserve(parents.size());
+        commit.parents = parents;
+        add_commit(commit);
+    }
 
-        for (const auto &parent: parents) {
-            if (commits.contains(parent))
-                pointers_to_parents.push_back(parent);
+    void CommitGraph::append_to_tail(const unsigned char *raw_id, int64_t timestamp,
+                                     const std::vector<uint32_t> &parents, std::string_view message,
+                                     std::string_view branch_name, std::string_view author,
+                                     std::optional<std::string_view> changed_paths) {
+        CommitRecord record{};
+        record.timestamp = timestamp;
+        record.generation = 1;
+        record.parents_begin = static_cast<uint32_t>(tail_edges.size());
+        for (uint32_t parent: parents) {
+            record.generation = std::max(record.generation, get_generation(parent) + 1);
+            tail_edges.push_back(parent);
         }
-        commit.parents = pointers_to_parents;
-        add_commit(commit);
+
+        auto add_string = [this](std::string_view value, uint32_t &offset, uint32_t &size) {
+            offset = static_cast<uint32_t>(tail_heap.size());
+            size = static_cast<uint32_t>(value.size());
+            tail_heap += value;
+        };
+        add_string(message, record.message_offset, record.message_size);
+        add_string(branch_name, record.branch_offset, record.branch_size);
+        add_string(author, record.author_offset, record.author_size);
+        if (changed_paths) {
+            record.changed_paths = static_cast<uint32_t>(tail_heap.size()) + 1;
+            append_string(tail_heap, *changed_paths);
+        }
+
+        tail_ids.insert(tail_ids.end(), raw_id, raw_id + ID_SIZE);
+        tail_records.push_back(record);
+        walk_flags.push_back(0);
+    }
+
+    void CommitGraph::load_tail(const std::string &tail) {
+        TailHeader header{};
+        if (tail.size() < sizeof(header)) {
+            return;
+        }
+        std::memcpy(&header, tail.data(), sizeof(header));
+        if (std::memcmp(header.magic, TAIL_MAGIC, sizeof(TAIL_MAGIC)) != 0 || header.version != TAIL_VERSION ||
+            header.header_size < sizeof(header)) {
+            throw std::runtime_error("Corrupt commit graph tail: " + tail_path());
+        }
+
+        size_t offset = header.header_size;
+        auto read = [&tail, &offset](void *destination, size_t size, size_t end) {
+            if (offset + size > end) {
+                return false;
+            }
+            std::memcpy(destination, tail.data() + offset, size);
+            offset += size;
+            return true;
+        };
+
+        while (offset + sizeof(uint32_t) <= tail.size()) {
+            uint32_t record_size;
+            std::memcpy(&record_size, tail.data() + offset, sizeof(record_size));
+            offset += sizeof(record_size);
+            size_t end = offset + record_size;
+            if (end > tail.size()) {
+                // Torn by a crash while appending.
+                break;
+            }
+
+            unsigned char raw_id[ID_SIZE];
+            int64_t timestamp;
+            uint32_t parent_count;
+            if (!read(raw_id, ID_SIZE, end) || !read(&timestamp, sizeof(timestamp), end) ||
+                !read(&parent_count, sizeof(parent_count), end)) {
+                throw std::runtime_error("Corrupt commit graph tail: " + tail_path());
+            }
+
+            std::vector<uint32_t> parents;
+            for (uint32_t i = 0; i < parent_count; ++i) {
+                unsigned char raw_parent[ID_SIZE];
+                if (!read(raw_parent, ID_SIZE, end)) {
+                    throw std::runtime_error("Corrupt commit graph tail: " + tail_path());
+                }
+                if (auto parent = find_raw_id(raw_parent)) {
+                    parents.push_back(*parent);
+                }
+            }
+
+            std::string_view strings[3];
+            for (auto &value: strings) {
+                uint32_t value_size;
+                if (!read(&value_size, sizeof(value_size), end) || offset + value_size > end) {
+                    throw std::runtime_error("Corrupt commit graph tail: " + tail_path());
+                }
+                value = std::string_view(tail.data() + offset, value_size);
+                offset += value_size;
+            }
+
+            std::optional<std::string_view> changed_paths;
+            uint32_t filter_size;
+            if (read(&filter_size, sizeof(filter_size), end) && offset + filter_size <= end) {
+                changed_paths = std::string_view(tail.data() + offset, filter_size);
+            }
+            offset = end;
+
+            // A compaction that stopped before emptying the tail leaves commits that are already in the segment.
+            if (!find_raw_id(raw_id)) {
+                append_to_tail(raw_id, timestamp, parents, strings[0], strings[1], strings[2], changed_paths);
+            }
+        }
+    }
+
+    bool CommitGraph::parse_id(std::string_view checksum, std::array<unsigned char, 20> &raw_id) {
+        if (checksum.size() != 2 * ID_SIZE) {
+            return false;
+        }
+
+        for (size_t i = 0; i < ID_SIZE; ++i) {
+            int high = hex_value(checksum[2 * i]);
+            int low = hex_value(checksum[2 * i + 1]);
+            if (high < 0 || low < 0) {
+                return false;
+            }
+            raw_id[i] = static_cast<unsigned char>(high << 4 | low);
+        }
+        return true;
+    }
+
+    std::optional<uint32_t> CommitGraph::get_commit(std::string_view checksum) const {
+        std::array<unsigned char, 20> raw_id{};
+        if (!parse_id(checksum, raw_id)) {
+            return std::nullopt;
+        }
+        return find_raw_id(raw_id.data());
+    }
+
+    std::vector<uint32_t> CommitGraph::find_prefix(std::string_view prefix, size_t limit) const {
+        std::vector<uint32_t> matches;
+        if (prefix.empty() || prefix.size() > 2 * ID_SIZE) {
+            return matches;
+        }
+
+        // The smallest id with the prefix: its digits followed by zeros.
+        std::array<unsigned char, 20> lowest{};
+        for (size_t i = 0; i < prefix.size(); ++i) {
+            int digit = hex_value(prefix[i]);
+            if (digit < 0) {
+                return matches;
+            }
+            lowest[i / 2] |= static_cast<unsigned char>(i % 2 == 0 ? digit << 4 : digit);
+        }
+
+        uint32_t first = lower_bound(lowest.data());
+        for (uint32_t position = first; position < segment_count && matches.size() < limit; ++position) {
+            if (common_hex_digits(ids + ID_SIZE * position, lowest.data()) < prefix.size()) {
+                break;
+            }
+            matches.push_back(position);
+        }
+
+        for (uint32_t i = 0; i < tail_records.size() && matches.size() < limit; ++i) {
+            if (common_hex_digits(tail_ids.data() + ID_SIZE * i, lowest.data()) >= prefix.size()) {
+                matches.push_back(segment_count + i);
+            }
+        }
+        return matches;
+    }
+
+    size_t CommitGraph::unique_prefix_length(uint32_t commit, size_t min_length) const {
+        const unsigned char *raw_id = get_raw_id(commit);
+        size_t longest_common = 0;
+        auto compare = [&](uint32_t other) {
+            if (other != commit) {
+                longest_common = std::max(longest_common, common_hex_digits(raw_id, get_raw_id(other)));
+            }
+        };
+
+        // In a sorted table, the ids sharing the longest prefix with an id are next to it.
+        uint32_t position = commit < segment_count ? commit : lower_bound(raw_id);
+        if (position > 0) {
+            compare(position - 1);
+        }
+        if (position < segment_count) {
+            compare(position);
+        }
+        if (position + 1 < segment_count) {
+            compare(position + 1);
+        }
+        for (uint32_t i = 0; i < tail_records.size(); ++i) {
+            compare(segment_count + i);
+        }
+
+        return std::min(2 * ID_SIZE, std::max(min_length, longest_common + 1));
+    }
+
+    uint32_t CommitGraph::lower_bound(const unsigned char *raw_id) const {
+        uint32_t low = 0;
+        uint32_t high = segment_count;
+        while (low < high) {
+            uint32_t middle = low + (high - low) / 2;
+            if (std::memcmp(ids + ID_SIZE * middle, raw_id, ID_SIZE) < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    }
+
+    std::optional<uint32_t> CommitGraph::find_raw_id(const unsigned char *raw_id) const {
+        // Binary search over the sorted id table of the segment.
+        uint32_t position = lower_bound(raw_id);
+        if (position < segment_count && std::memcmp(ids + ID_SIZE * position, raw_id, ID_SIZE) == 0) {
+            return position;
+        }
+
+        // The tail is small and in the order the commits were added.
+        for (uint32_t i = 0; i < tail_records.size(); ++i) {
+            if (std::memcmp(tail_ids.data() + ID_SIZE * i, raw_id, ID_SIZE) == 0) {
+                return segment_count + i;
+            }
+        }
+        return std::nullopt;
+    }
+
+    uint32_t CommitGraph::size() const {
+        return segment_count + static_cast<uint32_t>(tail_records.size());
+    }
+
+    const unsigned char *CommitGraph::get_raw_id(uint32_t commit) const {
+        return commit < segment_count ? ids + ID_SIZE * commit : tail_ids.data() + ID_SIZE * (commit - segment_count);
+    }
+
+    const CommitRecord &CommitGraph::get_record(uint32_t commit) const {
+        return commit < segment_count ? records[commit] : tail_records[commit - segment_count];
+    }
+
+    const char *CommitGraph::get_heap(uint32_t commit) const {
+        return commit < segment_count ? string_heap : tail_heap.data();
+    }
+
+    std::string CommitGraph::get_checksum(uint32_t commit) const {
+        static constexpr char digits[] = "0123456789abcdef";
+        std::string checksum(2 * ID_SIZE, '0');
+        const unsigned char *raw_id = get_raw_id(commit);
+        for (size_t i = 0; i < ID_SIZE; ++i) {
+            checksum[2 * i] = digits[raw_id[i] >> 4];
+            checksum[2 * i + 1] = digits[raw_id[i] & 0xf];
+        }
+        return checksum;
     }
 
-    std::shared_ptr<Commit> CommitGraph::get_commit(const std::string &checksum) {
-        auto commit = commits.find(checksum);
-        if (commit == commits.end()) {
-            return nullptr;
-        } else {
-            return std::make_unique<Commit>(commits.at(checksum));
+    std::chrono::system_clock::time_point CommitGraph::get_timestamp(uint32_t commit) const {
+        return std::chrono::system_clock::time_point(std::chrono::system_clock::duration(get_record(commit).timestamp));
+    }
+
+    uint32_t CommitGraph::get_generation(uint32_t commit) const {
+        return get_record(commit).generation;
+    }
+
+    std::span<const uint32_t> CommitGraph::get_parents(uint32_t commit) const {
+        if (commit < segment_count) {
+            uint32_t end = commit + 1 < segment_count ? records[commit + 1].parents_begin : segment_edge_count;
+            return {edges + records[commit].parents_begin, edges + end};
         }
+
+        size_t index = commit - segment_count;
+        size_t end = index + 1 < tail_records.size() ? tail_records[index + 1].parents_begin : tail_edges.size();
+        return {tail_edges.data() + tail_records[index].parents_begin, tail_edges.data() + end};
+    }
+
+    std::string_view CommitGraph::get_message(uint32_t commit) const {
+        const CommitRecord &record = get_record(commit);
+        return {get_heap(commit) + record.message_offset, record.message_size};
+    }
+
+    std::string_view CommitGraph::get_branch_name(uint32_t commit) const {
+        const CommitRecord &record = get_record(commit);
+        return {get_heap(commit) + record.branch_offset, record.branch_size};
     }
 
-    using CommitMap = std::unordered_map<std::string, Commit>;
+    std::string_view CommitGraph::get_author(uint32_t commit) const {
+        const CommitRecord &record = get_record(commit);
+        return {get_heap(commit) + record.author_offset, record.author_size};
+    }
+
+    std::optional<std::string_view> CommitGraph::get_changed_paths(uint32_t commit) const {
+        const CommitRecord &record = get_record(commit);
+        if (record.changed_paths == 0) {
+            return std::nullopt;
+        }
+
+        uint32_t filter_size;
+        const char *filter = get_heap(commit) + record.changed_paths - 1;
+        std::memcpy(&filter_size, filter, sizeof(filter_size));
+        return std::string_view(filter + sizeof(filter_size), filter_size);
+    }
 
-    std::shared_ptr<Commit>
+    std::optional<uint32_t>
     CommitGraph::get_intersection_commit(const std::string &checksum1, const std::string &checksum2) {
         // Find the commits corresponding to the checksums
-        auto commit1 = commits.find(checksum1);
-        auto commit2 = commits.find(checksum2);
+        auto commit1 = get_commit(checksum1);
+        auto commit2 = get_commit(checksum2);
 
-        if (commit1 == commits.end() || commit2 == commits.end()) {
+        if (!commit1 || !commit2) {
             std::cerr << "One or both commits not found" << std::endl;
-            return nullptr;
+            return std::nullopt;
         }
 
-        std::unordered_set<std::string> ancestors;
+        std::vector<uint32_t> merge_bases = get_merge_bases(*commit1, *commit2);
+        if (merge_bases.empty()) {
+            return std::nullopt;
+        }
+        return merge_bases.front();
+    }
+
+    bool CommitGraph::walk_order(uint32_t commit1, uint32_t commit2) const {
+        const CommitRecord &record1 = get_record(commit1);
+        const CommitRecord &record2 = get_record(commit2);
+        if (record1.generation != record2.generation) {
+            return record1.generation < record2.generation;
+        }
+        return record1.timestamp < record2.timestamp;
+    }
+
+    void CommitGraph::mark(uint32_t commit, uint8_t flags) {
+        if (walk_flags[commit] == 0) {
+            walk_touched.push_back(commit);
+        }
+        walk_flags[commit] |= flags;
+    }
+
+    void CommitGraph::clear_marks() {
+        for (uint32_t commit: walk_touched) {
+            walk_flags[commit] = 0;
+        }
+        walk_touched.clear();
+        walk_stack.clear();
+    }
+
+    std::vector<uint32_t> CommitGraph::paint_down_to_common(uint32_t commit1, const std::vector<uint32_t> &others,
+                                                            uint32_t min_generation) {
+        // paint_queue is a max-heap ordered by generation, so every descendant of a commit is popped before it.
+        // Each entry remembers whether it was counted as non-stale when pushed, so that only those are uncounted.
+        auto later_first = [this](const std::pair<uint32_t, bool> &a, const std::pair<uint32_t, bool> &b) {
+            return walk_order(a.first, b.first);
+        };
+        size_t nonstale = 0;
+        auto push = [&](uint32_t commit) {
+            bool counted = !(walk_flags[commit] & STALE);
+            paint_queue.emplace_back(commit, counted);
+            std::push_heap(paint_queue.begin(), paint_queue.end(), later_first);
+            nonstale += counted ? 1 : 0;
+        };
+
+        mark(commit1, PARENT1);
+        push(commit1);
+        for (uint32_t other: others) {
+            mark(other, PARENT2);
+            push(other);
+        }
+
+        std::vector<uint32_t> results;
+        // An entry that went stale after being counted only prolongs the walk.
+        while (nonstale > 0 && !paint_queue.empty()) {
+            std::pop_heap(paint_queue.begin(), paint_queue.end(), later_first);
+            auto [commit, counted] = paint_queue.back();
+            paint_queue.pop_back();
+            nonstale -= counted ? 1 : 0;
+
+            if (get_generation(commit) < min_generation) {
+                break;
+            }
+
+            uint8_t flags = walk_flags[commit] & (PARENT1 | PARENT2 | STALE);
+            if (flags == (PARENT1 | PARENT2)) {
+                if (!(walk_flags[commit] & RESULT)) {
+                    mark(commit, RESULT);
+                    results.push_back(commit);
+                }
+                // Everything below a common ancestor is a common ancestor too, but not a best one.
+                flags |= STALE;
+            }
 
-        // Traverse parents of the first commit and store all ancestors
-        std::vector<Commit> stack1 = {commit1->second};
-        while (!stack1.empty()) {
-            auto current = stack1.back();
-            stack1.pop_back();
-            if (ancestors.insert(current.checksum).second) {  // Insert and check if it was not already present
-                for (const auto &parent: current.parents) {
-                    stack1.push_back(commits.at(parent));
+            // Flags only grow, so each commit is pushed at most once per flag: the walk is linear.
+            for (uint32_t parent: get_parents(commit)) {
+                if ((walk_flags[parent] & flags) == flags) {
+                    continue;
                 }
+                mark(parent, flags);
+                push(parent);
             }
         }
 
-        std::vector<Commit> stack2 = {commit2->second};
-        std::vector<Commit> intersections;
+        paint_queue.clear();
+        return results;
+    }
+
+    std::vector<uint32_t> CommitGraph::get_merge_bases(uint32_t commit1, uint32_t commit2) {
+        if (commit1 == commit2) {
+            return {commit1};
+        }
 
-        while (!stack2.empty()) {
-            auto current = stack2.back();
-            stack2.pop_back();
-            if (ancestors.find(current.checksum) != ancestors.end()) {
-                intersections.push_back(current);  // Intersection found
+        std::vector<uint32_t> candidates = paint_down_to_common(commit1, {commit2}, 0);
+        clear_marks();
+
+        // A candidate reached from another candidate is one of its ancestors and not a best common ancestor.
+        // Painting from the others stops below the lowest generation among the candidates.
+        if (candidates.size() > 1) {
+            uint32_t min_generation = UINT32_MAX;
+            for (uint32_t candidate: candidates) {
+                min_generation = std::min(min_generation, get_generation(candidate));
             }
 
-            for (const auto &parent: current.parents) {
-                stack2.push_back(commits.at(parent));
+            std::vector<bool> redundant(candidates.size(), false);
+            for (size_t i = 0; i < candidates.size(); ++i) {
+                if (redundant[i]) {
+                    continue;
+                }
+                std::vector<uint32_t> others;
+                for (size_t j = 0; j < candidates.size(); ++j) {
+                    if (j != i && !redundant[j]) {
+                        others.push_back(candidates[j]);
+                    }
+                }
+
+                paint_down_to_common(candidates[i], others, min_generation);
+                if (walk_flags[candidates[i]] & PARENT2) {
+                    redundant[i] = true;
+                }
+                for (size_t j = 0; j < candidates.size(); ++j) {
+                    if (j != i && (walk_flags[candidates[j]] & PARENT1)) {
+                        redundant[j] = true;
+                    }
+                }
+                clear_marks();
             }
+
+            std::vector<uint32_t> merge_bases;
+            for (size_t i = 0; i < candidates.size(); ++i) {
+                if (!redundant[i]) {
+                    merge_bases.push_back(candidates[i]);
+                }
+            }
+            candidates = std::move(merge_bases);
+        }
+
+        std::sort(candidates.begin(), candidates.end(),
+                  [this](uint32_t a, uint32_t b) { return walk_order(b, a); });
+        return candidates;
+    }
+
+    bool CommitGraph::is_ancestor(uint32_t ancestor, uint32_t descendant) {
+        if (ancestor == descendant) {
+            return true;
+        }
+
+        // Every commit below the generation of the ancestor is too old to lead to it.
+        uint32_t min_generation = get_generation(ancestor);
+        if (min_generation >= get_generation(descendant)) {
+            return false;
         }
 
-        if (intersections.empty()) {
-            return nullptr;  // No intersection found
-        } else {
-            std::sort(intersections.begin(), intersections.end(),
-                      [](const Commit &commit1, const Commit &commit2) {
-                          return commit2.timestamp < commit1.timestamp;
-                      });
-            Commit commit = intersections.front();
-            return std::make_unique<Commit>(commit);
+        bool found = false;
+        mark(descendant, PARENT1);
+        walk_stack.push_back(descendant);
+        while (!walk_stack.empty() && !found) {
+            uint32_t commit = walk_stack.back();
+            walk_stack.pop_back();
+
+            for (uint32_t parent: get_parents(commit)) {
+                if (parent == ancestor) {
+                    found = true;
+                    break;
+                }
+                if (walk_flags[parent] != 0 || get_generation(parent) <= min_generation) {
+                    continue;
+                }
+                mark(parent, PARENT1);
+                walk_stack.push_back(parent);
+            }
         }
+
+        clear_marks();
+        return found;
     }
 
-    void pretty_print(const Commit &commit, const std::string &addition) {
-        std::string add = addition.empty() ? "" : (" (" + addition + ")");
-        std::cout << GREEN << commit.checksum << YELLOW << add << std::endl;  // Green for 'commit'
-        std::cout << BLUE << "Author: " << RESET << "Unknown" << std::endl;  // Blue for 'Author'
-        std::cout << CYAN << "Date:  " << RESET << time_point_to_string(commit.timestamp)
-                  << std::endl;  // Cyan for 'Date'
-        std::cout << std::endl;
-        std::cout << YELLOW << "\t" << commit.message << RESET << std::endl;  // Yellow for commit message
-        std::cout << std::endl;
+    std::pair<uint32_t, uint32_t> CommitGraph::ahead_behind(uint32_t commit, uint32_t base) {
+        return ahead_behind(base, std::vector<uint32_t>{commit}).front();
     }
 
-    void CommitGraph::print_commit_history(std::string checksum) const {
+    std::vector<std::pair<uint32_t, uint32_t>>
+    CommitGraph::ahead_behind(uint32_t base, const std::vector<uint32_t> &tips) {
+        std::vector<std::pair<uint32_t, uint32_t>> counts(tips.size(), {0, 0});
+        if (tips.empty()) {
+            return counts;
+        }
 
-        while (commits.contains(checksum)) {
+        // Bit 0 stands for the base and bit i + 1 for tip i. A commit reached from every one of them counts for
+        // nothing, and neither do its ancestors, so the walk stops once only such commits are left in the queue.
+        const size_t bit_count = tips.size() + 1;
+        const size_t word_count = (bit_count + 63) / 64;
+        auto is_full = [&](const uint64_t *bits) {
+            for (size_t word = 0; word < word_count; ++word) {
+                size_t bits_in_word = std::min<size_t>(64, bit_count - 64 * word);
+                uint64_t all = bits_in_word == 64 ? ~uint64_t(0) : (uint64_t(1) << bits_in_word) - 1;
+                if (bits[word] != all) {
+                    return false;
+                }
+            }
+            return true;
+        };
 
-            auto commit = commits.at(checksum);
+        // Commits are popped in generation order, so a commit has been reached from all its descendants first.
+        // Each commit has a row of word_count words in reach_bits; the rows of the commits marked by the walk are
+        // the only ones set, and they are zeroed again at the end.
+        size_t row_count = size();
+        if (reach_bits.size() < row_count * word_count) {
+            reach_bits.resize(row_count * word_count, 0);
+        }
+        auto row = [&](uint32_t commit) { return reach_bits.data() + commit * word_count; };
+        auto later_first = [this](uint32_t a, uint32_t b) { return walk_order(a, b); };
+        size_t unfinished = 0;
+        auto reach = [&](uint32_t target, const uint64_t *bits) {
+            bool inserted = walk_flags[target] == 0;
+            uint64_t *target_bits = row(target);
+            bool was_full = !inserted && is_full(target_bits);
+            for (size_t word = 0; word < word_count; ++word) {
+                target_bits[word] |= bits[word];
+            }
+            if (inserted) {
+                mark(target, PARENT1);
+                walk_stack.push_back(target);
+                std::push_heap(walk_stack.begin(), walk_stack.end(), later_first);
+                unfinished += is_full(target_bits) ? 0 : 1;
+            } else if (!was_full && is_full(target_bits)) {
+                --unfinished;
+            }
+        };
+
+        std::vector<uint64_t> start(word_count, 0);
+        start[0] = 1;
+        reach(base, start.data());
+        for (size_t tip = 0; tip < tips.size(); ++tip) {
+            std::fill(start.begin(), start.end(), 0);
+            start[(tip + 1) / 64] = uint64_t(1) << ((tip + 1) % 64);
+            reach(tips[tip], start.data());
+        }
+
+        while (unfinished > 0 && !walk_stack.empty()) {
+            std::pop_heap(walk_stack.begin(), walk_stack.end(), later_first);
+            uint32_t commit = walk_stack.back();
+            walk_stack.pop_back();
 
-            pretty_print(commit, "");
+            const uint64_t *bits = row(commit);
+            if (is_full(bits)) {
+                continue;
+            }
+            --unfinished;
 
-            for (const auto &p_checksum: commit.parents) {
-                auto parent = commits.at(p_checksum);
-                if (parent.branch_name == commit.branch_name) {
-                    checksum = parent.checksum;
-                } else {
-                    pretty_print(parent, parent.branch_name);
+            bool from_base = bits[0] & 1;
+            for (size_t tip = 0; tip < tips.size(); ++tip) {
+                bool from_tip = bits[(tip + 1) / 64] >> ((tip + 1) % 64) & 1;
+                if (from_tip && !from_base) {
+                    ++counts[tip].first;
+                } else if (from_base && !from_tip) {
+                    ++counts[tip].second;
                 }
             }
 
-            //when no parent was found
-            if (checksum == commit.checksum)
-                break;
+            for (uint32_t parent: get_parents(commit)) {
+                reach(parent, bits);
+            }
+        }
+
+        for (uint32_t commit: walk_touched) {
+            std::fill_n(row(commit), word_count, 0);
         }
+        clear_marks();
+        return counts;
+    }
+
+    std::string CommitGraph::build_image(std::vector<Commit> commits) {
+        std::vector<std::pair<std::array<unsigned char, 20>, size_t>> sorted_ids;
+        sorted_ids.reserve(commits.size());
+        for (size_t i = 0; i < commits.size(); ++i) {
+            std::array<unsigned char, 20> raw_id{};
+            if (parse_id(commits[i].checksum, raw_id)) {
+                sorted_ids.emplace_back(raw_id, i);
+            }
+        }
+        std::sort(sorted_ids.begin(), sorted_ids.end());
+        sorted_ids.erase(std::unique(sorted_ids.begin(), sorted_ids.end(),
+                                     [](const auto &a, const auto &b) { return a.first == b.first; }),
+                         sorted_ids.end());
+
+        std::unordered_map<std::string, uint32_t> positions;
+        for (uint32_t position = 0; position < sorted_ids.size(); ++position) {
+            positions.emplace(commits[sorted_ids[position].second].checksum, position);
+        }
+
+        // Parent edges in CSR layout, keeping only parents that are in the graph.
+        std::vector<uint32_t> parents_begin(sorted_ids.size() + 1, 0);
+        std::vector<uint32_t> edge_list;
+        for (uint32_t position = 0; position < sorted_ids.size(); ++position) {
+            parents_begin[position] = static_cast<uint32_t>(edge_list.size());
+            for (const auto &parent: commits[sorted_ids[position].second].parents) {
+                auto parent_position = positions.find(parent);
+                if (parent_position != positions.end()) {
+                    edge_list.push_back(parent_position->second);
+                }
+            }
+        }
+        parents_begin[sorted_ids.size()] = static_cast<uint32_t>(edge_list.size());
+
+        // Generation numbers, computed parents first without recursion.
+        std::vector<uint32_t> generations(sorted_ids.size(), 0);
+        std::vector<uint32_t> stack;
+        for (uint32_t position = 0; position < sorted_ids.size(); ++position) {
+            stack.push_back(position);
+            while (!stack.empty()) {
+                uint32_t current = stack.back();
+                if (generations[current] != 0) {
+                    stack.pop_back();
+                    continue;
+                }
+
+                uint32_t generation = 1;
+                bool parents_done = true;
+                for (uint32_t edge = parents_begin[current]; edge < parents_begin[current + 1]; ++edge) {
+                    uint32_t parent = edge_list[edge];
+                    if (generations[parent] == 0) {
+                        parents_done = false;
+                        stack.push_back(parent);
+                    } else {
+                        generation = std::max(generation, generations[parent] + 1);
+                    }
+                }
+
+                if (parents_done) {
+                    generations[current] = generation;
+                    stack.pop_back();
+                }
+            }
+        }
+
+        std::string heap;
+        auto add_string = [&heap](const std::string &value, uint32_t &offset, uint32_t &size) {
+            offset = static_cast<uint32_t>(heap.size());
+            size = static_cast<uint32_t>(value.size());
+            heap += value;
+        };
+
+        std::vector<CommitRecord> commit_records(sorted_ids.size());
+        for (uint32_t position = 0; position < sorted_ids.size(); ++position) {
+            const Commit &commit = commits[sorted_ids[position].second];
+            CommitRecord &record = commit_records[position];
+            record = {};
+            record.timestamp = commit.timestamp.time_since_epoch().count();
+            record.generation = generations[position];
+            record.parents_begin = parents_begin[position];
+            add_string(commit.message, record.message_offset, record.message_size);
+            add_string(commit.branch_name, record.branch_offset, record.branch_size);
+            add_string(commit.author, record.author_offset, record.author_size);
+            if (commit.changed_paths) {
+                record.changed_paths = static_cast<uint32_t>(heap.size()) + 1;
+                append_string(heap, *commit.changed_paths);
+            }
+        }
+
+        GraphHeader header{};
+        std::memcpy(header.magic, GRAPH_MAGIC, sizeof(GRAPH_MAGIC));
+        header.version = GRAPH_VERSION;
+        header.commit_count = static_cast<uint32_t>(sorted_ids.size());
+        header.edge_count = static_cast<uint32_t>(edge_list.size());
+        header.heap_size = heap.size();
+
+        GraphLayout layout(header.commit_count, header.edge_count, header.heap_size);
+        std::string image(layout.end, '\0');
+        std::memcpy(image.data(), &header, sizeof(header));
+        for (uint32_t position = 0; position < sorted_ids.size(); ++position) {
+            std::memcpy(image.data() + layout.ids + ID_SIZE * position, sorted_ids[position].first.data(), ID_SIZE);
+        }
+        std::memcpy(image.data() + layout.records, commit_records.data(), sizeof(CommitRecord) * commit_records.size());
+        std::memcpy(image.data() + layout.edges, edge_list.data(), sizeof(uint32_t) * edge_list.size());
+        std::memcpy(image.data() + layout.heap, heap.data(), heap.size());
+        return image;
     }
 
     void CommitGraph::save_commits(const std::string &file_path) {
@@ -136,94 +947,201 @@ namespace manager {
             fs::create_directories(destination_dir);
         }
 
-        std::ostringstream oss;
+        GraphLock lock(file_path + ".lock");
+        load_commits(file_path);
 
-        size_t map_size = commits.size();
-        oss.write(reinterpret_cast<const char *>(&map_size), sizeof(map_size));
+        std::vector<Commit> commits;
+        commits.reserve(size());
+        for (uint32_t position = 0; position < size(); ++position) {
+            Commit commit;
+            commit.checksum = get_checksum(position);
+            commit.message = get_message(position);
+            commit.branch_name = get_branch_name(position);
+            commit.author = get_author(position);
+            commit.timestamp = get_timestamp(position);
+            if (auto changed_paths = get_changed_paths(position)) {
+                commit.changed_paths = std::string(*changed_paths);
+            }
+            for (uint32_t parent: get_parents(position)) {
+                commit.parents.push_back(get_checksum(parent));
+            }
+            commits.push_back(std::move(commit));
+        }
 
-        for (const auto &[_, commit]: commits) {
-            size_t checksum_size = commit.checksum.size();
-            oss.write(reinterpret_cast<const char *>(&checksum_size), sizeof(checksum_size));
-            oss.write(commit.checksum.data(), checksum_size);
+        std::string image = build_image(std::move(commits));
 
-            size_t message_size = commit.message.size();
-            oss.write(reinterpret_cast<const char *>(&message_size), sizeof(message_size));
-            oss.write(commit.message.data(), message_size);
+        std::string temp_path = file_path + ".tmp";
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Failed to open file for writing: " + temp_path);
+        }
+        out.write(image.data(), static_cast<std::streamsize>(image.size()));
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Failed to write file: " + temp_path);
+        }
 
-            size_t branch_size = commit.branch_name.size();
-            oss.write(reinterpret_cast<const char *>(&branch_size), sizeof(branch_size));
-            oss.write(commit.branch_name.data(), branch_size);
+        // The segment is replaced before the tail is emptied, and readers read the tail first, so a reader sees
+        // every commit at least once; commits found in both are skipped when the tail is read.
+        release_image();
+        fs::rename(temp_path, file_path);
+        if (fs::exists(tail_path())) {
+            fs::resize_file(tail_path(), 0);
+        }
+        load_commits(file_path);
+    }
 
-            size_t author_size = commit.author.size();
-            oss.write(reinterpret_cast<const char *>(&author_size), sizeof(author_size));
-            oss.write(commit.author.data(), author_size);
+    bool CommitGraph::needs_compaction() const {
+        return !converted_image.empty() || tail_records.size() >= TAIL_COMPACTION_THRESHOLD;
+    }
 
-            auto time = commit.timestamp.time_since_epoch().count();
-            oss.write(reinterpret_cast<const char *>(&time), sizeof(time));
+    std::string CommitGraph::tail_path() const {
+        return commit_file_path + ".tail";
+    }
+
+    void CommitGraph::load_commits(const std::string &file_path) {
+        release_image();
 
-            size_t parents_size = commit.parents.size();
-            oss.write(reinterpret_cast<const char *>(&parents_size), sizeof(parents_size));
-            for (const auto &parent: commit.parents) {
-                size_t parent_size = parent.size();
-                oss.write(reinterpret_cast<const char *>(&parent_size), sizeof(parent_size));
-                oss.write(parent.data(), parent_size);
+        // The tail is read before the segment; see save_commits.
+        std::string tail;
+        if (std::ifstream tail_file(tail_path(), std::ios::binary); tail_file) {
+            tail.assign(std::istreambuf_iterator<char>(tail_file), std::istreambuf_iterator<char>());
+        }
+
+        int fd = open(file_path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            if (errno != ENOENT) {
+                throw std::runtime_error("Failed to open file for reading: " + file_path);
             }
+            // No commit has been compacted yet.
+            load_tail(tail);
+            return;
         }
 
-        std::string serialized_data = oss.str();
+        struct stat file_stat{};
+        if (fstat(fd, &file_stat) != 0) {
+            close(fd);
+            throw std::runtime_error("Failed to read file: " + file_path);
+        }
 
-        // Compress the data
-        uLong compressed_size = compressBound(serialized_data.size());
-        std::vector<char> compressed_data(compressed_size);
-        int result = compress(reinterpret_cast<Bytef *>(compressed_data.data()), &compressed_size,
-                              reinterpret_cast<const Bytef *>(serialized_data.data()), serialized_data.size());
+        size_t file_size = static_cast<size_t>(file_stat.st_size);
+        char magic[sizeof(GRAPH_MAGIC)] = {};
+        bool is_graph_file = file_size >= sizeof(GraphHeader) &&
+                             pread(fd, magic, sizeof(magic), 0) == static_cast<ssize_t>(sizeof(magic)) &&
+                             std::memcmp(magic, GRAPH_MAGIC, sizeof(magic)) == 0;
 
-        if (result != Z_OK) {
-            throw std::runtime_error("Compression failed");
+        if (!is_graph_file) {
+            close(fd);
+            // Written in the older compressed format: convert it in memory, the next compaction replaces the file.
+            converted_image = build_image(load_legacy_commits(file_path));
+            attach_image(converted_image.data(), converted_image.size());
+            load_tail(tail);
+            return;
         }
 
-        // Write compressed data to the file
-        std::ofstream out(file_path, std::ios::binary);
-        if (!out) {
-            throw std::runtime_error("Failed to open file for writing: " + file_path);
+        void *image = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (image == MAP_FAILED) {
+            throw std::runtime_error("Failed to map file: " + file_path);
         }
 
-        out.write(reinterpret_cast<const char *>(&compressed_size), sizeof(compressed_size));
-        out.write(compressed_data.data(), compressed_size);
+        mapped = true;
+        attach_image(static_cast<const char *>(image), file_size);
+        load_tail(tail);
+    }
 
-        out.close();
+    void CommitGraph::attach_image(const char *image, size_t image_size) {
+        data = image;
+        data_size = image_size;
+
+        GraphHeader header{};
+        std::memcpy(&header, data, sizeof(header));
+        GraphLayout layout(header.commit_count, header.edge_count, header.heap_size);
+
+        if (header.version != GRAPH_VERSION || layout.end != data_size) {
+            release_image();
+            throw std::runtime_error("Corrupt commit graph: " + commit_file_path);
+        }
+
+        segment_count = header.commit_count;
+        segment_edge_count = header.edge_count;
+        ids = reinterpret_cast<const unsigned char *>(data + layout.ids);
+        records = reinterpret_cast<const CommitRecord *>(data + layout.records);
+        edges = reinterpret_cast<const uint32_t *>(data + layout.edges);
+        string_heap = data + layout.heap;
+
+        walk_flags.assign(segment_count, 0);
+        walk_stack.reserve(segment_count + segment_edge_count);
+        paint_queue.reserve(segment_count + segment_edge_count);
+        walk_touched.reserve(segment_count);
     }
 
-    void CommitGraph::load_commits(const std::string &file_path) {
-        commits.clear();
+    void CommitGraph::release_image() {
+        if (mapped) {
+            munmap(const_cast<char *>(data), data_size);
+        }
+        mapped = false;
+        data = nullptr;
+        data_size = 0;
+        converted_image.clear();
+        segment_count = 0;
+        segment_edge_count = 0;
+        ids = nullptr;
+        records = nullptr;
+        edges = nullptr;
+        string_heap = nullptr;
+        tail_ids.clear();
+        tail_records.clear();
+        tail_edges.clear();
+        tail_heap.clear();
+        walk_flags.clear();
+        walk_touched.clear();
+        reach_bits.clear();
+    }
+
+    std::vector<Commit> CommitGraph::load_legacy_commits(const std::string &file_path) {
+        std::vector<Commit> commits;
         std::ifstream in(file_path, std::ios::binary);
         if (!in) {
             throw std::runtime_error("Failed to open file for reading: " + file_path);
         }
 
         // Read the compressed size
-        uLong compressed_size;
+        uLong compressed_size = 0;
         in.read(reinterpret_cast<char *>(&compressed_size), sizeof(compressed_size));
 
         // Read the compressed data
         std::vector<char> compressed_data(compressed_size);
-        in.read(compressed_data.data(), compressed_size);
-
-        // Decompress the data
-        std::vector<char> decompressed_data(10 * compressed_size);  // Assuming a reasonable decompression size
-        uLong decompressed_size = decompressed_data.size();
-
-        int result = uncompress(reinterpret_cast<Bytef *>(decompressed_data.data()), &decompressed_size,
-                                reinterpret_cast<const Bytef *>(compressed_data.data()), compressed_size);
+        in.read(compressed_data.data(), static_cast<std::streamsize>(compressed_size));
+        if (!in) {
+            throw std::runtime_error("Failed to read file: " + file_path);
+        }
 
-        if (result == Z_BUF_ERROR) {
-            throw std::runtime_error("Buffer size is insufficient for decompression");
-        } else if (result != Z_OK) {
+        z_stream stream{};
+        if (inflateInit(&stream) != Z_OK) {
             throw std::runtime_error("Decompression failed");
         }
+        stream.next_in = reinterpret_cast<Bytef *>(compressed_data.data());
+        stream.avail_in = static_cast<uInt>(compressed_size);
+
+        // Inflate a chunk at a time, so that the size of the decompressed data need not be guessed.
+        std::string decompressed_data;
+        char chunk[LEGACY_INFLATE_CHUNK_SIZE];
+        int result = Z_OK;
+        while (result != Z_STREAM_END) {
+            stream.next_out = reinterpret_cast<Bytef *>(chunk);
+            stream.avail_out = sizeof(chunk);
+            result = inflate(&stream, Z_NO_FLUSH);
+            if (result != Z_OK && result != Z_STREAM_END) {
+                inflateEnd(&stream);
+                throw std::runtime_error("Decompression failed");
+            }
+            decompressed_data.append(chunk, sizeof(chunk) - stream.avail_out);
+        }
+        inflateEnd(&stream);
 
         // Convert decompressed data to an input stream
-        std::istringstream iss(std::string(decompressed_data.data(), decompressed_size));
+        std::istringstream iss(std::move(decompressed_data));
 
         size_t map_size;
         iss.read(reinterpret_cast<char *>(&map_size), sizeof(map_size));
@@ -266,16 +1184,19 @@ namespace manager {
                 commit.parents[j] = parent;
             }
 
-            commits[commit.checksum] = commit;
+            commits.push_back(std::move(commit));
         }
 
         in.close();
+        return commits;
     }
 
     CommitGraph::CommitGraph(std::string commit_file_path) : commit_file_path(std::move(commit_file_path)) {
-        if (fs::exists(this->commit_file_path)) {
-            load_commits(this->commit_file_path);
-        }
+        load_commits(this->commit_file_path);
+    }
+
+    CommitGraph::~CommitGraph() {
+        release_image();
     }
 
 }
@@ -5,6 +5,11 @@
 #ifndef JIT_COMMITGRAPH_H
 #define JIT_COMMITGRAPH_H
 
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
 #include <unordered_map>
 #include <memory>
 #include "commit.h"
@@ -12,27 +17,280 @@
 
 
 namespace manager {
+
+    /**
+     * Fixed-width record of one commit in the commit-graph file.
+     *
+     * The parents of commit `i` are `edges[parents_begin[i] .. parents_begin[i + 1])`, with the edge count closing
+     * the last range. Strings are offsets into the string heap at the end of the file. The changed-path filter is
+     * stored in the heap as a 32-bit size followed by the filter bytes; graphs written before such filters existed
+     * have 0 in its place.
+     */
+    struct CommitRecord {
+        int64_t timestamp;        ///< system_clock ticks since the epoch.
+        uint32_t generation;      ///< 1 for a root commit, otherwise one more than the highest parent generation.
+        uint32_t parents_begin;   ///< First entry of the commit's parents in the edge array.
+        uint32_t message_offset;
+        uint32_t message_size;
+        uint32_t branch_offset;
+        uint32_t branch_size;
+        uint32_t author_offset;
+        uint32_t author_size;
+        uint32_t changed_paths;   ///< One more than the heap offset of the changed-path filter, 0 if there is none.
+    };
+
+    /**
+     * The graph of all commits, read from a compacted segment that is mapped into memory and a small append-only tail.
+     *
+     * The segment holds a header, the sorted table of raw 20-byte commit ids, one CommitRecord per id, the parent
+     * edges as positions in the id table, and a heap with the messages, branch names and authors. It is never modified
+     * in place. The tail, stored next to it with a `.tail` suffix, starts with a length-prefixed header followed by one
+     * length-prefixed record per commit added since the last compaction; a record torn by a crash is ignored, and cut
+     * off before the next one is appended.
+     *
+     * A commit is identified by its position: the segment's commits come first, then the tail's in the order they were
+     * added. Looking one up is a binary search in the segment and a scan of the tail, and reading its parents,
+     * generation or timestamp touches only the records. Strings are read only when asked for.
+     *
+     * Adding a commit appends one record to the tail. Once the tail holds enough records, it is merged into a new
+     * segment by `jit commit-graph write`, which commands start in the background. Files written in the older
+     * compressed format are converted when loaded and replaced by the next compaction.
+     */
     class CommitGraph{
     public:
         explicit CommitGraph(std::string commit_file_path);
 
+        ~CommitGraph();
+
+        CommitGraph(const CommitGraph &) = delete;
+
+        CommitGraph &operator=(const CommitGraph &) = delete;
+
+        /**
+         * Appends a commit to the tail; parents that are not in the graph are left out.
+         *
+         * Does nothing if the commit is already in the graph.
+         */
         void add_commit(const Commit &commit);
 
+        /**
+         * Appends a commit whose parents are the given commits to the tail.
+         */
         void add_commit(Commit commit, const std::vector<std::string> &parents);
 
-        std::shared_ptr<Commit> get_commit(const std::string &checksum);
+        /**
+         * Finds the position of a commit in the graph.
+         *
+         * @param checksum The commit id.
+         * @return The position of the commit, or nothing if it is not in the graph.
+         */
+        [[nodiscard]] std::optional<uint32_t> get_commit(std::string_view checksum) const;
+
+        /**
+         * Finds the commits whose id starts with a hexadecimal prefix, by binary search in the segment and a scan
+         * of the tail.
+         *
+         * @param prefix The first digits of the commit id.
+         * @param limit The number of matches after which the search stops.
+         * @return The positions of the matching commits; empty if the prefix is not hexadecimal.
+         */
+        [[nodiscard]] std::vector<uint32_t> find_prefix(std::string_view prefix, size_t limit = 2) const;
+
+        /**
+         * @return The length of the shortest prefix of a commit id that no other commit starts with, and at least
+         *         `min_length`.
+         */
+        [[nodiscard]] size_t unique_prefix_length(uint32_t commit, size_t min_length = 7) const;
+
+        /**
+         * @return The number of commits in the graph.
+         */
+        [[nodiscard]] uint32_t size() const;
+
+        [[nodiscard]] std::string get_checksum(uint32_t commit) const;
+
+        [[nodiscard]] std::chrono::system_clock::time_point get_timestamp(uint32_t commit) const;
 
-        std::shared_ptr<Commit> get_intersection_commit(const std::string &commit1, const std::string &commit2);
+        [[nodiscard]] uint32_t get_generation(uint32_t commit) const;
 
-        void print_commit_history(std::string checksum) const;
+        [[nodiscard]] std::span<const uint32_t> get_parents(uint32_t commit) const;
 
+        [[nodiscard]] std::string_view get_message(uint32_t commit) const;
+
+        [[nodiscard]] std::string_view get_branch_name(uint32_t commit) const;
+
+        [[nodiscard]] std::string_view get_author(uint32_t commit) const;
+
+        /**
+         * @return The Bloom filter of the paths the commit changed relative to its first parent, or nothing if it was
+         *         not computed when the commit was added.
+         */
+        [[nodiscard]] std::optional<std::string_view> get_changed_paths(uint32_t commit) const;
+
+        /**
+         * Finds the best common ancestor of two commits.
+         *
+         * @return The first of get_merge_bases, or nothing if the commits are not related or not in the graph.
+         */
+        std::optional<uint32_t> get_intersection_commit(const std::string &commit1, const std::string &commit2);
+
+        /**
+         * Finds the best common ancestors of two commits: the common ancestors that are not ancestors of another
+         * common ancestor. Criss-cross merges leave more than one.
+         *
+         * Commits are visited in generation order from a priority queue and painted with the side they were reached
+         * from; below a commit reached from both sides the paint goes stale, so the walk stops once nothing but stale
+         * commits is left and each commit is visited a bounded number of times.
+         *
+         * @return The merge bases, highest generation and most recent first; empty if the commits are not related.
+         */
+        std::vector<uint32_t> get_merge_bases(uint32_t commit1, uint32_t commit2);
+
+        /**
+         * Checks whether `ancestor` can be reached from `descendant` by following parents. Commits whose generation
+         * is not above that of `ancestor` are not walked.
+         */
+        bool is_ancestor(uint32_t ancestor, uint32_t descendant);
+
+        /**
+         * Counts the commits of `commit` that are not in `base`, and those of `base` that are not in `commit`.
+         *
+         * @return The number of commits ahead and behind.
+         */
+        std::pair<uint32_t, uint32_t> ahead_behind(uint32_t commit, uint32_t base);
+
+        /**
+         * Counts how far each tip is ahead of and behind a base, in a single walk for all of them.
+         *
+         * Each commit is tagged with one bit per tip and one for the base as the walk goes down in generation order;
+         * it stops once every queued commit is reached from all of them.
+         *
+         * @return The number of commits ahead and behind for each tip, in the order of `tips`.
+         */
+        std::vector<std::pair<uint32_t, uint32_t>> ahead_behind(uint32_t base, const std::vector<uint32_t> &tips);
+
+        /**
+         * Merges the segment and the tail into a new segment and empties the tail.
+         *
+         * The segment is written next to its destination and renamed over it, so that readers never see a partial
+         * file. The graph is reloaded from disk first, under the commit-graph lock, so that commits appended by other
+         * processes are kept.
+         */
         void save_commits(const std::string &file_path);
 
+        /**
+         * @return True if the tail has grown large enough to be merged into the segment, or the segment is in the
+         *         older format.
+         */
+        [[nodiscard]] bool needs_compaction() const;
+
         void load_commits(const std::string &file_path);
 
     private:
-        std::unordered_map<std::string, Commit> commits;
         std::string commit_file_path;
+
+        const char *data = nullptr;   ///< The commit-graph image, mapped or held in `converted_image`.
+        size_t data_size = 0;
+        bool mapped = false;
+        std::string converted_image;  ///< The image built from a file in the older format.
+
+        uint32_t segment_count = 0;            ///< Number of commits in the segment.
+        uint32_t segment_edge_count = 0;
+        const unsigned char *ids = nullptr;
+        const CommitRecord *records = nullptr;
+        const uint32_t *edges = nullptr;
+        const char *string_heap = nullptr;
+
+        std::vector<unsigned char> tail_ids;   ///< Raw ids of the tail commits, in the order they were added.
+        std::vector<CommitRecord> tail_records;
+        std::vector<uint32_t> tail_edges;      ///< Parents of the tail commits, as positions in the whole graph.
+        std::string tail_heap;
+        std::vector<uint8_t> walk_flags;       ///< Scratch flags for ancestry walks, one byte per commit.
+        std::vector<uint32_t> walk_stack;      ///< Scratch stack or priority queue for ancestry walks.
+        std::vector<std::pair<uint32_t, bool>> paint_queue; ///< paint_down_to_common queue; true if counted non-stale.
+        std::vector<uint32_t> walk_touched;    ///< Commits whose walk flags are set, so that clearing them is cheap.
+        std::vector<uint64_t> reach_bits;      ///< ahead_behind scratch rows, one per commit; zero between walks.
+
+        static constexpr uint8_t PARENT1 = 1;  ///< Reached from the first commit of a walk.
+        static constexpr uint8_t PARENT2 = 2;  ///< Reached from the other commits of a walk.
+        static constexpr uint8_t STALE = 4;    ///< Below a common ancestor.
+        static constexpr uint8_t RESULT = 8;   ///< Already reported as a common ancestor.
+
+        /**
+         * Points the table pointers at an image, checking its header and bounds.
+         */
+        void attach_image(const char *image, size_t image_size);
+
+        void release_image();
+
+        /**
+         * Orders commits by generation, then by date.
+         *
+         * @return True if commit1 comes before commit2.
+         */
+        [[nodiscard]] bool walk_order(uint32_t commit1, uint32_t commit2) const;
+
+        void mark(uint32_t commit, uint8_t flags);
+
+        void clear_marks();
+
+        /**
+         * Paints the ancestors of `commit1` with PARENT1 and those of `others` with PARENT2, in generation order,
+         * until only stale commits are left or the generation drops below `min_generation`.
+         *
+         * The flags are left set for the caller to inspect; clear_marks resets them.
+         *
+         * @return The common ancestors found before going stale.
+         */
+        std::vector<uint32_t> paint_down_to_common(uint32_t commit1, const std::vector<uint32_t> &others,
+                                                   uint32_t min_generation);
+
+        /**
+         * Builds a commit-graph image from a list of commits.
+         */
+        static std::string build_image(std::vector<Commit> commits);
+
+        /**
+         * Reads a commit-graph file written in the older compressed format.
+         */
+        static std::vector<Commit> load_legacy_commits(const std::string &file_path);
+
+        /**
+         * Converts a hexadecimal commit id to its 20 bytes.
+         *
+         * @return False if the id is not 40 hexadecimal characters.
+         */
+        static bool parse_id(std::string_view checksum, std::array<unsigned char, 20> &raw_id);
+
+        /**
+         * Reads the tail records and appends them to the in-memory tail, skipping commits already in the segment.
+         */
+        void load_tail(const std::string &tail);
+
+        /**
+         * Adds a commit to the in-memory tail, computing its generation from its parents.
+         */
+        void append_to_tail(const unsigned char *raw_id, int64_t timestamp, const std::vector<uint32_t> &parents,
+                            std::string_view message, std::string_view branch_name, std::string_view author,
+                            std::optional<std::string_view> changed_paths);
+
+        /**
+         * @return The position of the first id of the segment that is not smaller than `raw_id`.
+         */
+        [[nodiscard]] uint32_t lower_bound(const unsigned char *raw_id) const;
+
+        /**
+         * Finds the position of a commit from its 20-byte id.
+         */
+        [[nodiscard]] std::optional<uint32_t> find_raw_id(const unsigned char *raw_id) const;
+
+        [[nodiscard]] const unsigned char *get_raw_id(uint32_t commit) const;
+
+        [[nodiscard]] const CommitRecord &get_record(uint32_t commit) const;
+
+        [[nodiscard]] const char *get_heap(uint32_t commit) const;
+
+        [[nodiscard]] std::string tail_path() const;
     };
 
 
@@ -0,0 +1,119 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "EwahBitmap.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace manager {
+
+    namespace {
+        constexpr uint64_t MAX_RUN = 0xFFFFFFFFull;       ///< The run length field is 32 bits.
+        constexpr uint64_t MAX_LITERALS = 0x7FFFFFFFull;  ///< The literal count field is 31 bits.
+
+        uint64_t make_marker(bool run_bit, uint64_t run_length, uint64_t literal_count) {
+            return (run_bit ? 1 : 0) | run_length << 1 | literal_count << 33;
+        }
+    }
+
+    void EwahBitmap::set(uint32_t bit) {
+        size_t word = bit / 64;
+        if (word >= words.size()) {
+            words.resize(word + 1, 0);
+        }
+        words[word] |= uint64_t(1) << (bit % 64);
+    }
+
+    bool EwahBitmap::test(uint32_t bit) const {
+        size_t word = bit / 64;
+        return word < words.size() && (words[word] >> (bit % 64) & 1);
+    }
+
+    void EwahBitmap::or_with(const EwahBitmap &other) {
+        if (other.words.size() > words.size()) {
+            words.resize(other.words.size(), 0);
+        }
+        for (size_t i = 0; i < other.words.size(); ++i) {
+            words[i] |= other.words[i];
+        }
+    }
+
+    void EwahBitmap::and_not(const EwahBitmap &other) {
+        size_t common = std::min(words.size(), other.words.size());
+        for (size_t i = 0; i < common; ++i) {
+            words[i] &= ~other.words[i];
+        }
+    }
+
+    size_t EwahBitmap::count() const {
+        size_t bits = 0;
+        for (uint64_t word: words) {
+            bits += std::popcount(word);
+        }
+        return bits;
+    }
+
+    void EwahBitmap::for_each(const std::function<void(uint32_t)> &on_bit) const {
+        for (size_t i = 0; i < words.size(); ++i) {
+            for (uint64_t word = words[i]; word != 0; word &= word - 1) {
+                on_bit(static_cast<uint32_t>(i * 64 + std::countr_zero(word)));
+            }
+        }
+    }
+
+    std::vector<uint64_t> EwahBitmap::encode() const {
+        std::vector<uint64_t> encoded;
+        size_t i = 0;
+
+        while (i < words.size()) {
+            // A run of all-zero or all-one words, then the literal words up to the next run.
+            bool run_bit = words[i] == ~uint64_t(0);
+            uint64_t run_length = 0;
+            if (words[i] == 0 || run_bit) {
+                uint64_t run_word = words[i];
+                while (i < words.size() && words[i] == run_word && run_length < MAX_RUN) {
+                    ++run_length;
+                    ++i;
+                }
+            }
+
+            size_t literals_start = i;
+            while (i < words.size() && words[i] != 0 && words[i] != ~uint64_t(0) &&
+                   i - literals_start < MAX_LITERALS) {
+                ++i;
+            }
+
+            encoded.push_back(make_marker(run_bit, run_length, i - literals_start));
+            encoded.insert(encoded.end(), words.begin() + static_cast<long>(literals_start),
+                           words.begin() + static_cast<long>(i));
+        }
+
+        return encoded;
+    }
+
+    EwahBitmap EwahBitmap::decode(const uint64_t *encoded, size_t word_count) {
+        EwahBitmap bitmap;
+        size_t i = 0;
+
+        while (i < word_count) {
+            uint64_t marker = encoded[i++];
+            bool run_bit = marker & 1;
+            uint64_t run_length = marker >> 1 & MAX_RUN;
+            uint64_t literal_count = marker >> 33;
+
+            if (literal_count > word_count - i) {
+                throw std::runtime_error("Truncated bitmap");
+            }
+
+            bitmap.words.insert(bitmap.words.end(), run_length, run_bit ? ~uint64_t(0) : 0);
+            bitmap.words.insert(bitmap.words.end(), encoded + i, encoded + i + literal_count);
+            i += literal_count;
+        }
+
+        return bitmap;
+    }
+
+} // namespace manager
@@ -0,0 +1,64 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#ifndef JIT_EWAHBITMAP_H
+#define JIT_EWAHBITMAP_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace manager {
+
+    /**
+     * A bitmap that is operated on as plain 64-bit words and stored EWAH-compressed.
+     *
+     * The EWAH encoding is a sequence of marker words, each followed by literal words. A marker holds the value of a
+     * run of identical words in bit 0, the length of that run in bits 1-32 and the number of literal words that follow
+     * in bits 33-63. Long runs of zeros or ones, as in the reachability of old history, take a single word.
+     */
+    class EwahBitmap {
+    public:
+        EwahBitmap() = default;
+
+        void set(uint32_t bit);
+
+        [[nodiscard]] bool test(uint32_t bit) const;
+
+        /**
+         * Sets every bit that is set in `other`.
+         */
+        void or_with(const EwahBitmap &other);
+
+        /**
+         * Clears every bit that is set in `other`.
+         */
+        void and_not(const EwahBitmap &other);
+
+        [[nodiscard]] size_t count() const;
+
+        /**
+         * Calls `on_bit` with every set bit, in increasing order.
+         */
+        void for_each(const std::function<void(uint32_t)> &on_bit) const;
+
+        /**
+         * @return The EWAH encoding of the bitmap.
+         */
+        [[nodiscard]] std::vector<uint64_t> encode() const;
+
+        /**
+         * Decodes an EWAH-encoded bitmap.
+         *
+         * @throws std::runtime_error if the encoding is truncated.
+         */
+        static EwahBitmap decode(const uint64_t *words, size_t word_count);
+
+    private:
+        std::vector<uint64_t> words;
+    };
+
+} // namespace manager
+
+#endif //JIT_EWAHBITMAP_H
@@ -0,0 +1,265 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "ReachabilityBitmaps.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace manager {
+
+    namespace {
+        constexpr char BITMAP_MAGIC[4] = {'J', 'B', 'M', 'P'};
+        constexpr uint32_t BITMAP_VERSION = 1;
+        constexpr size_t ID_SIZE = 20;
+
+        struct BitmapHeader {
+            char magic[4];
+            uint32_t version;
+            uint32_t object_count;
+            uint32_t bitmap_count;
+        };
+
+        void append_raw_id(std::string &buffer, const std::string &id) {
+            for (size_t i = 0; i + 1 < id.size() && i / 2 < ID_SIZE; i += 2) {
+                buffer.push_back(static_cast<char>(std::stoi(id.substr(i, 2), nullptr, 16)));
+            }
+        }
+
+        std::string to_hex(const char *raw_id) {
+            static constexpr char digits[] = "0123456789abcdef";
+            std::string id(2 * ID_SIZE, '0');
+            for (size_t i = 0; i < ID_SIZE; ++i) {
+                auto byte = static_cast<unsigned char>(raw_id[i]);
+                id[2 * i] = digits[byte >> 4];
+                id[2 * i + 1] = digits[byte & 0xf];
+            }
+            return id;
+        }
+    }
+
+    ReachabilityBitmaps::ReachabilityBitmaps(CommitGraph &graph, SnapshotStore &store, std::string bitmap_file_path)
+            : graph(graph), store(store), bitmap_file_path(std::move(bitmap_file_path)) {
+        if (fs::exists(this->bitmap_file_path)) {
+            load();
+        }
+    }
+
+    EwahBitmap ReachabilityBitmaps::reachable(uint32_t commit, bool with_objects) {
+        EwahBitmap bitmap;
+        std::vector<bool> visited(graph.size(), false);
+        std::vector<uint32_t> walked;
+        std::vector<uint32_t> stack = {commit};
+
+        // Walk down to the nearest commits with a stored bitmap; everything below them is in it.
+        while (!stack.empty()) {
+            uint32_t current = stack.back();
+            stack.pop_back();
+            if (visited[current]) {
+                continue;
+            }
+            visited[current] = true;
+
+            auto stored = stored_bitmaps.find(current);
+            if (stored != stored_bitmaps.end()) {
+                bitmap.or_with(EwahBitmap::decode(stored->second.data(), stored->second.size()));
+                continue;
+            }
+
+            walked.push_back(current);
+            for (uint32_t parent: graph.get_parents(current)) {
+                stack.push_back(parent);
+            }
+        }
+
+        // Oldest first, so that new objects are numbered in history order and trees shared with a parent are
+        // already set when a commit is added.
+        std::sort(walked.begin(), walked.end(), [this](uint32_t a, uint32_t b) {
+            return graph.get_generation(a) < graph.get_generation(b);
+        });
+
+        for (uint32_t current: walked) {
+            std::string commit_id = graph.get_checksum(current);
+            bitmap.set(get_bit(commit_id));
+            if (with_objects) {
+                add_commit_objects(commit_id, bitmap);
+            }
+        }
+
+        return bitmap;
+    }
+
+    bool ReachabilityBitmaps::is_reachable(uint32_t descendant, uint32_t ancestor) {
+        if (descendant == ancestor) {
+            return true;
+        }
+        // A commit's ancestors all have a lower generation.
+        if (graph.get_generation(ancestor) >= graph.get_generation(descendant)) {
+            return false;
+        }
+        return reachable(descendant, false).test(get_bit(graph.get_checksum(ancestor)));
+    }
+
+    std::string ReachabilityBitmaps::get_object_id(uint32_t bit) const {
+        return object_ids.at(bit);
+    }
+
+    std::vector<std::string> ReachabilityBitmaps::get_object_ids(const EwahBitmap &bitmap) const {
+        std::vector<std::string> ids;
+        ids.reserve(bitmap.count());
+        bitmap.for_each([this, &ids](uint32_t bit) { ids.push_back(object_ids.at(bit)); });
+        return ids;
+    }
+
+    uint32_t ReachabilityBitmaps::get_bit(const std::string &object_id) {
+        auto [entry, inserted] = object_bits.emplace(object_id, static_cast<uint32_t>(object_ids.size()));
+        if (inserted) {
+            object_ids.push_back(object_id);
+        }
+        return entry->second;
+    }
+
+    void ReachabilityBitmaps::add_tree(const std::string &tree_id, EwahBitmap &bitmap) {
+        uint32_t bit = get_bit(tree_id);
+        if (bitmap.test(bit)) {
+            return;
+        }
+        bitmap.set(bit);
+
+        for (const auto &entry: store.read_tree(tree_id)) {
+            if (entry.type == "tree") {
+                add_tree(entry.id, bitmap);
+            } else {
+                bitmap.set(get_bit(entry.id));
+            }
+        }
+    }
+
+    void ReachabilityBitmaps::add_commit_objects(const std::string &commit_id, EwahBitmap &bitmap) {
+        std::string tree_id = store.get_commit_tree(commit_id);
+        if (!tree_id.empty()) {
+            add_tree(tree_id, bitmap);
+            return;
+        }
+
+        // Commits stored as a flat index have no trees.
+        for (const auto &[_, file_info]: store.read_snapshot(commit_id).files_map) {
+            bitmap.set(get_bit(file_info.checksum));
+        }
+    }
+
+    size_t ReachabilityBitmaps::write(const std::vector<std::string> &heads) {
+        std::vector<uint32_t> selected;
+        for (const auto &head: heads) {
+            if (auto position = graph.get_commit(head)) {
+                selected.push_back(*position);
+            }
+        }
+        for (uint32_t position = 0; position < graph.size(); ++position) {
+            if (graph.get_generation(position) % BITMAP_INTERVAL == 0) {
+                selected.push_back(position);
+            }
+        }
+
+        // Lower generations first, so that each bitmap is built on the ones below it.
+        std::sort(selected.begin(), selected.end(), [this](uint32_t a, uint32_t b) {
+            return graph.get_generation(a) != graph.get_generation(b) ? graph.get_generation(a) <
+                                                                         graph.get_generation(b) : a < b;
+        });
+        selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+
+        object_ids.clear();
+        object_bits.clear();
+        stored_bitmaps.clear();
+        for (uint32_t commit: selected) {
+            stored_bitmaps[commit] = reachable(commit).encode();
+        }
+
+        BitmapHeader header{};
+        std::memcpy(header.magic, BITMAP_MAGIC, sizeof(BITMAP_MAGIC));
+        header.version = BITMAP_VERSION;
+        header.object_count = static_cast<uint32_t>(object_ids.size());
+        header.bitmap_count = static_cast<uint32_t>(selected.size());
+
+        std::string content(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const auto &object_id: object_ids) {
+            append_raw_id(content, object_id);
+        }
+        for (uint32_t commit: selected) {
+            const auto &words = stored_bitmaps[commit];
+            auto word_count = static_cast<uint32_t>(words.size());
+            append_raw_id(content, graph.get_checksum(commit));
+            content.append(reinterpret_cast<const char *>(&word_count), sizeof(word_count));
+            content.append(reinterpret_cast<const char *>(words.data()), words.size() * sizeof(uint64_t));
+        }
+
+        std::string temp_path = bitmap_file_path + ".tmp";
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Failed to open file for writing: " + temp_path);
+        }
+        out.write(content.data(), static_cast<std::streamsize>(content.size()));
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Failed to write file: " + temp_path);
+        }
+        fs::rename(temp_path, bitmap_file_path);
+
+        return selected.size();
+    }
+
+    void ReachabilityBitmaps::load() {
+        std::ifstream in(bitmap_file_path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("Failed to open file for reading: " + bitmap_file_path);
+        }
+        std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        BitmapHeader header{};
+        if (content.size() < sizeof(header)) {
+            throw std::runtime_error("Corrupt bitmap file: " + bitmap_file_path);
+        }
+        std::memcpy(&header, content.data(), sizeof(header));
+        if (std::memcmp(header.magic, BITMAP_MAGIC, sizeof(BITMAP_MAGIC)) != 0 || header.version != BITMAP_VERSION ||
+            content.size() < sizeof(header) + size_t(header.object_count) * ID_SIZE) {
+            throw std::runtime_error("Corrupt bitmap file: " + bitmap_file_path);
+        }
+
+        size_t offset = sizeof(header);
+        object_ids.reserve(header.object_count);
+        for (uint32_t bit = 0; bit < header.object_count; ++bit, offset += ID_SIZE) {
+            object_ids.push_back(to_hex(content.data() + offset));
+            object_bits.emplace(object_ids.back(), bit);
+        }
+
+        for (uint32_t i = 0; i < header.bitmap_count; ++i) {
+            uint32_t word_count;
+            if (offset + ID_SIZE + sizeof(word_count) > content.size()) {
+                throw std::runtime_error("Corrupt bitmap file: " + bitmap_file_path);
+            }
+            std::string commit_id = to_hex(content.data() + offset);
+            std::memcpy(&word_count, content.data() + offset + ID_SIZE, sizeof(word_count));
+            offset += ID_SIZE + sizeof(word_count);
+
+            if (offset + size_t(word_count) * sizeof(uint64_t) > content.size()) {
+                throw std::runtime_error("Corrupt bitmap file: " + bitmap_file_path);
+            }
+            std::vector<uint64_t> words(word_count);
+            std::memcpy(words.data(), content.data() + offset, word_count * sizeof(uint64_t));
+            offset += word_count * sizeof(uint64_t);
+
+            // A commit dropped from the graph since the bitmaps were written is simply not used.
+            if (auto position = graph.get_commit(commit_id)) {
+                stored_bitmaps.emplace(*position, std::move(words));
+            }
+        }
+    }
+
+} // namespace manager
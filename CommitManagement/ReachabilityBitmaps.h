@@ -0,0 +1,100 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#ifndef JIT_REACHABILITYBITMAPS_H
+#define JIT_REACHABILITYBITMAPS_H
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "CommitGraph.h"
+#include "EwahBitmap.h"
+#include "SnapshotStore.h"
+
+namespace manager {
+
+    /**
+     * Sets of commits and objects reachable from a commit, as bitmaps over a numbering of the objects.
+     *
+     * `jit gc` stores a bitmap for the branch heads and for every commit whose generation is a multiple of
+     * BITMAP_INTERVAL. Each bit stands for one object of the table stored with them: commits, trees and files, numbered
+     * oldest first. The reachability of any commit is then the OR of the stored bitmaps of the nearest selected
+     * ancestors plus the few commits walked to reach them. Commits and objects newer than the stored table are
+     * numbered after it, in memory.
+     *
+     * Without a bitmap file every query walks the whole history; the results are the same.
+     */
+    class ReachabilityBitmaps {
+    public:
+        /**
+         * @param graph The commit graph of the repository.
+         * @param store The object store of the repository.
+         * @param bitmap_file_path The bitmap file, read if it exists.
+         */
+        ReachabilityBitmaps(CommitGraph &graph, SnapshotStore &store, std::string bitmap_file_path);
+
+        /**
+         * Computes the commits, and optionally the trees and files, reachable from a commit.
+         *
+         * @param commit The position of the commit in the commit graph.
+         * @param with_objects Whether trees and files are included; without them no tree is read.
+         */
+        EwahBitmap reachable(uint32_t commit, bool with_objects = true);
+
+        /**
+         * Checks whether `ancestor` can be reached from `descendant` by following parents.
+         */
+        bool is_reachable(uint32_t descendant, uint32_t ancestor);
+
+        /**
+         * @return The id of the object a bit stands for.
+         */
+        [[nodiscard]] std::string get_object_id(uint32_t bit) const;
+
+        /**
+         * @return The ids of every object set in a bitmap.
+         */
+        [[nodiscard]] std::vector<std::string> get_object_ids(const EwahBitmap &bitmap) const;
+
+        /**
+         * @return The bit standing for an object, numbering it if it is not in the table yet.
+         */
+        uint32_t get_bit(const std::string &object_id);
+
+        /**
+         * Writes bitmaps for the given branch heads and for the commits at every BITMAP_INTERVAL generations.
+         *
+         * @param heads The commit ids of the branch heads.
+         * @return The number of bitmaps written.
+         */
+        size_t write(const std::vector<std::string> &heads);
+
+    private:
+        static constexpr uint32_t BITMAP_INTERVAL = 32;
+
+        CommitGraph &graph;
+        SnapshotStore &store;
+        std::string bitmap_file_path;
+
+        std::vector<std::string> object_ids;                     ///< Object id of each bit.
+        std::unordered_map<std::string, uint32_t> object_bits;   ///< Bit of each object id.
+        std::unordered_map<uint32_t, std::vector<uint64_t>> stored_bitmaps; ///< EWAH words per commit position.
+
+        /**
+         * Sets the bits of a tree and of everything below it, skipping subtrees whose bit is already set.
+         */
+        void add_tree(const std::string &tree_id, EwahBitmap &bitmap);
+
+        /**
+         * Sets the bits of the trees and files of a commit.
+         */
+        void add_commit_objects(const std::string &commit_id, EwahBitmap &bitmap);
+
+        void load();
+    };
+
+} // namespace manager
+
+#endif //JIT_REACHABILITYBITMAPS_H
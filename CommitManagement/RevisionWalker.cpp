@@ -0,0 +1,132 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "RevisionWalker.h"
+
+#include <algorithm>
+#include "ChangedPathFilter.h"
+
+namespace manager {
+
+    RevisionWalker::RevisionWalker(const CommitGraph &graph, SnapshotStore &store, LogOptions options)
+            : graph(graph), store(store), options(std::move(options)), flags(graph.size(), 0) {
+        const auto &patterns = this->options.pathspec.get_patterns();
+        if (std::none_of(patterns.begin(), patterns.end(), [](const std::string &pattern) {
+            return pattern.find_first_of("*?[") != std::string::npos;
+        })) {
+            literal_paths = patterns;
+        }
+    }
+
+    void RevisionWalker::push(uint32_t commit) {
+        if (flags[commit] & SEEN) {
+            return;
+        }
+        flags[commit] |= SEEN;
+        queue.push_back(commit);
+        std::push_heap(queue.begin(), queue.end(), [this](uint32_t a, uint32_t b) { return output_order(a, b); });
+    }
+
+    void RevisionWalker::hide(uint32_t commit) {
+        if (flags[commit] & UNINTERESTING) {
+            return;
+        }
+        flags[commit] |= UNINTERESTING;
+        hidden.push_back(commit);
+        std::push_heap(hidden.begin(), hidden.end(), [this](uint32_t a, uint32_t b) {
+            return graph.get_generation(a) < graph.get_generation(b);
+        });
+    }
+
+    std::optional<uint32_t> RevisionWalker::next() {
+        auto newest_first = [this](uint32_t a, uint32_t b) { return output_order(a, b); };
+
+        while (!queue.empty() && (options.max_count < 0 || returned < options.max_count)) {
+            std::pop_heap(queue.begin(), queue.end(), newest_first);
+            uint32_t commit = queue.back();
+            queue.pop_back();
+
+            // In date order everything left in the queue is older, so the walk is over.
+            if (!options.topo_order && options.since && graph.get_timestamp(commit) < *options.since) {
+                queue.clear();
+                break;
+            }
+
+            expand_hidden(graph.get_generation(commit));
+            if (flags[commit] & UNINTERESTING) {
+                continue;
+            }
+
+            for (uint32_t parent: graph.get_parents(commit)) {
+                if (!(flags[parent] & UNINTERESTING)) {
+                    push(parent);
+                }
+            }
+
+            if (matches(commit)) {
+                ++returned;
+                return commit;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    bool RevisionWalker::output_order(uint32_t commit1, uint32_t commit2) const {
+        auto generation1 = graph.get_generation(commit1);
+        auto generation2 = graph.get_generation(commit2);
+        auto timestamp1 = graph.get_timestamp(commit1);
+        auto timestamp2 = graph.get_timestamp(commit2);
+
+        if (options.topo_order) {
+            return generation1 != generation2 ? generation1 < generation2 : timestamp1 < timestamp2;
+        }
+        return timestamp1 != timestamp2 ? timestamp1 < timestamp2 : generation1 < generation2;
+    }
+
+    void RevisionWalker::expand_hidden(uint32_t generation) {
+        auto highest_first = [this](uint32_t a, uint32_t b) {
+            return graph.get_generation(a) < graph.get_generation(b);
+        };
+
+        while (!hidden.empty() && graph.get_generation(hidden.front()) > generation) {
+            std::pop_heap(hidden.begin(), hidden.end(), highest_first);
+            uint32_t commit = hidden.back();
+            hidden.pop_back();
+
+            for (uint32_t parent: graph.get_parents(commit)) {
+                hide(parent);
+            }
+        }
+    }
+
+    bool RevisionWalker::matches(uint32_t commit) const {
+        auto timestamp = graph.get_timestamp(commit);
+        if ((options.since && timestamp < *options.since) || (options.until && timestamp > *options.until)) {
+            return false;
+        }
+        if (!options.author.empty() && graph.get_author(commit).find(options.author) == std::string_view::npos) {
+            return false;
+        }
+        return options.pathspec.matches_everything() || touches_pathspec(commit);
+    }
+
+    bool RevisionWalker::touches_pathspec(uint32_t commit) const {
+        auto changed_paths = graph.get_changed_paths(commit);
+        if (changed_paths && !literal_paths.empty() &&
+            std::none_of(literal_paths.begin(), literal_paths.end(), [&changed_paths](const std::string &path) {
+                return ChangedPathFilter::may_contain(*changed_paths, path);
+            })) {
+            return false;
+        }
+
+        auto parents = graph.get_parents(commit);
+        bool changed = false;
+        store.diff_commits(parents.empty() ? "" : graph.get_checksum(parents.front()), graph.get_checksum(commit),
+                           options.pathspec, [&changed](const std::string &, const std::string &,
+                                                        const std::string &) { changed = true; });
+        return changed;
+    }
+
+} // namespace manager
@@ -0,0 +1,98 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#ifndef JIT_REVISIONWALKER_H
+#define JIT_REVISIONWALKER_H
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "CommitGraph.h"
+#include "SnapshotStore.h"
+#include "../DirectoryManagement/Pathspec.h"
+
+namespace manager {
+
+    /**
+     * Filters and ordering of a `jit log`.
+     */
+    struct LogOptions {
+        int max_count = -1;                                          ///< Stop after this many commits; -1 for all.
+        std::optional<std::chrono::system_clock::time_point> since;  ///< Only commits made at or after this time.
+        std::optional<std::chrono::system_clock::time_point> until;  ///< Only commits made at or before this time.
+        std::string author;                                          ///< Only commits whose author contains this.
+        bool topo_order = false;  ///< Generation order, every child before its parents, instead of date order.
+        Pathspec pathspec;        ///< Only commits that changed a matching file relative to their first parent.
+    };
+
+    /**
+     * Lazily walks the commits reachable from a set of commits and not from another, newest first.
+     *
+     * Only the commits that are returned, and the hidden commits at or above their generation, are visited, so the
+     * first commits of a log come out without walking the rest of the history. A hidden commit can only reach
+     * commits of a lower generation; before a commit is returned, the hidden commits above its generation are
+     * expanded, so that it is never returned if it is reachable from one of them, whatever order is used.
+     *
+     * With a pathspec, the changed-path filter of each commit is checked first; the trees of a commit are only
+     * compared with those of its first parent when the filter may contain one of the paths, or when the commit has no
+     * filter or the pathspec has glob patterns.
+     */
+    class RevisionWalker {
+    public:
+        /**
+         * @param graph The commit graph to walk.
+         * @param store The object store, read only for a pathspec.
+         * @param options The filters and ordering of the walk.
+         */
+        RevisionWalker(const CommitGraph &graph, SnapshotStore &store, LogOptions options);
+
+        /**
+         * Starts the walk from a commit.
+         */
+        void push(uint32_t commit);
+
+        /**
+         * Leaves out a commit and everything reachable from it.
+         */
+        void hide(uint32_t commit);
+
+        /**
+         * @return The next commit of the walk, or nothing once the walk is over.
+         */
+        std::optional<uint32_t> next();
+
+    private:
+        static constexpr uint8_t SEEN = 1;           ///< Queued from a pushed commit.
+        static constexpr uint8_t UNINTERESTING = 2;  ///< Reachable from a hidden commit.
+
+        const CommitGraph &graph;
+        SnapshotStore &store;
+        LogOptions options;
+        std::vector<std::string> literal_paths;  ///< The pathspec patterns, if none of them has glob characters.
+        int returned = 0;
+
+        std::vector<uint8_t> flags;     ///< One byte per commit of the graph.
+        std::vector<uint32_t> queue;    ///< Max-heap of the commits to return, in output order.
+        std::vector<uint32_t> hidden;   ///< Max-heap of the hidden commits still to expand, by generation.
+
+        [[nodiscard]] bool output_order(uint32_t commit1, uint32_t commit2) const;
+
+        /**
+         * Expands the hidden commits of a higher generation than `generation`, marking their ancestors.
+         */
+        void expand_hidden(uint32_t generation);
+
+        [[nodiscard]] bool matches(uint32_t commit) const;
+
+        /**
+         * Checks whether a commit changed a file of the pathspec relative to its first parent.
+         */
+        [[nodiscard]] bool touches_pathspec(uint32_t commit) const;
+    };
+
+} // namespace manager
+
+#endif //JIT_REVISIONWALKER_H
@@ -0,0 +1,390 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "SnapshotStore.h"
+#include "../ChangesManagement/IndexFileParser.h"
+#include "../JitUtility/jit_utility.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <utility>
+
+namespace manager {
+
+    /**
+     * A directory while its tree object is being built.
+     */
+    struct TreeNode {
+        std::map<std::string, std::string> files;                        ///< File name -> content id.
+        std::map<std::string, std::string> subtrees;                     ///< Directory name -> stored tree id.
+        std::map<std::string, std::unique_ptr<TreeNode>> directories;    ///< Directory name -> tree to build.
+    };
+
+    /**
+     * Walks down from a node to the directory holding `path`, creating the missing nodes.
+     *
+     * @param root The root node.
+     * @param path A path relative to the root.
+     * @param name Receives the last component of the path.
+     * @return The node of the directory holding the path.
+     */
+    static TreeNode &get_parent_node(TreeNode &root, const std::string &path, std::string &name) {
+        TreeNode *node = &root;
+        size_t start = 0;
+
+        for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', start)) {
+            auto &child = node->directories[path.substr(start, slash - start)];
+            if (!child) {
+                child = std::make_unique<TreeNode>();
+            }
+            node = child.get();
+            start = slash + 1;
+        }
+
+        name = path.substr(start);
+        return *node;
+    }
+
+    /**
+     * Writes the tree objects of a node and of the directories below it.
+     *
+     * @param node The node.
+     * @param objects_directory The objects directory.
+     * @return The id of the node's tree.
+     */
+    static std::string write_tree_node(const TreeNode &node, const std::string &objects_directory) {
+        std::map<std::string, std::string> lines;
+
+        for (const auto &[name, id]: node.files) {
+            lines[name] = "100644 blob " + id;
+        }
+        for (const auto &[name, id]: node.subtrees) {
+            lines[name] = "040000 tree " + id;
+        }
+        for (const auto &[name, child]: node.directories) {
+            lines[name] = "040000 tree " + write_tree_node(*child, objects_directory);
+        }
+
+        std::string text;
+        for (const auto &[name, line]: lines) {
+            text += line + '\t' + name + '\n';
+        }
+        return save_content_as_binary(objects_directory, text);
+    }
+
+    SnapshotStore::SnapshotStore(std::string objects_directory) : objects_directory(std::move(objects_directory)) {}
+
+    /**
+     * Writes the tree objects for a set of files and returns the id of the root tree.
+     *
+     * @param files The files, keyed by their path relative to the snapshot root.
+     * @param subtrees Directories whose tree is already stored, keyed by their path.
+     * @return The id of the root tree.
+     */
+    std::string SnapshotStore::write_tree(const std::unordered_map<std::string, FileInfo> &files,
+                                          const std::map<std::string, std::string> &subtrees) {
+        TreeNode root;
+        std::string name;
+
+        for (const auto &[path, file_info]: files) {
+            TreeNode &parent = get_parent_node(root, path, name);
+            parent.files[name] = file_info.checksum;
+        }
+        for (const auto &[path, tree_id]: subtrees) {
+            TreeNode &parent = get_parent_node(root, path, name);
+            parent.subtrees[name] = tree_id;
+        }
+
+        return write_tree_node(root, objects_directory);
+    }
+
+    /**
+     * Writes a commit object pointing at a root tree.
+     *
+     * The date is recorded with the clock's full precision so that two commits of the same tree by the same parents
+     * still get different ids.
+     *
+     * @param tree_id The root tree of the commit.
+     * @param parents The parent commits; null ids are left out.
+     * @param message The commit message.
+     * @return The id of the commit.
+     */
+    std::string SnapshotStore::write_commit(const std::string &tree_id, const std::vector<std::string> &parents,
+                                            const std::string &message) {
+        std::ostringstream text;
+        text << "tree " << tree_id << '\n';
+        for (const auto &parent: parents) {
+            if (!parent.empty() && parent != std::string(40, '0')) {
+                text << "parent " << parent << '\n';
+            }
+        }
+        text << "date " << std::chrono::system_clock::now().time_since_epoch().count() << '\n';
+        text << '\n' << message << '\n';
+
+        return save_content_as_binary(objects_directory, text.str());
+    }
+
+    /**
+     * Returns the root tree of a commit.
+     *
+     * @param commit_id The commit.
+     * @return The id of the root tree, or an empty string for a commit stored as a flat index.
+     * @throws std::runtime_error if the commit object does not exist or is not a commit.
+     */
+    std::string SnapshotStore::get_commit_tree(const std::string &commit_id) {
+        std::string text = read_binary_as_string(object_path(commit_id));
+
+        if (text.starts_with("tree ")) {
+            return text.substr(5, text.find('\n') - 5);
+        } else if (text.starts_with("[METADATA]")) {
+            return "";
+        }
+        throw std::runtime_error(commit_id + " is not a commit");
+    }
+
+    /**
+     * Lists the entries of a tree object.
+     *
+     * @param tree_id The tree.
+     * @return The entries, sorted by name.
+     * @throws std::runtime_error if the tree object does not exist or is malformed.
+     */
+    std::vector<TreeEntry> SnapshotStore::read_tree(const std::string &tree_id) {
+        std::istringstream text(read_binary_as_string(object_path(tree_id)));
+        std::vector<TreeEntry> entries;
+        std::string line;
+
+        while (std::getline(text, line)) {
+            auto first_space = line.find(' ');
+            auto second_space = line.find(' ', first_space + 1);
+            auto tab = line.find('\t', second_space + 1);
+            if (first_space == std::string::npos || second_space == std::string::npos || tab == std::string::npos) {
+                throw std::runtime_error("Malformed tree " + tree_id);
+            }
+
+            entries.push_back({line.substr(0, first_space),
+                               line.substr(first_space + 1, second_space - first_space - 1),
+                               line.substr(second_space + 1, tab - second_space - 1),
+                               line.substr(tab + 1)});
+        }
+
+        return entries;
+    }
+
+    /**
+     * Finds the content id of a file in a commit, reading only the trees on its path.
+     *
+     * @param commit_id The commit.
+     * @param path The file, relative to the snapshot root.
+     * @return The id of the file content, or an empty string if the commit has no such file.
+     */
+    std::string SnapshotStore::get_file_id(const std::string &commit_id, const std::string &path) {
+        std::string tree_id = get_commit_tree(commit_id);
+        if (tree_id.empty()) {
+            const auto files = read_snapshot(commit_id).files_map;
+            auto file = files.find(path);
+            return file == files.end() ? "" : file->second.checksum;
+        }
+
+        size_t begin = 0;
+        while (true) {
+            size_t slash = path.find('/', begin);
+            std::string name = path.substr(begin, slash == std::string::npos ? std::string::npos : slash - begin);
+            std::string wanted_type = slash == std::string::npos ? "blob" : "tree";
+
+            auto entries = read_tree(tree_id);
+            auto entry = std::find_if(entries.begin(), entries.end(), [&](const TreeEntry &tree_entry) {
+                return tree_entry.name == name && tree_entry.type == wanted_type;
+            });
+            if (entry == entries.end()) {
+                return "";
+            } else if (slash == std::string::npos) {
+                return entry->id;
+            }
+            tree_id = entry->id;
+            begin = slash + 1;
+        }
+    }
+
+    /**
+     * Reads the files of a commit, a tree or a flat index object as index content.
+     *
+     * @param object_id The commit, tree or flat index.
+     * @param prefix The directory the tree describes, prepended to the paths read from tree objects.
+     * @return The files of the snapshot.
+     * @throws std::runtime_error if an object does not exist.
+     */
+    IndexFileContent SnapshotStore::read_snapshot(const std::string &object_id, const std::string &prefix) {
+        std::string text = read_binary_as_string(object_path(object_id));
+
+        if (text.starts_with("[METADATA]")) {
+            return IndexFileParser::read_binary_index_file(object_path(object_id));
+        }
+
+        IndexFileContent content{};
+        std::string tree_id = text.starts_with("tree ") ? text.substr(5, text.find('\n') - 5) : object_id;
+        flatten_tree(tree_id, prefix, content.files_map);
+        content.metaData.entries = content.files_map.size();
+        content.metaData.is_dirty = false;
+
+        return content;
+    }
+
+    /**
+     * Reports the files that differ between two commits.
+     *
+     * Commits stored as flat indexes have no trees to compare, so both sides are flattened instead.
+     *
+     * @param old_commit The old commit, or an empty string for an empty snapshot.
+     * @param new_commit The new commit, or an empty string for an empty snapshot.
+     * @param pathspec Limits the comparison to the matching files.
+     * @param on_change Called for every differing file, in path order.
+     */
+    void SnapshotStore::diff_commits(const std::string &old_commit, const std::string &new_commit,
+                                     const Pathspec &pathspec, const ChangeCallback &on_change) {
+        std::string old_tree = old_commit.empty() ? "" : get_commit_tree(old_commit);
+        std::string new_tree = new_commit.empty() ? "" : get_commit_tree(new_commit);
+
+        if ((old_commit.empty() || !old_tree.empty()) && (new_commit.empty() || !new_tree.empty())) {
+            diff_trees(old_tree, new_tree, "", pathspec, on_change);
+            return;
+        }
+
+        std::map<std::string, std::pair<std::string, std::string>> files;
+        if (!old_commit.empty()) {
+            for (const auto &[path, file_info]: read_snapshot(old_commit).files_map) {
+                if (pathspec.matches(path)) files[path].first = file_info.checksum;
+            }
+        }
+        if (!new_commit.empty()) {
+            for (const auto &[path, file_info]: read_snapshot(new_commit).files_map) {
+                if (pathspec.matches(path)) files[path].second = file_info.checksum;
+            }
+        }
+
+        for (const auto &[path, ids]: files) {
+            if (ids.first != ids.second) {
+                on_change(path, ids.first, ids.second);
+            }
+        }
+    }
+
+    /**
+     * Collects the ids of a commit and of every tree and file it references.
+     *
+     * @param commit_id The commit.
+     * @param objects Receives the object ids.
+     */
+    void SnapshotStore::collect_objects(const std::string &commit_id, std::set<std::string> &objects) {
+        objects.insert(commit_id);
+        std::string tree_id = get_commit_tree(commit_id);
+
+        if (!tree_id.empty()) {
+            collect_tree_objects(tree_id, objects);
+            return;
+        }
+
+        for (const auto &[_, file_info]: read_snapshot(commit_id).files_map) {
+            objects.insert(file_info.checksum);
+        }
+    }
+
+    /**
+     * Reports the files that differ between two trees, descending only into subtrees whose ids differ.
+     *
+     * @param old_tree The old tree, or an empty string for an empty tree.
+     * @param new_tree The new tree, or an empty string for an empty tree.
+     * @param prefix The directory the trees describe.
+     * @param pathspec Limits the comparison to the matching files.
+     * @param on_change Called for every differing file.
+     */
+    void SnapshotStore::diff_trees(const std::string &old_tree, const std::string &new_tree, const std::string &prefix,
+                                   const Pathspec &pathspec, const ChangeCallback &on_change) {
+        if (old_tree == new_tree) {
+            return;
+        }
+
+        const auto old_entries = old_tree.empty() ? std::vector<TreeEntry>{} : read_tree(old_tree);
+        const auto new_entries = new_tree.empty() ? std::vector<TreeEntry>{} : read_tree(new_tree);
+
+        std::map<std::string, std::pair<const TreeEntry *, const TreeEntry *>> entries;
+        for (const auto &entry: old_entries) entries[entry.name].first = &entry;
+        for (const auto &entry: new_entries) entries[entry.name].second = &entry;
+
+        for (const auto &[name, pair]: entries) {
+            const auto [old_entry, new_entry] = pair;
+            if (old_entry && new_entry && old_entry->type == new_entry->type && old_entry->id == new_entry->id) {
+                continue;
+            }
+
+            std::string path = prefix.empty() ? name : prefix + "/" + name;
+            auto id_of = [](const TreeEntry *entry, const std::string &type) {
+                return entry && entry->type == type ? entry->id : std::string();
+            };
+
+            std::string old_subtree = id_of(old_entry, "tree"), new_subtree = id_of(new_entry, "tree");
+            if ((!old_subtree.empty() || !new_subtree.empty()) && pathspec.could_match_directory(path)) {
+                diff_trees(old_subtree, new_subtree, path, pathspec, on_change);
+            }
+
+            std::string old_blob = id_of(old_entry, "blob"), new_blob = id_of(new_entry, "blob");
+            if ((!old_blob.empty() || !new_blob.empty()) && pathspec.matches(path)) {
+                on_change(path, old_blob, new_blob);
+            }
+        }
+    }
+
+    /**
+     * Adds the files of a tree to an index content.
+     *
+     * @param tree_id The tree.
+     * @param prefix The directory the tree describes.
+     * @param files Receives the files.
+     */
+    void SnapshotStore::flatten_tree(const std::string &tree_id, const std::string &prefix,
+                                     std::unordered_map<std::string, FileInfo> &files) {
+        for (const auto &entry: read_tree(tree_id)) {
+            std::string path = prefix.empty() ? entry.name : prefix + "/" + entry.name;
+
+            if (entry.type == "tree") {
+                flatten_tree(entry.id, path, files);
+            } else {
+                FileInfo file_info{};
+                file_info.filename = path;
+                file_info.checksum = entry.id;
+                files[path] = std::move(file_info);
+            }
+        }
+    }
+
+    /**
+     * Collects the ids of a tree and of everything below it, skipping the trees already collected.
+     *
+     * @param tree_id The tree.
+     * @param objects Receives the object ids.
+     */
+    void SnapshotStore::collect_tree_objects(const std::string &tree_id, std::set<std::string> &objects) {
+        if (!objects.insert(tree_id).second) {
+            return;
+        }
+
+        for (const auto &entry: read_tree(tree_id)) {
+            if (entry.type == "tree") {
+                collect_tree_objects(entry.id, objects);
+            } else {
+                objects.insert(entry.id);
+            }
+        }
+    }
+
+    /**
+     * Returns the path of an object inside the objects directory.
+     */
+    std::string SnapshotStore::object_path(const std::string &object_id) const {
+        return objects_directory + "/" + generate_file_path(object_id).string();
+    }
+
+} // namespace manager
@@ -0,0 +1,167 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#ifndef JIT_SNAPSHOTSTORE_H
+#define JIT_SNAPSHOTSTORE_H
+
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../ChangesManagement/data.h"
+#include "../DirectoryManagement/Pathspec.h"
+
+namespace manager {
+
+    /**
+     * One line of a tree object: a file or a subdirectory.
+     */
+    struct TreeEntry {
+        std::string mode;  ///< "100644" for files, "040000" for directories.
+        std::string type;  ///< "blob" or "tree".
+        std::string id;    ///< Checksum of the file content or of the subtree.
+        std::string name;  ///< Name of the entry inside its directory.
+    };
+
+    /**
+     * Reads and writes the snapshots stored in the objects directory.
+     *
+     * A commit object holds `tree <id>`, one `parent <id>` line per parent, a `date` line and the message. A tree
+     * object holds one `<mode> <type> <id>\t<name>` line per entry of a directory, sorted by name, and is stored under
+     * the SHA1 of that text. A directory that did not change between two commits therefore keeps its id and its
+     * object, and comparing two snapshots only descends into the subtrees whose ids differ.
+     *
+     * Commits made before tree objects existed are compressed copies of the flat index. They are still read, and
+     * compared by flattening them.
+     */
+    class SnapshotStore {
+    public:
+        /**
+         * Called for every path whose content differs between two snapshots.
+         *
+         * The ids are empty when the path does not exist on that side.
+         */
+        using ChangeCallback = std::function<void(const std::string &path, const std::string &old_id,
+                                                  const std::string &new_id)>;
+
+        /**
+         * @param objects_directory The objects directory of the repository.
+         */
+        explicit SnapshotStore(std::string objects_directory);
+
+        /**
+         * Writes the tree objects for a set of files and returns the id of the root tree.
+         *
+         * Only the trees that do not exist yet are written.
+         *
+         * @param files The files, keyed by their path relative to the snapshot root.
+         * @param subtrees Directories whose tree is already stored, keyed by their path.
+         * @return The id of the root tree.
+         */
+        std::string write_tree(const std::unordered_map<std::string, FileInfo> &files,
+                               const std::map<std::string, std::string> &subtrees = {});
+
+        /**
+         * Writes a commit object pointing at a root tree.
+         *
+         * @param tree_id The root tree of the commit.
+         * @param parents The parent commits; null ids are left out.
+         * @param message The commit message.
+         * @return The id of the commit.
+         */
+        std::string write_commit(const std::string &tree_id, const std::vector<std::string> &parents,
+                                 const std::string &message);
+
+        /**
+         * Returns the root tree of a commit.
+         *
+         * @param commit_id The commit.
+         * @return The id of the root tree, or an empty string for a commit stored as a flat index.
+         * @throws std::runtime_error if the commit object does not exist.
+         */
+        std::string get_commit_tree(const std::string &commit_id);
+
+        /**
+         * Lists the entries of a tree object.
+         *
+         * @param tree_id The tree.
+         * @return The entries, sorted by name.
+         * @throws std::runtime_error if the tree object does not exist or is malformed.
+         */
+        std::vector<TreeEntry> read_tree(const std::string &tree_id);
+
+        /**
+         * Finds the content id of a file in a commit, reading only the trees on its path.
+         *
+         * @param commit_id The commit.
+         * @param path The file, relative to the snapshot root.
+         * @return The id of the file content, or an empty string if the commit has no such file.
+         */
+        std::string get_file_id(const std::string &commit_id, const std::string &path);
+
+        /**
+         * Reads the files of a commit, a tree or a flat index object as index content.
+         *
+         * @param object_id The commit, tree or flat index.
+         * @param prefix The directory the tree describes, prepended to the paths read from tree objects.
+         * @return The files of the snapshot; only the name and the checksum of each entry are known for trees.
+         * @throws std::runtime_error if an object does not exist.
+         */
+        IndexFileContent read_snapshot(const std::string &object_id, const std::string &prefix = "");
+
+        /**
+         * Reports the files that differ between two commits.
+         *
+         * Subtrees with the same id on both sides and directories the pathspec cannot match are skipped without
+         * being read.
+         *
+         * @param old_commit The old commit, or an empty string for an empty snapshot.
+         * @param new_commit The new commit, or an empty string for an empty snapshot.
+         * @param pathspec Limits the comparison to the matching files.
+         * @param on_change Called for every differing file, in path order.
+         */
+        void diff_commits(const std::string &old_commit, const std::string &new_commit, const Pathspec &pathspec,
+                          const ChangeCallback &on_change);
+
+        /**
+         * Collects the ids of a commit and of every tree and file it references.
+         *
+         * Trees already present in `objects` are not read again.
+         *
+         * @param commit_id The commit.
+         * @param objects Receives the object ids.
+         */
+        void collect_objects(const std::string &commit_id, std::set<std::string> &objects);
+
+    private:
+        std::string objects_directory; ///< The objects directory of the repository.
+
+        /**
+         * Reports the files that differ between two trees.
+         */
+        void diff_trees(const std::string &old_tree, const std::string &new_tree, const std::string &prefix,
+                        const Pathspec &pathspec, const ChangeCallback &on_change);
+
+        /**
+         * Adds the files of a tree to an index content.
+         */
+        void flatten_tree(const std::string &tree_id, const std::string &prefix,
+                          std::unordered_map<std::string, FileInfo> &files);
+
+        /**
+         * Collects the ids of a tree and of everything below it.
+         */
+        void collect_tree_objects(const std::string &tree_id, std::set<std::string> &objects);
+
+        /**
+         * Returns the path of an object inside the objects directory.
+         */
+        [[nodiscard]] std::string object_path(const std::string &object_id) const;
+    };
+
+} // namespace manager
+
+#endif //JIT_SNAPSHOTSTORE_H
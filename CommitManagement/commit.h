@@ -6,6 +6,7 @@
 #define JIT_COMMIT_H
 #include <string>
 #include <chrono>
+#include <optional>
 #include <vector>
 
 struct Commit{
@@ -15,5 +16,6 @@ struct Commit{
     std::string author;
     std::chrono::system_clock::time_point timestamp;
     std::vector<std::string> parents;
+    std::optional<std::string> changed_paths; // Bloom filter of the paths changed since the first parent
 };
 #endif //JIT_COMMIT_H
@@ -4,6 +4,8 @@
 
 #include "DirManager.h"
 #include "../JitUtility/jit_utility.h"
+#include "../JitUtility/worker_pool.h"
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
 #include <fstream>
@@ -14,6 +16,16 @@ namespace fs = std::filesystem;
 
 namespace manager {
 
+    /**
+     * Upper bound on the files open at the same time while scanning when `core.maxOpenFiles` is not configured.
+     */
+    constexpr size_t DEFAULT_MAX_OPEN_FILES = 64;
+
+    /**
+     * Number of io_uring requests in flight per worker when `core.ioQueueDepth` is not configured.
+     */
+    constexpr size_t DEFAULT_IO_QUEUE_DEPTH = 64;
+
     /**
  * @brief Constructs a DirManager instance with the provided root directory.
  *
@@ -30,10 +42,11 @@ namespace manager {
  * This function retrieves all files in the root directory and its subdirectories that are tracked by the Jit repository.
  * It recursively scans the directory and respects any ignore rules defined in the .jitignore file.
  *
+ * @param pathspec Limits the scan to the matching files; directories that cannot contain any are not entered.
  * @return A set of strings representing the relative paths of the tracked files.
  */
-    std::set<std::string> DirManager::get_files() {
-        get_nested_files_in_a_directory(root_directory);
+    std::set<std::string> DirManager::get_files(const Pathspec &pathspec) {
+        get_nested_files_in_a_directory(root_directory, pathspec);
         return files;
     }
 
@@ -119,15 +132,126 @@ namespace manager {
         }
     }
 
+/**
+ * @brief Reads a value from the repository configuration file.
+ *
+ * Scans `.jit/config` for a `key = value` line matching the requested key. Surrounding whitespace is stripped from
+ * both the key and the value.
+ *
+ * @param key The configuration key.
+ * @param default_value The value returned when the key is not set.
+ * @return The configured value, or `default_value`.
+ */
+    std::string DirManager::get_config_value(const std::string &key, const std::string &default_value) {
+        std::ifstream config(get_jit_root() + "/config");
+        std::string line;
+
+        while (std::getline(config, line)) {
+            auto delimiter = line.find('=');
+            if (line.starts_with("#") || delimiter == std::string::npos) {
+                continue;
+            }
+
+            std::string config_key = line.substr(0, delimiter);
+            std::string value = line.substr(delimiter + 1);
+            config_key.erase(0, config_key.find_first_not_of(" \t"));
+            config_key.erase(config_key.find_last_not_of(" \t") + 1);
+
+            if (config_key == key) {
+                value.erase(0, value.find_first_not_of(" \t"));
+                value.erase(value.find_last_not_of(" \t") + 1);
+                return value;
+            }
+        }
+
+        return default_value;
+    }
+
+/**
+ * @brief Reads a non-negative number from the repository configuration file.
+ *
+ * @param key The configuration key.
+ * @param default_value The value returned when the key is not set or is not a number.
+ * @return The configured number, or `default_value`.
+ */
+    size_t DirManager::get_config_number(const std::string &key, size_t default_value) {
+        std::string value = get_config_value(key, "");
+        if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+            return default_value;
+        }
+
+        try {
+            return std::stoul(value);
+        } catch (const std::exception &) {
+            return default_value;
+        }
+    }
+
+/**
+ * @brief Sets a value in the repository configuration file.
+ *
+ * The first `key = value` line for the key is replaced and any other line is kept as is; the pair is appended when
+ * the key is not set yet.
+ *
+ * @param key The configuration key.
+ * @param value The new value.
+ * @throws std::runtime_error If the configuration file cannot be written.
+ */
+    void DirManager::set_config_value(const std::string &key, const std::string &value) {
+        std::string config_path = get_jit_root() + "/config";
+        std::ifstream config(config_path);
+        std::vector<std::string> lines;
+        std::string line;
+        bool replaced = false;
+
+        while (std::getline(config, line)) {
+            auto delimiter = line.find('=');
+            if (!replaced && !line.starts_with("#") && delimiter != std::string::npos) {
+                std::string config_key = line.substr(0, delimiter);
+                config_key.erase(0, config_key.find_first_not_of(" \t"));
+                config_key.erase(config_key.find_last_not_of(" \t") + 1);
+
+                if (config_key == key) {
+                    line = key + " = " + value;
+                    replaced = true;
+                }
+            }
+            lines.push_back(line);
+        }
+        config.close();
+
+        if (!replaced) {
+            lines.push_back(key + " = " + value);
+        }
+
+        std::ofstream output(config_path);
+        if (!output) {
+            throw std::runtime_error("Could not write the configuration file");
+        }
+        for (const auto &config_line: lines) {
+            output << config_line << '\n';
+        }
+    }
+
+/**
+ * @brief Reads the sparse checkout of the repository from its configuration and pattern file.
+ *
+ * @return The sparse checkout, disabled when `core.sparseCheckout` is not `true`.
+ */
+    SparseCheckout DirManager::get_sparse_checkout() {
+        return SparseCheckout::load(get_jit_root(), get_config_value("core.sparseCheckout", "false") == "true",
+                                    get_config_value("core.sparseCheckoutCone", "true") == "true");
+    }
+
 /**
  * @brief Updates the repository by deleting and modifying files as specified.
  *
  * This function accepts two sets of modifications:
  * - Files to delete: The specified files are removed from the root directory.
- * - Files to modify: The specified files are decompressed and copied to the destination paths in the repository.
+ * - Files to modify: The object of each file is decompressed and copied to its path in the repository.
  *
  * @param files_to_delete A set of file paths to delete from the root directory.
- * @param files_to_modify A map of source file paths and their corresponding destination paths.
+ * @param files_to_modify A map of destination paths in the repository and the objects to write there.
  */
     void DirManager::update_repository(const std::set<std::string> &files_to_delete,
                                        const std::map<std::string, std::string> &files_to_modify) {
@@ -137,7 +261,7 @@ namespace manager {
         }
 
         // Decompress and copy modified files to the repository.
-        for (const auto &[source, destination]: files_to_modify) {
+        for (const auto &[destination, source]: files_to_modify) {
             decompress_and_copy(source, root_directory + "/" + destination);
         }
     }
@@ -147,11 +271,44 @@ namespace manager {
  *
  * This function recursively scans the directory and its subdirectories for files, adding them to the set of tracked
  * files. It reads the .jitignore file to determine which files and directories to ignore based on regex patterns.
- * Files and directories matching these patterns are excluded from being tracked.
+ * Files and directories matching these patterns are excluded from being tracked, and so is everything outside the
+ * sparse checkout.
  *
  * @param dir The directory to scan for files.
+ * @param pathspec Limits the scan to the matching files; directories that cannot contain any are not entered.
+ */
+    void DirManager::get_nested_files_in_a_directory(const fs::path &dir, const Pathspec &pathspec) {
+        load_ignore_rules();
+        const SparseCheckout sparse_checkout = get_sparse_checkout();
+        files.clear();
+
+        // Scan the directory recursively, applying ignore rules.
+        if (fs::exists(dir) && fs::is_directory(dir)) {
+            for (auto it = fs::recursive_directory_iterator(dir); it != fs::recursive_directory_iterator(); ++it) {
+                const auto &entry = *it;
+                std::string relative_path = entry.path().lexically_relative(dir).generic_string();
+
+                if (entry.is_directory()) {
+                    if (relative_path == ".jit" || !pathspec.could_match_directory(relative_path) ||
+                        !sparse_checkout.could_include_directory(relative_path)) {
+                        it.disable_recursion_pending();
+                    }
+                } else if (!is_ignored(entry.path()) && pathspec.matches(relative_path) &&
+                           sparse_checkout.includes(relative_path)) {
+                    files.insert(entry.path().relative_path());
+                }
+            }
+        }
+    }
+
+/**
+ * @brief Loads the ignore rules from the .jitignore file.
+ *
+ * Every line of the .jitignore file is turned into a regex alternative. Lines ending with a slash are directory
+ * patterns matched against the whole path, the rest are matched against file names. The .jit directory is always
+ * ignored.
  */
-    void DirManager::get_nested_files_in_a_directory(const fs::path &dir) {
+    void DirManager::load_ignore_rules() {
         get_jit_root();  // Ensure the repository exists.
 
         // Read .jitignore file for patterns to ignore.
@@ -162,7 +319,6 @@ namespace manager {
         if (jit_ignore) {
             std::string line;
             bool has_started = false;
-            files.clear();
 
             // Process each line in .jitignore to build regex patterns.
             while (std::getline(jit_ignore, line)) {
@@ -179,31 +335,56 @@ namespace manager {
             }
         }
 
-        // Scan the directory recursively, applying ignore rules.
-        if (fs::exists(dir) && fs::is_directory(dir)) {
-            std::regex ignore_files_regex(ignore_file_names_regex_construction);
-            std::regex ignore_dirs_regex(ignore_directory_regex_construction);
-
-            for (const auto &entry: fs::recursive_directory_iterator(dir)) {
-                if (!entry.is_directory()) {
-                    std::string path_string = entry.path().string();
-                    std::string file_name = entry.path().filename().string();
-
-                    // Skip files or directories matching ignore rules.
-                    if (std::regex_search(path_string, ignore_dirs_regex) ||
-                        (!ignore_file_names_regex_construction.empty() &&
-                         std::regex_search(file_name, ignore_files_regex))) {
-                        continue;
-                    }
+        ignore_files_regex = std::regex(ignore_file_names_regex_construction);
+        ignore_dirs_regex = std::regex(ignore_directory_regex_construction);
+    }
 
-                    files.insert(entry.path().relative_path());
-                }
-            }
+/**
+ * @brief Checks whether a path matches the ignore rules loaded by load_ignore_rules.
+ *
+ * @param path The path of the file as seen when walking from the root directory.
+ * @return True if the file must not be tracked.
+ */
+    bool DirManager::is_ignored(const fs::path &path) {
+        return std::regex_search(path.string(), ignore_dirs_regex) ||
+               (!ignore_file_names_regex_construction.empty() &&
+                std::regex_search(path.filename().string(), ignore_files_regex));
+    }
+
+/**
+ * @brief Stats and optionally hashes a batch of files in the working tree.
+ *
+ * On the first call, picks the I/O engine and its limits from the repository configuration. Every worker holds at
+ * most one file open in the thread pool engine and at most half its queue depth with io_uring, which is used to keep
+ * the total number of open files under `core.maxOpenFiles`. The engine sizes itself down for small batches, so it is
+ * kept for the following calls.
+ *
+ * @param relative_paths The files to process, relative to the root directory.
+ * @param hash Whether the SHA1 of each file should be computed.
+ * @return One result per path, in the same order as `relative_paths`.
+ */
+    std::vector<FileScanResult> DirManager::scan_files(const std::vector<std::string> &relative_paths, bool hash) {
+        if (!io_engine) {
+            size_t max_open_files = std::max<size_t>(1, get_config_number("core.maxOpenFiles",
+                                                                          DEFAULT_MAX_OPEN_FILES));
+            size_t thread_count = resolve_thread_count(get_config_number("core.threads", 0), max_open_files);
+            size_t queue_depth = std::min(get_config_number("core.ioQueueDepth", DEFAULT_IO_QUEUE_DEPTH),
+                                          2 * max_open_files / thread_count);
+            io_engine = IoEngine::create(get_config_value("core.ioEngine", "auto"), thread_count, queue_depth);
+        }
+
+        std::vector<std::string> paths;
+        paths.reserve(relative_paths.size());
+        for (const auto &relative_path: relative_paths) {
+            paths.push_back(root_directory + "/" + relative_path);
         }
+
+        return io_engine->scan(paths, hash);
     }
 
     void DirManager::change_root_directory(const std::string &root_dir) {
         root_directory = root_dir;
         jit_directory = root_dir + "/.jit/";
+        io_engine.reset();
     }
 }
@@ -14,6 +14,12 @@
 #include <string>
 #include <filesystem>
 #include <map>
+#include <memory>
+#include <regex>
+#include <vector>
+#include "../JitUtility/io_engine.h"
+#include "Pathspec.h"
+#include "SparseCheckout.h"
 
 namespace manager {
 
@@ -43,9 +49,10 @@ namespace manager {
          * This function scans the root directory and returns a set of file paths that are tracked by the Jit repository.
          * It respects the `.jitignore` file to avoid tracking ignored files or directories.
          *
+         * @param pathspec Limits the scan to the matching files; directories that cannot contain any are not entered.
          * @return A set of relative file paths that are tracked by the repository.
          */
-        [[nodiscard]] std::set<std::string> get_files();
+        [[nodiscard]] std::set<std::string> get_files(const Pathspec &pathspec = Pathspec());
 
         /**
          * @brief Initializes a new Jit repository in the root directory.
@@ -78,34 +85,112 @@ namespace manager {
          */
         std::string get_jit_root();
 
+        /**
+         * @brief Reads a value from the repository configuration file (`.jit/config`).
+         *
+         * The configuration file holds one `key = value` pair per line. Empty lines and lines starting with `#` are
+         * ignored.
+         *
+         * @param key The configuration key, e.g. `core.threads`.
+         * @param default_value The value returned when the key is not set.
+         * @return The configured value, or `default_value`.
+         */
+        std::string get_config_value(const std::string &key, const std::string &default_value);
+
+        /**
+         * @brief Reads a non-negative number from the repository configuration file.
+         *
+         * @param key The configuration key, e.g. `core.threads`.
+         * @param default_value The value returned when the key is not set or is not a number.
+         * @return The configured number, or `default_value`.
+         */
+        size_t get_config_number(const std::string &key, size_t default_value);
+
+        /**
+         * @brief Sets a value in the repository configuration file, replacing the existing line for the key.
+         *
+         * @param key The configuration key, e.g. `core.sparseCheckout`.
+         * @param value The new value.
+         * @throws std::runtime_error If the configuration file cannot be written.
+         */
+        void set_config_value(const std::string &key, const std::string &value);
+
+        /**
+         * @brief Reads the sparse checkout of the repository.
+         *
+         * Sparse checkout is enabled by `core.sparseCheckout = true`; `core.sparseCheckoutCone = false` switches the
+         * patterns of `.jit/info/sparse-checkout` from cone directories to glob patterns.
+         *
+         * @return The sparse checkout, disabled when not configured.
+         */
+        SparseCheckout get_sparse_checkout();
+
     private:
         std::string root_directory; /**< The root directory of the repository. */
         std::string jit_directory;  /**< The directory where the Jit repository is initialized (i.e., `.jit`). */
         std::set<std::string> files; /**< A set of files tracked by the Jit repository. */
         std::string ignore_file_names_regex_construction; /**< Regex string for ignoring specific file names. */
         std::string ignore_directory_regex_construction; /**< Regex string for ignoring specific directories. */
+        std::regex ignore_files_regex; /**< Compiled regex for ignoring specific file names. */
+        std::regex ignore_dirs_regex; /**< Compiled regex for ignoring specific directories. */
+        std::unique_ptr<IoEngine> io_engine; /**< The engine used by `scan_files`, created on first use. */
 
     protected:
         /**
          * @brief Scans the directory recursively for files, respecting `.jitignore` rules.
          *
          * This function scans the specified directory and its subdirectories to collect file paths. It uses the patterns
-         * defined in the `.jitignore` file to exclude files and directories that match the ignore rules.
+         * defined in the `.jitignore` file to exclude files and directories that match the ignore rules. Files outside
+         * the sparse checkout are skipped and directories that cannot contain any part of it are not entered.
          *
          * @param dir The directory to scan recursively for tracked files.
+         * @param pathspec Limits the scan to the matching files; directories that cannot contain any are not entered.
          */
-        void get_nested_files_in_a_directory(const std::filesystem::path &dir);
+        void get_nested_files_in_a_directory(const std::filesystem::path &dir,
+                                             const Pathspec &pathspec = Pathspec());
+
+        /**
+         * @brief Loads the `.jitignore` rules used by `is_ignored`.
+         *
+         * @throws std::runtime_error If the root directory does not contain a Jit repository.
+         */
+        void load_ignore_rules();
+
+        /**
+         * @brief Checks whether a file matches the `.jitignore` rules.
+         *
+         * `load_ignore_rules` must have been called first.
+         *
+         * @param path The path of the file as seen when walking from the root directory.
+         * @return True if the file must not be tracked.
+         */
+        bool is_ignored(const std::filesystem::path &path);
+
+        /**
+         * @brief Stats and optionally hashes a batch of files in the working tree.
+         *
+         * The work is done by the engine selected by `core.ioEngine` (`auto`, `io_uring` or `threads`), using
+         * `core.threads` workers with up to `core.ioQueueDepth` requests in flight each. The number of files open at
+         * the same time never exceeds `core.maxOpenFiles`. The configuration is read and the engine created on the
+         * first call only; later batches reuse the engine.
+         *
+         * @param relative_paths The files to process, relative to the root directory.
+         * @param hash Whether the SHA1 of each file should be computed.
+         * @return One result per path, in the same order as `relative_paths`.
+         */
+        std::vector<FileScanResult> scan_files(const std::vector<std::string> &relative_paths, bool hash);
 
         /**
          * @brief Updates the repository by deleting and modifying files.
          *
          * This function performs updates to the Jit repository by:
          * 1. Deleting the files listed in the `files_to_delete` set.
-         * 2. Modifying or adding files by decompressing the specified source files and copying them to the target
-         *    destination paths.
+         * 2. Modifying or adding files by decompressing their objects and copying them to their paths.
+         *
+         * Files are keyed by their destination, so several files with the same content are all written.
          *
          * @param files_to_delete A set of file paths to delete from the root directory.
-         * @param files_to_modify A map of source file paths and corresponding destination paths in the repository.
+         * @param files_to_modify A map of destination paths in the repository and the objects to write there.
          */
         void update_repository(const std::set<std::string> &files_to_delete,
                                const std::map<std::string, std::string> &files_to_modify);
@@ -0,0 +1,485 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "FsMonitor.h"
+
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+namespace fs = std::filesystem;
+
+namespace manager {
+
+    /**
+     * The number of recorded changes after which the daemon forgets its history and asks clients for a full scan.
+     */
+    constexpr size_t MAX_TRACKED_CHANGES = 1 << 20;
+
+    constexpr uint32_t WATCH_MASK = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                    IN_MOVED_TO | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+    /**
+     * @brief Checks whether a relative path belongs to the `.jit` directory, which is never reported.
+     */
+    static bool is_jit_path(const std::string &relative_path) {
+        return relative_path == ".jit" || relative_path.starts_with(".jit/");
+    }
+
+    /**
+     * @brief Joins a directory relative to the root with an entry name.
+     */
+    static std::string join_path(const std::string &relative_dir, const std::string &name) {
+        return relative_dir.empty() ? name : relative_dir + "/" + name;
+    }
+
+    /**
+     * @brief Writes the whole buffer to a socket, ignoring a peer that went away.
+     */
+    static void send_all(int fd, const std::string &data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return;
+            }
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    /**
+     * @brief Constructs a monitor for the repository in the given root directory.
+     *
+     * @param root_directory The root directory of the repository.
+     */
+    FsMonitor::FsMonitor(const std::string &root_directory) : DirManager(root_directory) {
+        socket_path = get_jit_root() + "/fsmonitor.sock";
+    }
+
+    /**
+     * @brief Connects to the daemon socket.
+     *
+     * @return A connected socket descriptor, or -1 if no daemon is listening.
+     */
+    int FsMonitor::connect_to_daemon() {
+        sockaddr_un address{};
+        if (socket_path.size() >= sizeof(address.sun_path) || !fs::exists(socket_path)) {
+            return -1;
+        }
+
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -1;
+        }
+
+        if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+            close(fd);
+            return -1;
+        }
+
+        // A hung daemon must never hang the command asking it.
+        timeval timeout{5, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        return fd;
+    }
+
+    /**
+     * @brief Checks whether a daemon is listening for this repository.
+     *
+     * @return True if a daemon answered on the socket.
+     */
+    bool FsMonitor::is_running() {
+        int fd = connect_to_daemon();
+        if (fd < 0) {
+            return false;
+        }
+        close(fd);
+        return true;
+    }
+
+    /**
+     * @brief Asks the daemon which paths changed since the given token.
+     *
+     * @param token The token returned by the previous query.
+     * @return The daemon's answer, or an empty optional when no daemon is running.
+     */
+    std::optional<FsMonitorResponse> FsMonitor::query(const std::string &token) {
+        int fd = connect_to_daemon();
+        if (fd < 0) {
+            return std::nullopt;
+        }
+
+        send_all(fd, "QUERY " + token + "\n");
+
+        std::string reply;
+        char buffer[4096];
+        ssize_t n;
+        while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            reply.append(buffer, static_cast<size_t>(n));
+        }
+        close(fd);
+
+        if (n < 0) {
+            return std::nullopt;
+        }
+
+        std::istringstream stream(reply);
+        std::string status;
+        FsMonitorResponse response;
+
+        if (!(stream >> status >> response.token) || (status != "OK" && status != "FULL")) {
+            return std::nullopt;
+        }
+
+        response.is_reliable = status == "OK";
+        std::string line;
+        std::getline(stream, line);
+        while (std::getline(stream, line)) {
+            if (!line.empty()) {
+                response.changed_paths.insert(line);
+            }
+        }
+
+        return response;
+    }
+
+    /**
+     * @brief Starts the daemon in the background.
+     *
+     * @throws std::runtime_error If a daemon is already running for this repository or it cannot be started.
+     */
+    void FsMonitor::start() {
+        if (is_running()) {
+            throw std::runtime_error("fsmonitor is already running for this repository");
+        }
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            throw std::runtime_error("Could not start the fsmonitor daemon");
+        }
+
+        if (pid == 0) {
+            setsid();
+            int null_fd = open("/dev/null", O_RDWR);
+            if (null_fd >= 0) {
+                dup2(null_fd, STDIN_FILENO);
+                dup2(null_fd, STDOUT_FILENO);
+                dup2(null_fd, STDERR_FILENO);
+                close(null_fd);
+            }
+
+            try {
+                run();
+            } catch (const std::exception &) {
+                _exit(1);
+            }
+            _exit(0);
+        }
+
+        // The daemon only listens once the whole tree is watched, so it answering means no change can be missed.
+        // Watching a large tree takes a while; only the daemon exiting means it failed.
+        while (waitpid(pid, nullptr, WNOHANG) == 0) {
+            if (is_running()) {
+                std::cout << "fsmonitor started" << std::endl;
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        throw std::runtime_error("fsmonitor did not start");
+    }
+
+    /**
+     * @brief Asks a running daemon to exit.
+     *
+     * @throws std::runtime_error If no daemon is running for this repository.
+     */
+    void FsMonitor::stop() {
+        int fd = connect_to_daemon();
+        if (fd < 0) {
+            throw std::runtime_error("fsmonitor is not running for this repository");
+        }
+
+        send_all(fd, "STOP\n");
+        char buffer[16];
+        while (recv(fd, buffer, sizeof(buffer), 0) > 0) {}
+        close(fd);
+
+        std::cout << "fsmonitor stopped" << std::endl;
+    }
+
+    /**
+     * @brief Records a change of the given path at the current sequence.
+     *
+     * @param relative_path The changed path relative to the root directory.
+     */
+    void FsMonitor::record_change(const std::string &relative_path) {
+        if (relative_path.empty() || is_jit_path(relative_path)) {
+            return;
+        }
+
+        changes[relative_path] = sequence;
+
+        if (changes.size() > MAX_TRACKED_CHANGES) {
+            invalidate();
+        }
+    }
+
+    /**
+     * @brief Forgets every recorded change, forcing clients holding older tokens to do a full scan.
+     */
+    void FsMonitor::invalidate() {
+        changes.clear();
+        reliable_since = std::max(reliable_since, sequence);
+    }
+
+    /**
+     * @brief Adds inotify watches to a directory and all its subdirectories.
+     *
+     * @param relative_dir The directory relative to the root directory ("" for the root itself).
+     * @param mark_changed Whether files found while walking should be reported as changed.
+     */
+    void FsMonitor::watch_directory(const std::string &relative_dir, bool mark_changed) {
+        if (is_jit_path(relative_dir)) {
+            return;
+        }
+
+        fs::path absolute_dir = fs::path(get_root_directory()) / relative_dir;
+        int wd = inotify_add_watch(inotify_fd, absolute_dir.c_str(), WATCH_MASK);
+
+        if (wd < 0) {
+            if (errno == ENOSPC) {
+                // Out of watches: part of the tree is invisible, so no answer can ever be trusted.
+                invalidate();
+                reliable_since = UINT64_MAX;
+            }
+            return;
+        }
+        watched_directories[wd] = relative_dir;
+
+        std::error_code ec;
+        for (const auto &entry: fs::directory_iterator(absolute_dir, ec)) {
+            std::string child = join_path(relative_dir, entry.path().filename().string());
+
+            if (entry.is_directory(ec) && !entry.is_symlink(ec)) {
+                watch_directory(child, mark_changed);
+            } else if (mark_changed) {
+                record_change(child);
+            }
+        }
+    }
+
+    /**
+     * @brief Removes the watches of a directory and all its subdirectories.
+     *
+     * @param relative_dir The directory relative to the root directory.
+     */
+    void FsMonitor::unwatch_directory(const std::string &relative_dir) {
+        std::string prefix = relative_dir + "/";
+
+        for (auto it = watched_directories.begin(); it != watched_directories.end();) {
+            if (it->second == relative_dir || it->second.starts_with(prefix)) {
+                inotify_rm_watch(inotify_fd, it->first);
+                it = watched_directories.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /**
+     * @brief Reads and records all pending inotify events without blocking.
+     */
+    void FsMonitor::drain_events() {
+        alignas(inotify_event) char buffer[64 * 1024];
+
+        while (true) {
+            ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+            if (length <= 0) {
+                return;
+            }
+
+            for (char *ptr = buffer; ptr < buffer + length;) {
+                auto *event = reinterpret_cast<inotify_event *>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    invalidate();
+                    continue;
+                }
+
+                auto dir = watched_directories.find(event->wd);
+                if (dir == watched_directories.end()) {
+                    continue;
+                }
+
+                if (event->mask & IN_IGNORED) {
+                    watched_directories.erase(dir);
+                    continue;
+                }
+
+                if (event->len == 0) {
+                    continue;
+                }
+
+                std::string path = join_path(dir->second, event->name);
+
+                if (event->mask & IN_ISDIR) {
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                        // Files may have been created before the watch was in place, so report them all.
+                        watch_directory(path, true);
+                    } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                        unwatch_directory(path);
+                    }
+                }
+
+                record_change(path);
+            }
+        }
+    }
+
+    /**
+     * @brief Answers a single client request.
+     *
+     * @param client_fd The descriptor of the accepted client connection.
+     * @return False if the daemon was asked to stop.
+     */
+    bool FsMonitor::handle_client(int client_fd) {
+        timeval timeout{1, 0};
+        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        std::string request;
+        char buffer[512];
+        while (request.find('\n') == std::string::npos) {
+            ssize_t n = recv(client_fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                return true;
+            }
+            request.append(buffer, static_cast<size_t>(n));
+        }
+        request.erase(request.find('\n'));
+
+        if (request == "STOP") {
+            send_all(client_fd, "BYE\n");
+            return false;
+        }
+
+        if (!request.starts_with("QUERY")) {
+            return true;
+        }
+
+        // Everything that happened before the client asked must be part of the answer.
+        drain_events();
+
+        std::string token = request.size() > 6 ? request.substr(6) : "";
+        uint64_t since = 0;
+        bool is_reliable = false;
+
+        auto separator = token.rfind(':');
+        if (separator != std::string::npos && token.substr(0, separator) == instance_id) {
+            try {
+                since = std::stoull(token.substr(separator + 1));
+                is_reliable = since >= reliable_since;
+            } catch (const std::exception &) {
+                is_reliable = false;
+            }
+        }
+
+        std::string reply = (is_reliable ? "OK " : "FULL ") + instance_id + ":" + std::to_string(sequence) + "\n";
+        if (is_reliable) {
+            for (const auto &[path, changed_at]: changes) {
+                if (changed_at > since) {
+                    reply += path + "\n";
+                }
+            }
+        }
+        ++sequence;
+
+        send_all(client_fd, reply);
+        return true;
+    }
+
+    /**
+     * @brief Runs the daemon event loop in the foreground until a stop request is received.
+     *
+     * @throws std::runtime_error If inotify or the socket cannot be set up.
+     */
+    void FsMonitor::run() {
+        sockaddr_un address{};
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("fsmonitor socket path is too long: " + socket_path);
+        }
+
+        if (is_running()) {
+            throw std::runtime_error("fsmonitor is already running for this repository");
+        }
+        fs::remove(socket_path);
+
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd < 0) {
+            throw std::runtime_error("Could not initialize inotify");
+        }
+
+        instance_id = std::to_string(getpid()) + "-" +
+                      std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+        sequence = 1;
+        reliable_since = 1;
+
+        // The whole tree is watched before the socket accepts connections, so a daemon that answers has seen every
+        // change made since it was reported started.
+        watch_directory("", false);
+
+        int server_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+        if (server_fd < 0 || bind(server_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+            listen(server_fd, 16) != 0) {
+            close(inotify_fd);
+            throw std::runtime_error("Could not listen on " + socket_path);
+        }
+
+        bool keep_running = true;
+        while (keep_running) {
+            pollfd fds[2] = {{inotify_fd, POLLIN, 0},
+                             {server_fd,  POLLIN, 0}};
+
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+
+            if (fds[0].revents & POLLIN) {
+                drain_events();
+            }
+
+            if (fds[1].revents & POLLIN) {
+                int client_fd = accept4(server_fd, nullptr, nullptr, SOCK_CLOEXEC);
+                if (client_fd >= 0) {
+                    keep_running = handle_client(client_fd);
+                    close(client_fd);
+                }
+            }
+        }
+
+        close(server_fd);
+        close(inotify_fd);
+        fs::remove(socket_path);
+    }
+}
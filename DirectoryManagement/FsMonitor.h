@@ -0,0 +1,143 @@
+/**
+ * @file FsMonitor.h
+ * @brief Declares the FsMonitor class, an inotify-backed daemon that tracks working tree changes.
+ *
+ * The monitor watches every directory of the working tree (except `.jit`) and answers "what changed since token T"
+ * queries over a local unix socket. Commands that need the state of the working tree ask the monitor first and only
+ * fall back to a full scan when the answer cannot be trusted (event queue overflow, daemon restart, etc.).
+ */
+
+#ifndef JIT_FSMONITOR_H
+#define JIT_FSMONITOR_H
+
+#include <set>
+#include <string>
+#include <optional>
+#include <unordered_map>
+#include "DirManager.h"
+
+namespace manager {
+
+    /**
+     * @brief The answer of the monitor to a "what changed since token T" query.
+     */
+    struct FsMonitorResponse {
+        bool is_reliable = false;            /**< False when the caller has to fall back to a full scan. */
+        std::string token;                   /**< Token to be used on the next query. */
+        std::set<std::string> changed_paths; /**< Paths (files or directories) relative to the root directory. */
+    };
+
+    /**
+     * @class FsMonitor
+     * @brief Watches the working tree with inotify and serves change queries over a unix socket.
+     *
+     * The same class is used both as the daemon (`run`, `start`) and as the client (`query`, `stop`).
+     */
+    class FsMonitor : public DirManager {
+    public:
+        /**
+         * @brief Constructs a monitor for the repository in the given root directory.
+         *
+         * @param root_directory The root directory of the repository.
+         */
+        explicit FsMonitor(const std::string &root_directory);
+
+        /**
+         * @brief Starts the daemon in the background.
+         *
+         * @throws std::runtime_error If a daemon is already running for this repository or it cannot be started.
+         */
+        void start();
+
+        /**
+         * @brief Asks a running daemon to exit.
+         *
+         * @throws std::runtime_error If no daemon is running for this repository.
+         */
+        void stop();
+
+        /**
+         * @brief Runs the daemon event loop in the foreground until a stop request is received.
+         *
+         * @throws std::runtime_error If inotify or the socket cannot be set up.
+         */
+        void run();
+
+        /**
+         * @brief Asks the daemon which paths changed since the given token.
+         *
+         * An empty token (or a token issued by another daemon instance) produces an unreliable answer carrying a
+         * fresh token.
+         *
+         * @param token The token returned by the previous query.
+         * @return The daemon's answer, or an empty optional when no daemon is running.
+         */
+        std::optional<FsMonitorResponse> query(const std::string &token);
+
+        /**
+         * @brief Checks whether a daemon is listening for this repository.
+         *
+         * @return True if a daemon answered on the socket.
+         */
+        bool is_running();
+
+    private:
+        std::string socket_path;                                   /**< Path of the unix socket. */
+        std::string instance_id;                                   /**< Identifies this daemon instance in tokens. */
+        int inotify_fd = -1;                                       /**< The inotify instance of the daemon. */
+        uint64_t sequence = 0;                                     /**< Bumped for every batch of events. */
+        uint64_t reliable_since = 0;                               /**< Oldest sequence that can still be answered. */
+        std::unordered_map<int, std::string> watched_directories;  /**< inotify watch descriptor to directory. */
+        std::unordered_map<std::string, uint64_t> changes;         /**< Path to the sequence it last changed at. */
+
+        /**
+         * @brief Connects to the daemon socket.
+         *
+         * @return A connected socket descriptor, or -1 if no daemon is listening.
+         */
+        int connect_to_daemon();
+
+        /**
+         * @brief Adds inotify watches to a directory and all its subdirectories.
+         *
+         * @param relative_dir The directory relative to the root directory ("" for the root itself).
+         * @param mark_changed Whether files found while walking should be reported as changed.
+         */
+        void watch_directory(const std::string &relative_dir, bool mark_changed);
+
+        /**
+         * @brief Removes the watches of a directory and all its subdirectories.
+         *
+         * @param relative_dir The directory relative to the root directory.
+         */
+        void unwatch_directory(const std::string &relative_dir);
+
+        /**
+         * @brief Reads and records all pending inotify events without blocking.
+         */
+        void drain_events();
+
+        /**
+         * @brief Records a change of the given path at the current sequence.
+         *
+         * @param relative_path The changed path relative to the root directory.
+         */
+        void record_change(const std::string &relative_path);
+
+        /**
+         * @brief Forgets every recorded change, forcing clients holding older tokens to do a full scan.
+         */
+        void invalidate();
+
+        /**
+         * @brief Answers a single client request.
+         *
+         * @param client_fd The descriptor of the accepted client connection.
+         * @return False if the daemon was asked to stop.
+         */
+        bool handle_client(int client_fd);
+    };
+
+} // namespace manager
+
+#endif // JIT_FSMONITOR_H
@@ -0,0 +1,256 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "Pathspec.h"
+
+#include <filesystem>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+namespace manager {
+
+    /**
+     * @brief Checks whether a pattern contains glob characters.
+     */
+    static bool has_glob(const std::string &pattern) {
+        return pattern.find_first_of("*?[") != std::string::npos;
+    }
+
+    /**
+     * @brief Checks whether `prefix` is `path` itself or one of its leading directories.
+     */
+    static bool is_path_prefix(const std::string &prefix, const std::string &path) {
+        return path == prefix || (path.size() > prefix.size() && path.starts_with(prefix) && path[prefix.size()] == '/');
+    }
+
+    namespace {
+        /**
+         * @class GlobMatcher
+         * @brief Matches one path against one glob pattern without copying either.
+         *
+         * A `*` stays within a path component, so only the last one seen needs to be retried when a later character
+         * mismatches. A `**` may end anywhere further down the path; the positions from which it already failed are
+         * remembered, which keeps patterns with several of them polynomial.
+         */
+        class GlobMatcher {
+        public:
+            /**
+             * @param pattern The glob pattern.
+             * @param path The path.
+             */
+            GlobMatcher(std::string_view pattern, std::string_view path)
+                    : pattern(pattern), path(path), failed_globstars((pattern.size() + 1) * (path.size() + 1)) {}
+
+            /**
+             * @brief Checks whether the pattern from position `p` matches the path from position `s` to its end.
+             */
+            bool match(size_t p, size_t s) {
+                size_t star_p = std::string_view::npos, star_s = 0;
+
+                while (true) {
+                    if (p < pattern.size() && pattern[p] == '*') {
+                        if (p + 1 >= pattern.size() || pattern[p + 1] != '*') {
+                            star_p = ++p;
+                            star_s = s;
+                            continue;
+                        }
+                        if (match_globstar(p, s)) {
+                            return true;
+                        }
+                    } else if (p == pattern.size() && s == path.size()) {
+                        return true;
+                    } else if (p < pattern.size() && s < path.size() && match_character(p, path[s])) {
+                        ++s;
+                        continue;
+                    }
+
+                    // Let the last `*` absorb one more character, unless that would leave the path component.
+                    if (star_p == std::string_view::npos || star_s >= path.size() || path[star_s] == '/') {
+                        return false;
+                    }
+                    p = star_p;
+                    s = ++star_s;
+                }
+            }
+
+        private:
+            /**
+             * @brief Checks whether the `**` at pattern position `p`, followed by the rest of the pattern, matches the
+             * path from position `s`. A `**` followed by a slash also matches no directory at all.
+             */
+            bool match_globstar(size_t p, size_t s) {
+                size_t state = p * (path.size() + 1) + s;
+                if (failed_globstars[state]) {
+                    return false;
+                }
+
+                size_t rest = p + 2;
+                if (rest < pattern.size() && pattern[rest] == '/' && match(rest + 1, s)) {
+                    return true;
+                }
+                for (size_t end = s; end <= path.size(); ++end) {
+                    if (match(rest, end)) {
+                        return true;
+                    }
+                }
+
+                failed_globstars[state] = true;
+                return false;
+            }
+
+            /**
+             * @brief Matches one path character against the `?`, character class or literal at pattern position `p`.
+             *
+             * @param p The pattern position, moved past the matched item.
+             * @param c The path character.
+             * @return True if the character matches.
+             */
+            bool match_character(size_t &p, char c) const {
+                char pc = pattern[p];
+                if (pc == '?') {
+                    ++p;
+                    return c != '/';
+                }
+                if (pc == '[') {
+                    size_t close = pattern.find(']', p + 2);
+                    if (close != std::string_view::npos) {
+                        bool negate = pattern[p + 1] == '!' || pattern[p + 1] == '^';
+                        bool found = false;
+                        for (size_t i = p + (negate ? 2 : 1); i < close; ++i) {
+                            if (i + 2 < close && pattern[i + 1] == '-') {
+                                found |= pattern[i] <= c && c <= pattern[i + 2];
+                                i += 2;
+                            } else {
+                                found |= pattern[i] == c;
+                            }
+                        }
+                        p = close + 1;
+                        return found != negate && c != '/';
+                    }
+                }
+                ++p;
+                return pc == c;
+            }
+
+            std::string_view pattern;            /**< The glob pattern. */
+            std::string_view path;               /**< The path being matched. */
+            std::vector<bool> failed_globstars;  /**< `**` positions, by pattern and path position, known not to match. */
+        };
+    }
+
+    /**
+     * @brief Constructs a pathspec from the patterns given on the command line.
+     *
+     * @param patterns The patterns, relative to the repository root.
+     */
+    Pathspec::Pathspec(const std::vector<std::string> &patterns) {
+        match_all = patterns.empty();
+
+        for (const auto &pattern: patterns) {
+            std::string normalized = fs::path(pattern).lexically_normal().generic_string();
+            while (normalized.size() > 1 && normalized.back() == '/') {
+                normalized.pop_back();
+            }
+
+            if (normalized.empty() || normalized == ".") {
+                match_all = true;
+            } else {
+                this->patterns.push_back(normalized);
+            }
+        }
+    }
+
+    /**
+     * @brief Checks whether the pathspec matches every path.
+     */
+    bool Pathspec::matches_everything() const {
+        return match_all;
+    }
+
+    /**
+     * @brief Returns the normalized patterns.
+     */
+    const std::vector<std::string> &Pathspec::get_patterns() const {
+        return patterns;
+    }
+
+    /**
+     * @brief Checks whether a file is selected by the pathspec.
+     *
+     * @param path A normalized path relative to the repository root.
+     * @return True if any pattern matches the path.
+     */
+    bool Pathspec::matches(const std::string &path) const {
+        if (match_all) {
+            return true;
+        }
+
+        for (const auto &pattern: patterns) {
+            if (!has_glob(pattern)) {
+                if (is_path_prefix(pattern, path)) {
+                    return true;
+                }
+                continue;
+            }
+
+            // A glob selects the paths it matches and everything inside the directories it matches.
+            for (size_t end = path.find('/'); ; end = path.find('/', end + 1)) {
+                if (glob_match(pattern, std::string_view(path).substr(0, end))) {
+                    return true;
+                }
+                if (end == std::string::npos) {
+                    break;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Checks whether a directory may contain files selected by the pathspec.
+     *
+     * Only the leading components of a pattern that contain no glob characters are compared with the directory: a
+     * pattern under `src/net` prunes everything outside `src/net`, while one starting with a glob prunes nothing.
+     *
+     * @param directory A normalized directory path relative to the repository root.
+     * @return True if some file below the directory could match.
+     */
+    bool Pathspec::could_match_directory(const std::string &directory) const {
+        if (match_all || directory.empty() || directory == ".") {
+            return true;
+        }
+
+        for (const auto &pattern: patterns) {
+            size_t glob_position = pattern.find_first_of("*?[");
+            std::string literal_prefix = pattern;
+
+            if (glob_position != std::string::npos) {
+                size_t slash = pattern.rfind('/', glob_position);
+                if (slash == std::string::npos) {
+                    return true;
+                }
+                literal_prefix = pattern.substr(0, slash);
+            }
+
+            if (is_path_prefix(literal_prefix, directory) || is_path_prefix(directory, literal_prefix)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Matches a path against a single glob pattern.
+     *
+     * @param pattern The glob pattern.
+     * @param path The path.
+     * @return True if the whole path matches the pattern.
+     */
+    bool Pathspec::glob_match(std::string_view pattern, std::string_view path) {
+        return GlobMatcher(pattern, path).match(0, 0);
+    }
+}
@@ -0,0 +1,84 @@
+/**
+ * @file Pathspec.h
+ * @brief Declares the Pathspec class used to limit commands to parts of the working tree.
+ */
+
+#ifndef JIT_PATHSPEC_H
+#define JIT_PATHSPEC_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace manager {
+
+    /**
+     * @class Pathspec
+     * @brief A set of path patterns, relative to the repository root, limiting the files a command looks at.
+     *
+     * A pattern without glob characters matches the path itself and everything below it (`src/net` matches
+     * `src/net/socket.cc`). Patterns with glob characters are matched against the whole path or one of its leading
+     * directories: `?` matches one character, `*` any run of characters within a path component, `**` any number of
+     * components and `[...]` a character class. An empty pathspec matches everything.
+     */
+    class Pathspec {
+    public:
+        /**
+         * @brief Constructs a pathspec matching every path.
+         */
+        Pathspec() = default;
+
+        /**
+         * @brief Constructs a pathspec from the patterns given on the command line.
+         *
+         * Patterns are normalized, so `./src/`, `src/.` and `src` are equivalent. `.` matches everything.
+         *
+         * @param patterns The patterns, relative to the repository root.
+         */
+        explicit Pathspec(const std::vector<std::string> &patterns);
+
+        /**
+         * @brief Checks whether the pathspec matches every path.
+         */
+        [[nodiscard]] bool matches_everything() const;
+
+        /**
+         * @brief Checks whether a file is selected by the pathspec.
+         *
+         * @param path A normalized path relative to the repository root.
+         * @return True if any pattern matches the path.
+         */
+        [[nodiscard]] bool matches(const std::string &path) const;
+
+        /**
+         * @brief Checks whether a directory may contain files selected by the pathspec.
+         *
+         * This is used to prune the directory walk: directories for which it returns false are not entered.
+         *
+         * @param directory A normalized directory path relative to the repository root.
+         * @return True if some file below the directory could match.
+         */
+        [[nodiscard]] bool could_match_directory(const std::string &directory) const;
+
+        /**
+         * @brief Returns the normalized patterns.
+         */
+        [[nodiscard]] const std::vector<std::string> &get_patterns() const;
+
+        /**
+         * @brief Matches a path against a single glob pattern.
+         *
+         * @param pattern The glob pattern.
+         * @param path The path.
+         * @return True if the whole path matches the pattern.
+         */
+        static bool glob_match(std::string_view pattern, std::string_view path);
+
+    private:
+        std::vector<std::string> patterns; /**< The normalized patterns; empty matches everything. */
+        bool match_all = true;             /**< True when a pattern selects the whole tree. */
+    };
+
+} // namespace manager
+
+#endif // JIT_PATHSPEC_H
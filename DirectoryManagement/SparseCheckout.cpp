@@ -0,0 +1,197 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "SparseCheckout.h"
+#include "Pathspec.h"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace manager {
+
+    /**
+     * @brief Checks whether `prefix` is `path` itself or one of its leading directories.
+     */
+    static bool is_path_prefix(const std::string &prefix, const std::string &path) {
+        return path == prefix || (path.size() > prefix.size() && path.starts_with(prefix) && path[prefix.size()] == '/');
+    }
+
+    /**
+     * @brief Returns the directory holding a path, empty for files at the root.
+     */
+    static std::string parent_directory(const std::string &path) {
+        auto slash = path.rfind('/');
+        return slash == std::string::npos ? "" : path.substr(0, slash);
+    }
+
+    /**
+     * @brief Constructs an enabled sparse checkout from its patterns.
+     *
+     * Cone directories are normalized so that `./src/`, `/src` and `src` are equivalent; `.` is dropped since the
+     * root files are always included.
+     *
+     * @param patterns Directories in cone mode, glob patterns otherwise.
+     * @param cone_mode Whether the patterns are cone directories.
+     */
+    SparseCheckout::SparseCheckout(const std::vector<std::string> &patterns, bool cone_mode)
+            : enabled(true), cone_mode(cone_mode) {
+        for (const auto &pattern: patterns) {
+            if (!cone_mode) {
+                bool negated = pattern.starts_with("!");
+                this->patterns.push_back(pattern);
+                rules.push_back({Pathspec({negated ? pattern.substr(1) : pattern}), negated});
+                continue;
+            }
+
+            std::string normalized = fs::path(pattern).lexically_normal().generic_string();
+            normalized.erase(0, normalized.find_first_not_of('/'));
+            while (!normalized.empty() && normalized.back() == '/') {
+                normalized.pop_back();
+            }
+
+            if (!normalized.empty() && normalized != ".") {
+                this->patterns.push_back(normalized);
+            }
+        }
+    }
+
+    /**
+     * @brief Reads the sparse checkout of a repository.
+     *
+     * Empty lines and lines starting with `#` are ignored. A missing pattern file leaves only the root files.
+     *
+     * @param jit_root The `.jit` directory of the repository.
+     * @param enabled Whether sparse checkout is enabled.
+     * @param cone_mode Whether the patterns are cone directories.
+     * @return The sparse checkout; disabled if `enabled` is false.
+     */
+    SparseCheckout SparseCheckout::load(const std::string &jit_root, bool enabled, bool cone_mode) {
+        if (!enabled) {
+            return {};
+        }
+
+        std::ifstream file(jit_root + "/info/sparse-checkout");
+        std::vector<std::string> patterns;
+        std::string line;
+
+        while (std::getline(file, line)) {
+            line.erase(0, line.find_first_not_of(" \t"));
+            line.erase(line.find_last_not_of(" \t") + 1);
+            if (!line.empty() && !line.starts_with("#")) {
+                patterns.push_back(line);
+            }
+        }
+
+        return {patterns, cone_mode};
+    }
+
+    /**
+     * @brief Writes the patterns to `.jit/info/sparse-checkout`, one per line.
+     *
+     * @param jit_root The `.jit` directory of the repository.
+     * @throws std::runtime_error If the file cannot be written.
+     */
+    void SparseCheckout::save(const std::string &jit_root) const {
+        fs::create_directories(jit_root + "/info");
+
+        std::ofstream file(jit_root + "/info/sparse-checkout");
+        if (!file) {
+            throw std::runtime_error("Could not write the sparse-checkout file");
+        }
+
+        for (const auto &pattern: patterns) {
+            file << pattern << '\n';
+        }
+    }
+
+    /**
+     * @brief Checks whether sparse checkout is enabled.
+     */
+    bool SparseCheckout::is_enabled() const {
+        return enabled;
+    }
+
+    /**
+     * @brief Checks whether the patterns are cone directories.
+     */
+    bool SparseCheckout::is_cone_mode() const {
+        return cone_mode;
+    }
+
+    /**
+     * @brief Returns the patterns.
+     */
+    const std::vector<std::string> &SparseCheckout::get_patterns() const {
+        return patterns;
+    }
+
+    /**
+     * @brief Checks whether a file belongs to the sparse set and must be present on disk.
+     *
+     * @param path A normalized file path relative to the repository root.
+     * @return True if the file is part of the sparse set.
+     */
+    bool SparseCheckout::includes(const std::string &path) const {
+        if (!enabled) {
+            return true;
+        }
+
+        if (cone_mode) {
+            std::string parent = parent_directory(path);
+            if (parent.empty()) {
+                return true;
+            }
+
+            for (const auto &cone: patterns) {
+                if (is_path_prefix(cone, parent) || is_path_prefix(parent, cone)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool included = false;
+        for (const auto &rule: rules) {
+            if (rule.pathspec.matches(path)) {
+                included = !rule.negated;
+            }
+        }
+        return included;
+    }
+
+    /**
+     * @brief Checks whether a directory may contain files of the sparse set.
+     *
+     * In full pattern mode only the positive patterns are looked at: a negation can only remove files, so it never
+     * makes a directory worth entering.
+     *
+     * @param directory A normalized directory path relative to the repository root.
+     * @return False if the directory walk can skip the directory.
+     */
+    bool SparseCheckout::could_include_directory(const std::string &directory) const {
+        if (!enabled || directory.empty() || directory == ".") {
+            return true;
+        }
+
+        if (!cone_mode) {
+            for (const auto &rule: rules) {
+                if (!rule.negated && rule.pathspec.could_match_directory(directory)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        for (const auto &cone: patterns) {
+            if (is_path_prefix(cone, directory) || is_path_prefix(directory, cone)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+} // namespace manager
@@ -0,0 +1,110 @@
+/**
+ * @file SparseCheckout.h
+ * @brief Declares the SparseCheckout class describing which part of the repository is present on disk.
+ */
+
+#ifndef JIT_SPARSECHECKOUT_H
+#define JIT_SPARSECHECKOUT_H
+
+#include "Pathspec.h"
+
+#include <string>
+#include <vector>
+
+namespace manager {
+
+    /**
+     * @class SparseCheckout
+     * @brief The set of paths materialized in the working tree, read from `.jit/info/sparse-checkout`.
+     *
+     * In cone mode every line of the file is a directory. A cone includes everything below its directory, the files
+     * directly inside each of its parent directories, and the files at the root of the repository. Directories that
+     * are not on the way to a cone are never entered.
+     *
+     * In full pattern mode every line is a glob pattern (see Pathspec); a line starting with `!` excludes what it
+     * matches, and the last matching line decides.
+     *
+     * A disabled sparse checkout includes everything.
+     */
+    class SparseCheckout {
+    public:
+        /**
+         * @brief Constructs a disabled sparse checkout, which includes every path.
+         */
+        SparseCheckout() = default;
+
+        /**
+         * @brief Constructs an enabled sparse checkout from its patterns.
+         *
+         * @param patterns Directories in cone mode, glob patterns otherwise.
+         * @param cone_mode Whether the patterns are cone directories.
+         */
+        SparseCheckout(const std::vector<std::string> &patterns, bool cone_mode);
+
+        /**
+         * @brief Reads the sparse checkout of a repository.
+         *
+         * @param jit_root The `.jit` directory of the repository.
+         * @param enabled Whether sparse checkout is enabled (`core.sparseCheckout`).
+         * @param cone_mode Whether the patterns are cone directories (`core.sparseCheckoutCone`).
+         * @return The sparse checkout; disabled if `enabled` is false.
+         */
+        static SparseCheckout load(const std::string &jit_root, bool enabled, bool cone_mode);
+
+        /**
+         * @brief Writes the patterns to `.jit/info/sparse-checkout`.
+         *
+         * @param jit_root The `.jit` directory of the repository.
+         * @throws std::runtime_error If the file cannot be written.
+         */
+        void save(const std::string &jit_root) const;
+
+        /**
+         * @brief Checks whether sparse checkout is enabled.
+         */
+        [[nodiscard]] bool is_enabled() const;
+
+        /**
+         * @brief Checks whether the patterns are cone directories.
+         */
+        [[nodiscard]] bool is_cone_mode() const;
+
+        /**
+         * @brief Returns the patterns.
+         */
+        [[nodiscard]] const std::vector<std::string> &get_patterns() const;
+
+        /**
+         * @brief Checks whether a file belongs to the sparse set and must be present on disk.
+         *
+         * @param path A normalized file path relative to the repository root.
+         * @return True if the file is part of the sparse set.
+         */
+        [[nodiscard]] bool includes(const std::string &path) const;
+
+        /**
+         * @brief Checks whether a directory may contain files of the sparse set.
+         *
+         * @param directory A normalized directory path relative to the repository root.
+         * @return False if the directory walk can skip the directory.
+         */
+        [[nodiscard]] bool could_include_directory(const std::string &directory) const;
+
+    private:
+        /**
+         * @brief A full pattern mode line, compiled once.
+         */
+        struct Rule {
+            Pathspec pathspec; /**< The pattern without its `!`. */
+            bool negated;      /**< Whether the line excludes what it matches. */
+        };
+
+        bool enabled = false;              /**< A disabled sparse checkout includes everything. */
+        bool cone_mode = true;             /**< Whether the patterns are cone directories. */
+        std::vector<std::string> patterns; /**< Normalized cone directories or glob patterns. */
+        std::vector<Rule> rules;           /**< The patterns as compiled rules; empty in cone mode. */
+    };
+
+} // namespace manager
+
+#endif // JIT_SPARSECHECKOUT_H
@@ -0,0 +1,317 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "diff_algorithms.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+    /**
+     * Shared recursion of the anchored algorithms: the common prefix and suffix of a range are matched, and what is
+     * left in between is split around anchors by the subclass, or diffed with Myers when it finds none.
+     *
+     * Line ids are dense, so the per-id tables of the subclasses are plain arrays; each split resets the entries it
+     * touched instead of clearing them.
+     */
+    class AnchoredDiff {
+    public:
+        AnchoredDiff(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines)
+                : a(old_lines), b(new_lines) {
+            for (uint32_t id: a) {
+                id_count = std::max<size_t>(id_count, id + 1);
+            }
+            for (uint32_t id: b) {
+                id_count = std::max<size_t>(id_count, id + 1);
+            }
+        }
+
+        virtual ~AnchoredDiff() = default;
+
+        std::vector<DiffMatch> run() {
+            compare(0, a.size(), 0, b.size());
+            return std::move(matches);
+        }
+
+    protected:
+        const std::vector<uint32_t> &a;
+        const std::vector<uint32_t> &b;
+        size_t id_count = 0;
+        std::vector<DiffMatch> matches;
+
+        void compare(size_t a_begin, size_t a_end, size_t b_begin, size_t b_end) {
+            size_t prefix = 0;
+            while (a_begin + prefix < a_end && b_begin + prefix < b_end && a[a_begin + prefix] == b[b_begin + prefix]) {
+                ++prefix;
+            }
+            append_match(matches, a_begin, b_begin, prefix);
+            a_begin += prefix;
+            b_begin += prefix;
+
+            size_t suffix = 0;
+            while (a_begin < a_end - suffix && b_begin < b_end - suffix &&
+                   a[a_end - suffix - 1] == b[b_end - suffix - 1]) {
+                ++suffix;
+            }
+            a_end -= suffix;
+            b_end -= suffix;
+
+            if (a_begin < a_end && b_begin < b_end && !split(a_begin, a_end, b_begin, b_end)) {
+                diff_line_range(a, b, a_begin, a_end, b_begin, b_end, AUTO_DIFF_COST, matches);
+            }
+
+            append_match(matches, a_end, b_end, suffix);
+        }
+
+        /**
+         * Matches a range whose first and last lines differ on both sides, through compare on the parts between
+         * its anchors.
+         *
+         * @return false, having matched nothing, if the range has no anchor.
+         */
+        virtual bool split(size_t a_begin, size_t a_end, size_t b_begin, size_t b_end) = 0;
+    };
+
+    class PatienceDiff : public AnchoredDiff {
+    public:
+        PatienceDiff(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines)
+                : AnchoredDiff(old_lines, new_lines), occurrences(id_count) {}
+
+    private:
+        struct Occurrence {
+            uint32_t old_count = 0;
+            uint32_t new_count = 0;
+            size_t old_line = 0;
+            size_t new_line = 0;
+        };
+
+        std::vector<Occurrence> occurrences;  ///< Per line id, within the range being split.
+
+        bool split(size_t a_begin, size_t a_end, size_t b_begin, size_t b_end) override {
+            for (size_t i = a_begin; i < a_end; ++i) {
+                auto &occurrence = occurrences[a[i]];
+                ++occurrence.old_count;
+                occurrence.old_line = i;
+            }
+            for (size_t j = b_begin; j < b_end; ++j) {
+                auto &occurrence = occurrences[b[j]];
+                ++occurrence.new_count;
+                occurrence.new_line = j;
+            }
+
+            // The lines unique on both sides, in old-file order.
+            std::vector<std::pair<size_t, size_t>> unique;
+            for (size_t i = a_begin; i < a_end; ++i) {
+                const auto &occurrence = occurrences[a[i]];
+                if (occurrence.old_count == 1 && occurrence.new_count == 1) {
+                    unique.emplace_back(i, occurrence.new_line);
+                }
+            }
+
+            for (size_t i = a_begin; i < a_end; ++i) {
+                occurrences[a[i]] = {};
+            }
+            for (size_t j = b_begin; j < b_end; ++j) {
+                occurrences[b[j]] = {};
+            }
+            if (unique.empty()) {
+                return false;
+            }
+
+            // Longest increasing subsequence on the new-file line, by patience sorting: each pile keeps its
+            // smallest top, and each card links to the top of the pile to its left when it was placed.
+            std::vector<size_t> piles;
+            std::vector<size_t> previous(unique.size());
+            for (size_t card = 0; card < unique.size(); ++card) {
+                auto pile = std::lower_bound(piles.begin(), piles.end(), unique[card].second,
+                                             [&unique](size_t top, size_t line) { return unique[top].second < line; });
+                previous[card] = pile == piles.begin() ? SIZE_MAX : *(pile - 1);
+                if (pile == piles.end()) {
+                    piles.push_back(card);
+                } else {
+                    *pile = card;
+                }
+            }
+
+            std::vector<size_t> anchors;
+            for (size_t card = piles.back(); card != SIZE_MAX; card = previous[card]) {
+                anchors.push_back(card);
+            }
+            std::reverse(anchors.begin(), anchors.end());
+
+            for (size_t anchor: anchors) {
+                auto [old_line, new_line] = unique[anchor];
+                compare(a_begin, old_line, b_begin, new_line);
+                append_match(matches, old_line, new_line, 1);
+                a_begin = old_line + 1;
+                b_begin = new_line + 1;
+            }
+            compare(a_begin, a_end, b_begin, b_end);
+            return true;
+        }
+    };
+
+    class HistogramDiff : public AnchoredDiff {
+    public:
+        HistogramDiff(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines)
+                : AnchoredDiff(old_lines, new_lines), counts(id_count, 0), first(id_count, SIZE_MAX),
+                  next_same(old_lines.size(), SIZE_MAX) {}
+
+    private:
+        std::vector<uint32_t> counts;   ///< Occurrences of each line id in the old range being split.
+        std::vector<size_t> first;      ///< First old line with each id in that range.
+        std::vector<size_t> next_same;  ///< Next old line in that range with the same id as this one.
+
+        bool split(size_t a_begin, size_t a_end, size_t b_begin, size_t b_end) override {
+            for (size_t i = a_end; i-- > a_begin;) {
+                next_same[i] = first[a[i]];
+                first[a[i]] = i;
+                ++counts[a[i]];
+            }
+
+            size_t best_old = 0, best_new = 0, best_length = 0;
+            size_t best_count = HISTOGRAM_MAX_CHAIN_LENGTH + 1;
+            for (size_t j = b_begin; j < b_end;) {
+                size_t next = j + 1;
+                if (counts[b[j]] == 0 || counts[b[j]] > best_count) {
+                    j = next;
+                    continue;
+                }
+
+                for (size_t i = first[b[j]]; i != SIZE_MAX; i = next_same[i]) {
+                    // Extend the match both ways, keeping the occurrence count of its rarest line.
+                    size_t count = counts[b[j]];
+                    size_t old_start = i, new_start = j;
+                    while (old_start > a_begin && new_start > b_begin && a[old_start - 1] == b[new_start - 1]) {
+                        --old_start;
+                        --new_start;
+                        count = std::min<size_t>(count, counts[a[old_start]]);
+                    }
+                    size_t old_end = i + 1, new_end = j + 1;
+                    while (old_end < a_end && new_end < b_end && a[old_end] == b[new_end]) {
+                        count = std::min<size_t>(count, counts[a[old_end]]);
+                        ++old_end;
+                        ++new_end;
+                    }
+
+                    if (count < best_count || (count == best_count && old_end - old_start > best_length)) {
+                        best_old = old_start;
+                        best_new = new_start;
+                        best_length = old_end - old_start;
+                        best_count = count;
+                    }
+                    next = std::max(next, new_end);
+                }
+                j = next;
+            }
+
+            for (size_t i = a_begin; i < a_end; ++i) {
+                counts[a[i]] = 0;
+                first[a[i]] = SIZE_MAX;
+            }
+            if (best_length == 0) {
+                return false;
+            }
+            compare(a_begin, best_old, b_begin, best_new);
+            append_match(matches, best_old, best_new, best_length);
+            compare(best_old + best_length, a_end, best_new + best_length, b_end);
+            return true;
+        }
+    };
+}
+
+std::optional<DiffAlgorithm> parse_diff_algorithm(const std::string &name) {
+    static const std::unordered_map<std::string, DiffAlgorithm> algorithms = {
+            {"auto",      DiffAlgorithm::AUTO},
+            {"myers",     DiffAlgorithm::MYERS},
+            {"default",   DiffAlgorithm::MYERS},
+            {"minimal",   DiffAlgorithm::MINIMAL},
+            {"patience",  DiffAlgorithm::PATIENCE},
+            {"histogram", DiffAlgorithm::HISTOGRAM},
+    };
+
+    auto algorithm = algorithms.find(name);
+    if (algorithm == algorithms.end()) {
+        return std::nullopt;
+    }
+    return algorithm->second;
+}
+
+DiffAlgorithm choose_diff_algorithm(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines) {
+    if (old_lines.size() + new_lines.size() < AUTO_MINIMAL_MAX_LINES) {
+        return DiffAlgorithm::MINIMAL;
+    }
+
+    size_t id_count = 0;
+    for (uint32_t id: old_lines) {
+        id_count = std::max<size_t>(id_count, id + 1);
+    }
+    std::vector<uint32_t> counts(id_count, 0);
+    for (uint32_t id: old_lines) {
+        ++counts[id];
+    }
+    size_t unique = std::count(counts.begin(), counts.end(), 1);
+
+    return unique * 100 >= old_lines.size() * AUTO_PATIENCE_MIN_UNIQUE_PERCENT ? DiffAlgorithm::PATIENCE
+                                                                               : DiffAlgorithm::HISTOGRAM;
+}
+
+std::vector<DiffMatch> patience_diff(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines) {
+    return PatienceDiff(old_lines, new_lines).run();
+}
+
+std::vector<DiffMatch> histogram_diff(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines) {
+    return HistogramDiff(old_lines, new_lines).run();
+}
+
+std::vector<DiffMatch> diff_lines(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines,
+                                  DiffAlgorithm algorithm) {
+    if (algorithm == DiffAlgorithm::AUTO) {
+        algorithm = choose_diff_algorithm(old_lines, new_lines);
+    }
+
+    switch (algorithm) {
+        case DiffAlgorithm::MINIMAL:
+            return diff_lines(old_lines, new_lines, UNLIMITED_DIFF_COST);
+        case DiffAlgorithm::PATIENCE:
+            return patience_diff(old_lines, new_lines);
+        case DiffAlgorithm::HISTOGRAM:
+            return histogram_diff(old_lines, new_lines);
+        default:
+            return diff_lines(old_lines, new_lines, AUTO_DIFF_COST);
+    }
+}
+
+std::vector<DiffMatch> diff_lines(const std::vector<std::string> &old_lines, const std::vector<std::string> &new_lines,
+                                  DiffAlgorithm algorithm, WhitespaceMode whitespace) {
+    // Byte-identical lines at both ends are matched by comparing the strings, which is a size check and a memcmp, so
+    // only the lines in between are hashed; identical files return here without hashing anything.
+    size_t prefix = 0;
+    while (prefix < old_lines.size() && prefix < new_lines.size() && old_lines[prefix] == new_lines[prefix]) {
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while (suffix < old_lines.size() - prefix && suffix < new_lines.size() - prefix &&
+           old_lines[old_lines.size() - suffix - 1] == new_lines[new_lines.size() - suffix - 1]) {
+        ++suffix;
+    }
+
+    std::vector<DiffMatch> matches;
+    append_match(matches, 0, 0, prefix);
+
+    size_t old_end = old_lines.size() - suffix;
+    size_t new_end = new_lines.size() - suffix;
+    if (prefix < old_end && prefix < new_end) {
+        LineInterner interner(whitespace);
+        std::vector<uint32_t> old_ids = interner.intern(old_lines, prefix, old_end);
+        std::vector<uint32_t> new_ids = interner.intern(new_lines, prefix, new_end);
+        for (const auto &match: diff_lines(old_ids, new_ids, algorithm)) {
+            append_match(matches, match.old_begin + prefix, match.new_begin + prefix, match.length);
+        }
+    }
+
+    append_match(matches, old_end, new_end, suffix);
+    return matches;
+}
@@ -0,0 +1,94 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#ifndef JIT_DIFF_ALGORITHMS_H
+#define JIT_DIFF_ALGORITHMS_H
+
+#include <optional>
+#include <string>
+#include <vector>
+#include "myers_diff.h"
+
+/**
+ * The ways of aligning two files, as named by `jit diff --diff-algorithm=`.
+ */
+enum class DiffAlgorithm {
+    AUTO,       ///< Chosen per file pair by choose_diff_algorithm.
+    MYERS,      ///< Myers with the default cost cutoff.
+    MINIMAL,    ///< Myers without a cost cutoff: always a shortest diff.
+    PATIENCE,   ///< Anchored on the lines found exactly once in each file.
+    HISTOGRAM,  ///< Anchored on the longest common region of least-repeated lines.
+};
+
+/**
+ * Files with fewer lines than this, both sides together, are always diffed with minimal Myers by DiffAlgorithm::AUTO.
+ */
+constexpr size_t AUTO_MINIMAL_MAX_LINES = 512;
+
+/**
+ * Share of the old file's lines, in percent, that must be unique for DiffAlgorithm::AUTO to use patience rather than
+ * histogram.
+ */
+constexpr size_t AUTO_PATIENCE_MIN_UNIQUE_PERCENT = 60;
+
+/**
+ * Lines repeated more often than this in the old side are never used by histogram to anchor a region.
+ */
+constexpr size_t HISTOGRAM_MAX_CHAIN_LENGTH = 64;
+
+/**
+ * @param name "auto", "myers", "minimal", "patience" or "histogram".
+ * @return The algorithm, or nothing if the name is unknown.
+ */
+std::optional<DiffAlgorithm> parse_diff_algorithm(const std::string &name);
+
+/**
+ * Picks the algorithm DiffAlgorithm::AUTO uses for two files.
+ *
+ * Small inputs get a minimal Myers diff, which is cheap at that size. Otherwise, when most lines of the old file are
+ * unique, patience has plenty of anchors and aligns on them in near-linear time; when they are not, as with code full
+ * of braces and blank lines, histogram anchors on the rarest lines instead.
+ */
+DiffAlgorithm choose_diff_algorithm(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines);
+
+/**
+ * Patience diff: matches the common prefix and suffix, then the longest increasing sequence of lines that appear
+ * exactly once in each side, and recurses between them. A range without such lines is diffed with Myers.
+ *
+ * @return The common runs, in increasing order on both sides; adjacent runs are merged.
+ */
+std::vector<DiffMatch> patience_diff(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines);
+
+/**
+ * Histogram diff: matches the common prefix and suffix, then the longest common region whose rarest line occurs the
+ * fewest times in the old side, and recurses on each side of it. A range without such a region is diffed with Myers.
+ *
+ * @return The common runs, in increasing order on both sides; adjacent runs are merged.
+ */
+std::vector<DiffMatch> histogram_diff(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines);
+
+/**
+ * Finds the lines two files have in common with the given algorithm.
+ *
+ * @param old_lines The line ids of the old file, from a LineInterner shared with the new file.
+ * @param new_lines The line ids of the new file.
+ * @return The common runs, in increasing order on both sides; adjacent runs are merged.
+ */
+std::vector<DiffMatch> diff_lines(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines,
+                                  DiffAlgorithm algorithm);
+
+/**
+ * Interns the lines of two files, normalizing their whitespace as asked, and finds the lines they have in common
+ * with the given algorithm.
+ *
+ * The common prefix and suffix are matched first by comparing the lines themselves, and only the lines between them
+ * are interned and diffed, so a single change in a large file costs one pass over it. Identical files return as soon
+ * as that pass ends.
+ *
+ * @return The common runs, in increasing order on both sides; adjacent runs are merged.
+ */
+std::vector<DiffMatch> diff_lines(const std::vector<std::string> &old_lines, const std::vector<std::string> &new_lines,
+                                  DiffAlgorithm algorithm, WhitespaceMode whitespace = WhitespaceMode::EXACT);
+
+#endif //JIT_DIFF_ALGORITHMS_H
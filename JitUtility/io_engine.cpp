@@ -0,0 +1,546 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "io_engine.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <openssl/evp.h>
+
+#ifdef JIT_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+/**
+ * Size of the read buffer used while hashing a file.
+ */
+constexpr size_t READ_BUFFER_SIZE = 64 * 1024;
+
+/**
+ * Incremental SHA1 through the EVP digest API, formatted the same way generateSHA1 does.
+ */
+class Sha1 {
+public:
+    Sha1() : context(EVP_MD_CTX_new()) {
+        if (context == nullptr) {
+            throw std::bad_alloc();
+        }
+        reset();
+    }
+
+    ~Sha1() {
+        EVP_MD_CTX_free(context);
+    }
+
+    Sha1(const Sha1 &) = delete;
+
+    Sha1 &operator=(const Sha1 &) = delete;
+
+    void reset() {
+        EVP_DigestInit_ex(context, EVP_sha1(), nullptr);
+    }
+
+    void update(const void *data, size_t size) {
+        EVP_DigestUpdate(context, data, size);
+    }
+
+    std::string hex_digest() {
+        unsigned char hash[EVP_MAX_MD_SIZE];
+        unsigned int length = 0;
+        EVP_DigestFinal_ex(context, hash, &length);
+
+        std::ostringstream oss;
+        for (unsigned int i = 0; i < length; ++i) {
+            oss << std::hex << std::setw(2) << std::setfill('0') << (int) hash[i];
+        }
+        return oss.str();
+    }
+
+private:
+    EVP_MD_CTX *context;
+};
+
+static std::chrono::system_clock::time_point to_time_point(int64_t seconds, int64_t nanoseconds) {
+    return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::seconds(seconds) + std::chrono::nanoseconds(nanoseconds)));
+}
+
+/**
+ * Portable backend: blocking stat/open/read calls spread over a pool of worker threads.
+ */
+class ThreadPoolEngine : public IoEngine {
+public:
+    explicit ThreadPoolEngine(size_t thread_count) : thread_count(thread_count) {}
+
+    std::vector<FileScanResult> scan(const std::vector<std::string> &paths, bool hash) override {
+        std::vector<FileScanResult> results(paths.size());
+
+        run_in_parallel(paths.size(), resolve_thread_count(thread_count, paths.size()), [&](size_t, size_t task) {
+            results[task] = scan_file(paths[task], hash);
+        });
+
+        return results;
+    }
+
+    [[nodiscard]] std::string name() const override {
+        return "threads";
+    }
+
+private:
+    size_t thread_count;
+
+    static FileScanResult scan_file(const std::string &path, bool hash) {
+        FileScanResult result;
+        struct stat file_stat{};
+
+        if (::stat(path.c_str(), &file_stat) != 0) {
+            return result;
+        }
+
+        result.exists = true;
+        result.size = static_cast<uint64_t>(file_stat.st_size);
+        result.last_modified = to_time_point(file_stat.st_mtim.tv_sec, file_stat.st_mtim.tv_nsec);
+
+        if (!hash) {
+            return result;
+        }
+
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return result;
+        }
+
+        Sha1 sha1;
+        std::vector<char> buffer(READ_BUFFER_SIZE);
+        ssize_t n;
+        while ((n = ::read(fd, buffer.data(), buffer.size())) > 0) {
+            sha1.update(buffer.data(), static_cast<size_t>(n));
+        }
+        ::close(fd);
+
+        if (n == 0) {
+            result.checksum = sha1.hex_digest();
+        }
+        return result;
+    }
+};
+
+#ifdef JIT_HAVE_IO_URING
+
+/**
+ * Minimal io_uring wrapper talking to the kernel through raw syscalls, so no liburing is needed.
+ */
+class IoUring {
+public:
+    explicit IoUring(unsigned entries) {
+        io_uring_params params{};
+        ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ring_fd < 0) {
+            throw std::runtime_error("io_uring_setup failed");
+        }
+
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        }
+
+        sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                       IORING_OFF_SQ_RING);
+        cq_ring = (params.features & IORING_FEAT_SINGLE_MMAP) ? sq_ring :
+                  mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                       IORING_OFF_CQ_RING);
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe *>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                                                MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+
+        if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+            release();
+            throw std::runtime_error("io_uring mmap failed");
+        }
+
+        auto *sq = static_cast<char *>(sq_ring);
+        sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+        auto *cq = static_cast<char *>(cq_ring);
+        cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    }
+
+    ~IoUring() {
+        release();
+    }
+
+    IoUring(const IoUring &) = delete;
+
+    IoUring &operator=(const IoUring &) = delete;
+
+    /**
+     * Checks that the running kernel supports every opcode the engine uses.
+     */
+    [[nodiscard]] bool supports_scan_ops() const {
+        constexpr unsigned op_count = 64;
+        std::vector<char> buffer(sizeof(io_uring_probe) + op_count * sizeof(io_uring_probe_op), 0);
+        auto *probe = reinterpret_cast<io_uring_probe *>(buffer.data());
+
+        if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, op_count) < 0) {
+            return false;
+        }
+
+        for (unsigned op: {IORING_OP_STATX, IORING_OP_OPENAT, IORING_OP_READ}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Queues a zeroed submission entry; it is sent to the kernel by the next submit_and_wait.
+     */
+    io_uring_sqe *next_sqe() {
+        unsigned tail = *sq_tail;
+        unsigned index = tail & sq_mask;
+        io_uring_sqe *sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        ++pending_submissions;
+        return sqe;
+    }
+
+    /**
+     * Submits the queued entries and waits for at least `wait_count` completions.
+     */
+    void submit_and_wait(unsigned wait_count) {
+        while (true) {
+            long result = syscall(__NR_io_uring_enter, ring_fd, pending_submissions, wait_count,
+                                  IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (result >= 0) {
+                pending_submissions -= static_cast<unsigned>(result);
+                return;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                throw std::runtime_error("io_uring_enter failed");
+            }
+        }
+    }
+
+    /**
+     * Calls `handler(user_data, result)` for every available completion.
+     */
+    template<typename Handler>
+    void reap(Handler handler) {
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+        while (head != tail) {
+            const io_uring_cqe &cqe = cqes[head & cq_mask];
+            uint64_t user_data = cqe.user_data;
+            int result = cqe.res;
+            ++head;
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+            handler(user_data, result);
+        }
+    }
+
+private:
+    int ring_fd = -1;
+    void *sq_ring = MAP_FAILED;
+    void *cq_ring = MAP_FAILED;
+    io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    size_t sq_ring_size = 0, cq_ring_size = 0, sqes_size = 0;
+    unsigned *sq_head = nullptr, *sq_tail = nullptr, *sq_array = nullptr;
+    unsigned *cq_head = nullptr, *cq_tail = nullptr;
+    unsigned sq_mask = 0, cq_mask = 0;
+    io_uring_cqe *cqes = nullptr;
+    unsigned pending_submissions = 0;
+
+    void release() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+        if (cq_ring != MAP_FAILED && cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+        if (sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_size);
+        sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+        sq_ring = cq_ring = MAP_FAILED;
+        if (ring_fd >= 0) close(ring_fd);
+        ring_fd = -1;
+    }
+};
+
+/**
+ * io_uring backend: every worker owns a ring and keeps up to queue_depth statx/openat/read requests in flight,
+ * hashing each read buffer as its completion arrives.
+ */
+class IoUringEngine : public IoEngine {
+public:
+    IoUringEngine(size_t thread_count, size_t queue_depth) : thread_count(thread_count),
+                                                              queue_depth(std::max<size_t>(2, queue_depth)) {}
+
+    /**
+     * Checks that rings can be created and support the needed opcodes (they may be disabled by seccomp, by
+     * `kernel.io_uring_disabled` or simply missing on older kernels). The kernel does not change while the process
+     * runs, so the probe is only done once and its answer reused.
+     */
+    static bool is_available(size_t queue_depth) {
+        static const bool available = [queue_depth] {
+            try {
+                IoUring ring(static_cast<unsigned>(std::max<size_t>(2, queue_depth)));
+                return ring.supports_scan_ops();
+            } catch (const std::exception &) {
+                return false;
+            }
+        }();
+        return available;
+    }
+
+    std::vector<FileScanResult> scan(const std::vector<std::string> &paths, bool hash) override {
+        std::vector<FileScanResult> results(paths.size());
+        std::atomic<size_t> next_path = 0;
+        size_t workers = resolve_thread_count(thread_count, (paths.size() + queue_depth - 1) / queue_depth);
+
+        run_in_parallel(workers, workers, [&](size_t, size_t) {
+            scan_with_ring(paths, hash, results, next_path);
+        });
+
+        return results;
+    }
+
+    [[nodiscard]] std::string name() const override {
+        return "io_uring";
+    }
+
+private:
+    size_t thread_count;
+    size_t queue_depth;
+
+    /**
+     * The progress of one file through statx, openat, read... and close.
+     */
+    struct Slot {
+        size_t path_index = 0;
+        int fd = -1;
+        int pending = 0;
+        bool failed = false;
+        uint64_t offset = 0;
+        struct statx statx_buffer{};
+        Sha1 sha1;
+        std::vector<char> buffer;
+    };
+
+    // The low bits of the user data carry the operation, the rest the slot index.
+    enum Operation : uint64_t {
+        STATX = 0, OPEN = 1, READ = 2
+    };
+
+    static uint64_t user_data(size_t slot, Operation op) {
+        return (static_cast<uint64_t>(slot) << 2) | op;
+    }
+
+    /**
+     * Waits for the requests still in flight after an error, as far as the ring still works, and closes every file
+     * the slots opened, so that nothing writes into the slots once they are gone and no descriptor leaks.
+     */
+    static void abandon(IoUring &ring, std::vector<Slot> &slots) {
+        try {
+            while (std::any_of(slots.begin(), slots.end(), [](const Slot &slot) { return slot.pending > 0; })) {
+                ring.submit_and_wait(1);
+                ring.reap([&](uint64_t data, int result) {
+                    Slot &slot = slots[data >> 2];
+                    if ((data & 3) == OPEN && result >= 0) {
+                        slot.fd = result;
+                    }
+                    --slot.pending;
+                });
+            }
+        } catch (const std::exception &) {
+            // Closing the broken ring cancels whatever is left.
+        }
+
+        for (Slot &slot: slots) {
+            if (slot.fd >= 0) {
+                ::close(slot.fd);
+                slot.fd = -1;
+            }
+        }
+    }
+
+    void scan_with_ring(const std::vector<std::string> &paths, bool hash, std::vector<FileScanResult> &results,
+                        std::atomic<size_t> &next_path) const {
+        // A slot has at most two requests in flight (statx + openat), so the ring can never overflow; it is sized
+        // from the requested depth, not the rounded-up ring, which keeps open files within core.maxOpenFiles. The
+        // slots are declared first so that they outlive the ring and the requests still writing into them.
+        std::vector<Slot> slots(std::max<size_t>(1, queue_depth / 2));
+        IoUring ring(static_cast<unsigned>(queue_depth));
+        std::vector<size_t> free_slots;
+        for (size_t i = slots.size(); i > 0; --i) {
+            free_slots.push_back(i - 1);
+        }
+
+        size_t in_flight = 0;
+        bool has_more_paths = true;
+
+        auto queue_read = [&](size_t slot_index) {
+            Slot &slot = slots[slot_index];
+            io_uring_sqe *sqe = ring.next_sqe();
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = slot.fd;
+            sqe->addr = reinterpret_cast<uint64_t>(slot.buffer.data());
+            sqe->len = static_cast<uint32_t>(slot.buffer.size());
+            sqe->off = slot.offset;
+            sqe->user_data = user_data(slot_index, READ);
+            slot.pending = 1;
+        };
+
+        auto finish = [&](size_t slot_index) {
+            Slot &slot = slots[slot_index];
+            FileScanResult &result = results[slot.path_index];
+
+            if (!slot.failed && hash && slot.fd >= 0) {
+                result.checksum = slot.sha1.hex_digest();
+            }
+            if (slot.fd >= 0) {
+                ::close(slot.fd);
+            }
+
+            slot.fd = -1;
+            free_slots.push_back(slot_index);
+            --in_flight;
+        };
+
+        try {
+            while (true) {
+                // Fill the free slots with new files.
+                while (has_more_paths && !free_slots.empty()) {
+                    size_t path_index = next_path.fetch_add(1);
+                    if (path_index >= paths.size()) {
+                        has_more_paths = false;
+                        break;
+                    }
+
+                    size_t slot_index = free_slots.back();
+                    free_slots.pop_back();
+                    Slot &slot = slots[slot_index];
+                    slot.path_index = path_index;
+                    slot.fd = -1;
+                    slot.failed = false;
+                    slot.offset = 0;
+                    slot.pending = 1;
+                    ++in_flight;
+
+                    io_uring_sqe *stat_sqe = ring.next_sqe();
+                    stat_sqe->opcode = IORING_OP_STATX;
+                    stat_sqe->fd = AT_FDCWD;
+                    stat_sqe->addr = reinterpret_cast<uint64_t>(paths[path_index].c_str());
+                    stat_sqe->len = STATX_TYPE | STATX_SIZE | STATX_MTIME;
+                    stat_sqe->off = reinterpret_cast<uint64_t>(&slot.statx_buffer);
+                    stat_sqe->user_data = user_data(slot_index, STATX);
+
+                    if (hash) {
+                        if (slot.buffer.empty()) {
+                            slot.buffer.resize(READ_BUFFER_SIZE);
+                        }
+                        slot.sha1.reset();
+
+                        io_uring_sqe *open_sqe = ring.next_sqe();
+                        open_sqe->opcode = IORING_OP_OPENAT;
+                        open_sqe->fd = AT_FDCWD;
+                        open_sqe->addr = reinterpret_cast<uint64_t>(paths[path_index].c_str());
+                        open_sqe->open_flags = O_RDONLY | O_CLOEXEC;
+                        open_sqe->user_data = user_data(slot_index, OPEN);
+                        slot.pending = 2;
+                    }
+                }
+
+                if (in_flight == 0) {
+                    return;
+                }
+
+                ring.submit_and_wait(1);
+
+                ring.reap([&](uint64_t data, int result) {
+                    size_t slot_index = data >> 2;
+                    Slot &slot = slots[slot_index];
+                    FileScanResult &scan_result = results[slot.path_index];
+
+                    switch (static_cast<Operation>(data & 3)) {
+                        case STATX:
+                            if (result == 0) {
+                                scan_result.exists = true;
+                                scan_result.size = slot.statx_buffer.stx_size;
+                                scan_result.last_modified = to_time_point(slot.statx_buffer.stx_mtime.tv_sec,
+                                                                          slot.statx_buffer.stx_mtime.tv_nsec);
+                            }
+                            break;
+                        case OPEN:
+                            if (result >= 0) {
+                                slot.fd = result;
+                            } else {
+                                slot.failed = true;
+                            }
+                            break;
+                        case READ:
+                            if (result > 0) {
+                                slot.sha1.update(slot.buffer.data(), static_cast<size_t>(result));
+                                slot.offset += static_cast<uint64_t>(result);
+                                queue_read(slot_index);
+                                return;
+                            } else if (result < 0) {
+                                slot.failed = true;
+                            }
+                            break;
+                    }
+
+                    if (--slot.pending > 0) {
+                        return;
+                    }
+
+                    // statx and openat are both done, or the last read returned end of file.
+                    if (hash && !slot.failed && slot.fd >= 0 && (data & 3) != READ) {
+                        queue_read(slot_index);
+                    } else {
+                        finish(slot_index);
+                    }
+                });
+            }
+        } catch (...) {
+            abandon(ring, slots);
+            throw;
+        }
+    }
+};
+
+#endif
+
+/**
+ * Creates the engine to be used for working tree scans.
+ *
+ * @param backend "io_uring", "threads" or "auto".
+ * @param thread_count Number of worker threads.
+ * @param queue_depth Maximum number of requests in flight per io_uring worker.
+ * @return The engine.
+ */
+std::unique_ptr<IoEngine> IoEngine::create(const std::string &backend, size_t thread_count, size_t queue_depth) {
+#ifdef JIT_HAVE_IO_URING
+    if (backend != "threads" && IoUringEngine::is_available(queue_depth)) {
+        return std::make_unique<IoUringEngine>(thread_count, queue_depth);
+    }
+#endif
+    return std::make_unique<ThreadPoolEngine>(thread_count);
+}
@@ -0,0 +1,61 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#ifndef JIT_IO_ENGINE_H
+#define JIT_IO_ENGINE_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * The result of stating (and optionally hashing) a single file.
+ */
+struct FileScanResult {
+    bool exists = false;                                   ///< False if the file could not be stated.
+    uint64_t size = 0;                                     ///< Size of the file in bytes.
+    std::chrono::system_clock::time_point last_modified;   ///< Modification time of the file.
+    std::string checksum;                                  ///< SHA1 of the content, empty if not hashed or unreadable.
+};
+
+/**
+ * Stats and hashes batches of files.
+ *
+ * Two backends exist: an io_uring backend (Linux only, built when JIT_HAVE_IO_URING is defined) that keeps up to
+ * `queue_depth` statx/openat/read requests in flight per worker, and a portable backend that runs blocking syscalls
+ * on a pool of worker threads. In both cases the latency of one file's syscalls overlaps with the others'.
+ */
+class IoEngine {
+public:
+    virtual ~IoEngine() = default;
+
+    /**
+     * Creates the engine to be used for working tree scans.
+     *
+     * @param backend "io_uring", "threads" or "auto". "auto" and "io_uring" fall back to the thread pool when
+     *                io_uring is not available at build time or is refused by the kernel. The kernel is only
+     *                probed by the first call; the answer is reused by the next ones.
+     * @param thread_count Number of worker threads (each io_uring worker owns its own ring).
+     * @param queue_depth Maximum number of requests in flight per io_uring worker.
+     * @return The engine.
+     */
+    static std::unique_ptr<IoEngine> create(const std::string &backend, size_t thread_count, size_t queue_depth);
+
+    /**
+     * Stats every file and, if requested, computes the SHA1 of its content.
+     *
+     * @param paths The files to process.
+     * @param hash Whether the content of each file should be hashed.
+     * @return One result per path, in the same order as `paths`.
+     */
+    virtual std::vector<FileScanResult> scan(const std::vector<std::string> &paths, bool hash) = 0;
+
+    /**
+     * @return The name of the backend, for diagnostics.
+     */
+    [[nodiscard]] virtual std::string name() const = 0;
+};
+
+#endif //JIT_IO_ENGINE_H
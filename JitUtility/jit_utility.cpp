@@ -12,6 +12,12 @@
 #include <openssl/sha.h>
 #include <iomanip>
 #include <regex>
+#include <optional>
+#include <algorithm>
+
+namespace {
+    constexpr size_t INFLATE_CHUNK_SIZE = 64 * 1024;  ///< Bytes decompressed at a time by read_binary_as_text.
+}
 
 /**
  * Converts a time_point to a string formatted as "YYYY-MM-DD HH:MM:SS".
@@ -120,6 +126,95 @@ std::string generateSHA1(const std::string &file_path) {
     return oss.str();
 }
 
+/**
+ * Generates the SHA1 checksum of data held in memory.
+ *
+ * @param content The data to hash.
+ * @return The SHA1 checksum of the data in hexadecimal string format.
+ */
+std::string generate_sha1_of_content(const std::string &content) {
+    unsigned char hash[SHA_DIGEST_LENGTH];
+    SHA1(reinterpret_cast<const unsigned char *>(content.data()), content.size(), hash);
+
+    std::ostringstream oss;
+    for (unsigned char i: hash) {
+        oss << std::hex << std::setw(2) << std::setfill('0') << (int) i;
+    }
+
+    return oss.str();
+}
+
+/**
+ * Compresses data held in memory and saves it in the directory structure based on its checksum.
+ *
+ * @param destination The root directory where the object will be saved.
+ * @param content The data to save.
+ * @return The SHA1 checksum of the data.
+ * @throws std::runtime_error If an error occurs during compression or file operations.
+ */
+std::string save_content_as_binary(const std::string &destination, const std::string &content) {
+    std::string checksum = generate_sha1_of_content(content);
+    fs::path file_path = fs::path(destination) / generate_file_path(checksum);
+
+    if (fs::exists(file_path)) {
+        return checksum;
+    }
+    fs::create_directories(file_path.parent_path());
+
+    uLongf compressed_size = compressBound(content.size());
+    std::vector<Bytef> compressed_data(compressed_size);
+
+    int result = compress(compressed_data.data(), &compressed_size,
+                          reinterpret_cast<const Bytef *>(content.data()), content.size());
+    if (result != Z_OK) {
+        throw std::runtime_error("Error compressing object " + checksum);
+    }
+
+    std::ofstream output(file_path, std::ios::binary);
+    if (!output) {
+        throw std::runtime_error("Cannot open " + file_path.string() + " for writing");
+    }
+    output.write(reinterpret_cast<const char *>(compressed_data.data()), static_cast<long>(compressed_size));
+    output.close();
+
+    fs::permissions(file_path, fs::perms::owner_read | fs::perms::group_read, fs::perm_options::replace);
+    return checksum;
+}
+
+/**
+ * Reads a compressed object and returns its decompressed content.
+ *
+ * The decompression buffer starts at four times the compressed size and doubles until the content fits.
+ *
+ * @param source The path to the compressed object.
+ * @return The decompressed content.
+ * @throws std::runtime_error If the object cannot be read or decompressed.
+ */
+std::string read_binary_as_string(const std::string &source) {
+    std::ifstream input(source, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Cannot open source " + source + " for reading");
+    }
+
+    std::vector<char> compressed_data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    input.close();
+
+    for (uLongf capacity = std::max<uLongf>(64, compressed_data.size() * 4); ; capacity *= 2) {
+        std::string decompressed_data(capacity, '\0');
+        uLongf decompressed_size = capacity;
+
+        int result = uncompress(reinterpret_cast<Bytef *>(decompressed_data.data()), &decompressed_size,
+                                reinterpret_cast<const Bytef *>(compressed_data.data()), compressed_data.size());
+
+        if (result == Z_OK) {
+            decompressed_data.resize(decompressed_size);
+            return decompressed_data;
+        } else if (result != Z_BUF_ERROR) {
+            throw std::runtime_error("Error decompressing " + source);
+        }
+    }
+}
+
 /**
  * Saves a file in a binary format in a directory structure based on its checksum.
  *
@@ -279,59 +374,74 @@ fs::path generate_file_path(const std::string &checksum) {
 }
 
 /**
- * Computes the Longest Common Subsequence (LCS) table between two files represented as vectors of strings.
+ * Generates the hunks of a diff between two files represented as vectors of strings from the runs of lines they have
+ * in common.
  *
  * @param file1 The first file represented as a vector of strings.
  * @param file2 The second file represented as a vector of strings.
- * @return A 2D vector representing the LCS table.
+ * @param matches The common runs of the two files, as returned by diff_lines.
+ * @param context_lines The number of unchanged lines shown before and after each change.
+ * @param visit Called with each hunk, in file order; the hunk points into `file1` and `file2`.
  */
-std::vector<std::vector<int>>
-compute_lcs_table(const std::vector<std::string> &file1, const std::vector<std::string> &file2) {
-    size_t n = file1.size(), m = file2.size();
-    std::vector<std::vector<int>> lcs_table(n + 1, std::vector<int>(m + 1, 0));
-
-    for (size_t i = 1; i <= n; ++i) {
-        for (size_t j = 1; j <= m; ++j) {
-            if (file1[i - 1] == file2[j - 1]) {
-                lcs_table[i][j] = lcs_table[i - 1][j - 1] + 1;
-            } else {
-                lcs_table[i][j] = std::max(lcs_table[i - 1][j], lcs_table[i][j - 1]);
-            }
+void generate_diff(const std::vector<std::string> &file1, const std::vector<std::string> &file2,
+                   const std::vector<DiffMatch> &matches, size_t context_lines,
+                   const std::function<void(const DiffHunk &)> &visit) {
+    size_t i = 0, j = 0;
+    size_t common = 0;  // Length of the common run ending at (i, j), not yet added to any hunk.
+    std::optional<DiffHunk> hunk;
+
+    // Context lines lie in a common run, at the same offset from (i, j) on both sides; the new text is shown.
+    auto add_context = [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            hunk->lines.push_back({' ', file2[k + j - i]});
         }
-    }
-    return lcs_table;
-}
+        hunk->old_count += end - begin;
+        hunk->new_count += end - begin;
+    };
+
+    auto add_change = [&](size_t old_end, size_t new_end) {
+        if (hunk) {
+            add_context(i - common, i);
+        } else {
+            size_t lead = std::min(common, context_lines);
+            hunk = DiffHunk{i - lead, 0, j - lead, 0, {}};
+            add_context(i - lead, i);
+        }
+        for (; i < old_end; ++i, ++hunk->old_count) {
+            hunk->lines.push_back({'-', file1[i]});
+        }
+        for (; j < new_end; ++j, ++hunk->new_count) {
+            hunk->lines.push_back({'+', file2[j]});
+        }
+    };
 
-/**
- * Generates a diff between two files represented as vectors of strings based on the LCS table.
- *
- * @param file1 The first file represented as a vector of strings.
- * @param file2 The second file represented as a vector of strings.
- * @param lcs_table The LCS table computed between the two files.
- * @return A vector of strings representing the diff between the files.
- */
-std::vector<std::string> generate_diff(const std::vector<std::string> &file1, const std::vector<std::string> &file2,
-                                       const std::vector<std::vector<int>> &lcs_table) {
-    size_t i = file1.size(), j = file2.size();
-    std::vector<std::string> diff;
-
-    while (i > 0 || j > 0) {
-        if (i > 0 && j > 0 && file1[i - 1] == file2[j - 1]) {
-            diff.push_back("  " + file1[i - 1]);
-            --i;
-            --j;
-        } else if (j > 0 && (i == 0 || lcs_table[i][j - 1] >= lcs_table[i - 1][j])) {
-            diff.push_back("+ " + file2[j - 1]);
-            --j;
-        } else if (j == 0 || lcs_table[i][j - 1] < lcs_table[i - 1][j]) {
-            diff.push_back("- " + file1[i - 1]);
-            --i;
+    auto close_hunk = [&](size_t trail) {
+        add_context(i - common, i - common + trail);
+        visit(*hunk);
+        hunk.reset();
+    };
+
+    for (const auto &match: matches) {
+        if (match.old_begin > i || match.new_begin > j) {
+            add_change(match.old_begin, match.new_begin);
         }
-    }
+        i += match.length;
+        j += match.length;
+        common = match.length;
 
-    std::reverse(diff.begin(), diff.end());
+        // A long enough common run ends the hunk; a shorter one is kept as context if another change follows.
+        if (hunk && common > 2 * context_lines) {
+            close_hunk(context_lines);
+        }
+    }
 
-    return diff;
+    if (i < file1.size() || j < file2.size()) {
+        add_change(file1.size(), file2.size());
+        common = 0;
+    }
+    if (hunk) {
+        close_hunk(std::min(common, context_lines));
+    }
 }
 
 /**
@@ -353,34 +463,46 @@ std::vector<std::string> read_binary_as_text(const std::string &source) {
                                           std::istreambuf_iterator<char>());
         input.close();
 
-        // Prepare the decompression buffer
-        uLongf decompressed_size = compressed_data.size() * 4; // Initial size estimate
-        std::vector<Bytef> decompressed_data(decompressed_size);
-
-        // Decompress the data
-        int result = uncompress(decompressed_data.data(), &decompressed_size,
-                                reinterpret_cast<const Bytef *>(compressed_data.data()), compressed_data.size());
-
-        if (result == Z_BUF_ERROR) {
-            throw std::runtime_error("Buffer size is too small for decompression");
-        } else if (result != Z_OK) {
+        z_stream stream{};
+        if (inflateInit(&stream) != Z_OK) {
             throw std::runtime_error("Error decompressing file data");
         }
+        stream.next_in = reinterpret_cast<Bytef *>(compressed_data.data());
+        stream.avail_in = static_cast<uInt>(compressed_data.size());
 
-        // Resize decompressed data to actual size
-        decompressed_data.resize(decompressed_size);
-
-        // Convert decompressed data to string
-        std::string decompressed_text(decompressed_data.begin(), decompressed_data.end());
-
-        // Split the decompressed text into lines
+        // Inflate a chunk at a time and split the lines as they come out, so the decompressed text is never held
+        // whole and its size need not be guessed.
         std::vector<std::string> lines;
-        std::istringstream text_stream(decompressed_text);
         std::string line;
-        while (std::getline(text_stream, line)) {
-            lines.push_back(line);
+        char chunk[INFLATE_CHUNK_SIZE];
+        int result = Z_OK;
+        while (result != Z_STREAM_END) {
+            stream.next_out = reinterpret_cast<Bytef *>(chunk);
+            stream.avail_out = sizeof(chunk);
+            result = inflate(&stream, Z_NO_FLUSH);
+            if (result != Z_OK && result != Z_STREAM_END) {
+                inflateEnd(&stream);
+                throw std::runtime_error("Error decompressing file data");
+            }
+
+            const char *begin = chunk;
+            const char *end = chunk + (sizeof(chunk) - stream.avail_out);
+            while (begin != end) {
+                const char *newline = std::find(begin, end, '\n');
+                line.append(begin, newline);
+                if (newline == end) {
+                    break;
+                }
+                lines.push_back(std::move(line));
+                line.clear();
+                begin = newline + 1;
+            }
         }
+        inflateEnd(&stream);
 
+        if (!line.empty()) {
+            lines.push_back(std::move(line));
+        }
         return lines;
     } catch (const std::exception &e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -389,16 +511,39 @@ std::vector<std::string> read_binary_as_text(const std::string &source) {
 }
 
 /**
- * Computes and generates a diff between two files represented as vectors of strings.
+ * Computes and generates the hunks of a diff between two files represented as vectors of strings.
  *
  * @param file1 The first file represented as a vector of strings.
  * @param file2 The second file represented as a vector of strings.
- * @return A vector of strings representing the diff between the files.
+ * @param algorithm The algorithm aligning the two files.
+ * @param whitespace Which whitespace differences are ignored when comparing lines.
+ * @param context_lines The number of unchanged lines shown before and after each change.
+ * @param visit Called with each hunk, in file order.
  */
-std::vector<std::string> compute_diff(const std::vector<std::string> &file1, const std::vector<std::string> &file2) {
-    // Calculate LCS table
-    std::vector<std::vector<int>> lcs_table = compute_lcs_table(file1, file2);
+void compute_diff(const std::vector<std::string> &file1, const std::vector<std::string> &file2,
+                  DiffAlgorithm algorithm, WhitespaceMode whitespace, size_t context_lines,
+                  const std::function<void(const DiffHunk &)> &visit) {
+    // Find the common runs of lines, comparing interned line ids
+    std::vector<DiffMatch> matches = diff_lines(file1, file2, algorithm, whitespace);
+
+    // Generate the hunks from them
+    generate_diff(file1, file2, matches, context_lines, visit);
+}
 
-    // Generate and return the diff
-    return generate_diff(file1, file2, lcs_table);
+/**
+ * Counts the lines added and deleted between two files, without generating any hunk.
+ *
+ * @param file1 The first file represented as a vector of strings.
+ * @param file2 The second file represented as a vector of strings.
+ * @param algorithm The algorithm aligning the two files.
+ * @param whitespace Which whitespace differences are ignored when comparing lines.
+ * @return The lines of `file2` and of `file1` that are not in a common run.
+ */
+DiffStat count_diff(const std::vector<std::string> &file1, const std::vector<std::string> &file2,
+                    DiffAlgorithm algorithm, WhitespaceMode whitespace) {
+    size_t common = 0;
+    for (const auto &match: diff_lines(file1, file2, algorithm, whitespace)) {
+        common += match.length;
+    }
+    return {file2.size() - common, file1.size() - common};
 }
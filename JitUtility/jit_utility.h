@@ -8,6 +8,9 @@
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <functional>
+#include <string_view>
+#include "diff_algorithms.h"
 
 #define RESET "\033[0m"
 #define GREEN "\033[1;32m"
@@ -51,6 +54,35 @@ void compress_and_copy(const std::string &source, const std::string &destination
  */
 std::string generateSHA1(const std::string &file_path);
 
+/**
+ * Generates the SHA1 checksum of data held in memory.
+ *
+ * @param content The data to hash.
+ * @return The SHA1 checksum of the data in hexadecimal string format.
+ */
+std::string generate_sha1_of_content(const std::string &content);
+
+/**
+ * Compresses data held in memory and saves it in the directory structure based on its checksum.
+ *
+ * Nothing is written if an object with the same checksum already exists.
+ *
+ * @param destination The root directory where the object will be saved.
+ * @param content The data to save.
+ * @return The SHA1 checksum of the data.
+ * @throws std::runtime_error If an error occurs during compression or file operations.
+ */
+std::string save_content_as_binary(const std::string &destination, const std::string &content);
+
+/**
+ * Reads a compressed object and returns its decompressed content.
+ *
+ * @param source The path to the compressed object.
+ * @return The decompressed content.
+ * @throws std::runtime_error If the object cannot be read or decompressed.
+ */
+std::string read_binary_as_string(const std::string &source);
+
 /**
  * Saves a file in a binary format in a directory structure based on its checksum.
  *
@@ -97,25 +129,53 @@ void decompress_and_copy(const std::string &source, const std::string &destinati
 std::filesystem::path generate_file_path(const std::string &checksum);
 
 /**
- * Computes the Longest Common Subsequence (LCS) table between two files represented as vectors of strings.
- *
- * @param file1 The first file represented as a vector of strings.
- * @param file2 The second file represented as a vector of strings.
- * @return A 2D vector representing the LCS table.
+ * One line of a diff hunk.
  */
-std::vector<std::vector<int>>
-compute_lcs_table(const std::vector<std::string> &file1, const std::vector<std::string> &file2);
+struct DiffLine {
+    char type;              ///< ' ' for context, '-' for a removed line, '+' for an added line.
+    std::string_view text;  ///< The line, pointing into the file it comes from.
+};
 
 /**
- * Generates a diff between two files represented as vectors of strings based on the LCS table.
+ * A group of nearby changes with their surrounding context, as shown by a unified diff.
+ */
+struct DiffHunk {
+    size_t old_begin;  ///< First line of the hunk in the first file, from 0.
+    size_t old_count;  ///< Lines of the hunk in the first file.
+    size_t new_begin;  ///< First line of the hunk in the second file, from 0.
+    size_t new_count;  ///< Lines of the hunk in the second file.
+    std::vector<DiffLine> lines;
+};
+
+/**
+ * Default number of unchanged lines shown around each change.
+ */
+constexpr size_t DEFAULT_DIFF_CONTEXT = 3;
+
+/**
+ * The number of lines a diff adds and deletes in a file.
+ */
+struct DiffStat {
+    size_t added = 0;
+    size_t deleted = 0;
+};
+
+/**
+ * Generates the hunks of a diff between two files represented as vectors of strings from the runs of lines they have
+ * in common.
+ *
+ * Hunks are built one at a time and handed to `visit`, so the work and memory follow the size of the changes rather
+ * than of the files. Changes separated by at most twice `context_lines` unchanged lines share a hunk.
  *
  * @param file1 The first file represented as a vector of strings.
  * @param file2 The second file represented as a vector of strings.
- * @param lcs_table The LCS table computed between the two files.
- * @return A vector of strings representing the diff between the files.
+ * @param matches The common runs of the two files, as returned by diff_lines.
+ * @param context_lines The number of unchanged lines shown before and after each change.
+ * @param visit Called with each hunk, in file order; the hunk points into `file1` and `file2`.
  */
-std::vector<std::string> generate_diff(const std::vector<std::string> &file1, const std::vector<std::string> &file2,
-                                       const std::vector<std::vector<int>> &lcs_table);
+void generate_diff(const std::vector<std::string> &file1, const std::vector<std::string> &file2,
+                   const std::vector<DiffMatch> &matches, size_t context_lines,
+                   const std::function<void(const DiffHunk &)> &visit);
 
 /**
  * Reads a binary file, decompresses its content, and returns the content as a vector of strings (lines).
@@ -126,12 +186,34 @@ std::vector<std::string> generate_diff(const std::vector<std::string> &file1, co
 std::vector<std::string> read_binary_as_text(const std::string &source);
 
 /**
- * Computes and generates a diff between two files represented as vectors of strings.
+ * Computes and generates the hunks of a diff between two files represented as vectors of strings.
+ *
+ * Each line is hashed once and interned to an integer id, and the common lines are found on the id arrays with the
+ * linear-space Myers diff or one of the anchored algorithms built on it. Memory stays linear in the size of the files
+ * and time follows the number of changed lines.
+ *
+ * @param file1 The first file represented as a vector of strings.
+ * @param file2 The second file represented as a vector of strings.
+ * @param algorithm The algorithm aligning the two files.
+ * @param whitespace Which whitespace differences are ignored when comparing lines.
+ * @param context_lines The number of unchanged lines shown before and after each change.
+ * @param visit Called with each hunk, in file order.
+ */
+void compute_diff(const std::vector<std::string> &file1, const std::vector<std::string> &file2,
+                  DiffAlgorithm algorithm, WhitespaceMode whitespace, size_t context_lines,
+                  const std::function<void(const DiffHunk &)> &visit);
+
+/**
+ * Counts the lines added and deleted between two files, as compute_diff would show them, without generating any
+ * hunk: every line outside the common runs is a change.
  *
  * @param file1 The first file represented as a vector of strings.
  * @param file2 The second file represented as a vector of strings.
- * @return A vector of strings representing the diff between the files.
+ * @param algorithm The algorithm aligning the two files.
+ * @param whitespace Which whitespace differences are ignored when comparing lines.
+ * @return The lines of `file2` and of `file1` that are not in a common run.
  */
-std::vector<std::string> compute_diff(const std::vector<std::string> &file1, const std::vector<std::string> &file2);
+DiffStat count_diff(const std::vector<std::string> &file1, const std::vector<std::string> &file2,
+                    DiffAlgorithm algorithm, WhitespaceMode whitespace);
 
 #endif //JIT_JIT_UTILITY_H
@@ -0,0 +1,87 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "line_interner.h"
+
+namespace {
+    constexpr size_t INITIAL_SLOTS = 64;
+
+    bool is_whitespace(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+    }
+}
+
+LineInterner::LineInterner(WhitespaceMode whitespace) : whitespace(whitespace), slots(INITIAL_SLOTS, 0) {}
+
+uint32_t LineInterner::intern(std::string_view line) {
+    if (whitespace != WhitespaceMode::EXACT) {
+        scratch.clear();
+        for (size_t i = 0; i < line.size(); ++i) {
+            if (!is_whitespace(line[i])) {
+                scratch.push_back(line[i]);
+            } else if (whitespace == WhitespaceMode::IGNORE_CHANGE) {
+                while (i + 1 < line.size() && is_whitespace(line[i + 1])) {
+                    ++i;
+                }
+                if (i + 1 < line.size()) {
+                    scratch.push_back(' ');
+                }
+            }
+        }
+        line = scratch;
+    }
+
+    size_t hash = std::hash<std::string_view>{}(line);
+    size_t mask = slots.size() - 1;
+    size_t slot = hash & mask;
+    for (; slots[slot] != 0; slot = (slot + 1) & mask) {
+        uint32_t id = slots[slot] - 1;
+        if (hashes[id] == hash && lines[id] == line) {
+            return id;
+        }
+    }
+
+    auto id = static_cast<uint32_t>(lines.size());
+    if (whitespace != WhitespaceMode::EXACT) {
+        line = normalized_lines.emplace_back(scratch);
+    }
+    lines.push_back(line);
+    hashes.push_back(hash);
+    slots[slot] = id + 1;
+
+    // At most half full, so that probe sequences stay short.
+    if (lines.size() * 2 > slots.size()) {
+        grow();
+    }
+    return id;
+}
+
+std::vector<uint32_t> LineInterner::intern(const std::vector<std::string> &file_lines) {
+    return intern(file_lines, 0, file_lines.size());
+}
+
+std::vector<uint32_t> LineInterner::intern(const std::vector<std::string> &file_lines, size_t begin, size_t end) {
+    std::vector<uint32_t> line_ids;
+    line_ids.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+        line_ids.push_back(intern(file_lines[i]));
+    }
+    return line_ids;
+}
+
+size_t LineInterner::size() const {
+    return lines.size();
+}
+
+void LineInterner::grow() {
+    slots.assign(slots.size() * 2, 0);
+    size_t mask = slots.size() - 1;
+    for (uint32_t id = 0; id < lines.size(); ++id) {
+        size_t slot = hashes[id] & mask;
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = id + 1;
+    }
+}
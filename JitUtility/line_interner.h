@@ -0,0 +1,67 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#ifndef JIT_LINE_INTERNER_H
+#define JIT_LINE_INTERNER_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Which whitespace differences make two lines different.
+ */
+enum class WhitespaceMode {
+    EXACT,          ///< Lines must be byte-identical.
+    IGNORE_CHANGE,  ///< Runs of whitespace compare equal to a single space, and trailing whitespace is ignored.
+    IGNORE_ALL,     ///< Whitespace is ignored altogether.
+};
+
+/**
+ * Maps lines to small integer ids, equal lines getting equal ids, so that a diff compares ids instead of strings.
+ *
+ * Each line is hashed once, when it is interned. The ids are dense, from 0, so they can index arrays. Files interned
+ * with the same interner share one table, which is what makes their ids comparable.
+ *
+ * In EXACT mode the table points into the interned lines, which must outlive the interner. In the other modes it
+ * keeps its own copy of each distinct normalized line.
+ */
+class LineInterner {
+public:
+    explicit LineInterner(WhitespaceMode whitespace = WhitespaceMode::EXACT);
+
+    /**
+     * @return The id of a line, assigning the next free id if the line is new.
+     */
+    uint32_t intern(std::string_view line);
+
+    /**
+     * @return The ids of the lines of a file, in order.
+     */
+    std::vector<uint32_t> intern(const std::vector<std::string> &lines);
+
+    /**
+     * @return The ids of lines [begin, end) of a file, in order.
+     */
+    std::vector<uint32_t> intern(const std::vector<std::string> &lines, size_t begin, size_t end);
+
+    /**
+     * @return The number of distinct lines interned, one more than the highest id.
+     */
+    [[nodiscard]] size_t size() const;
+
+private:
+    WhitespaceMode whitespace;
+    std::vector<std::string_view> lines;       ///< The line of each id.
+    std::vector<size_t> hashes;                ///< The hash of each id's line.
+    std::vector<uint32_t> slots;               ///< Open-addressing table of id + 1, 0 for empty; a power of two long.
+    std::deque<std::string> normalized_lines;  ///< Owns `lines` when whitespace is normalized; a deque never moves them.
+    std::string scratch;
+
+    void grow();
+};
+
+#endif //JIT_LINE_INTERNER_H
@@ -0,0 +1,178 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "myers_diff.h"
+
+#include <algorithm>
+
+namespace {
+
+    /**
+     * The middle snake of a shortest edit script: a diagonal run from (x, y) to (u, v), possibly empty.
+     */
+    struct Snake {
+        size_t x, y, u, v;
+    };
+
+    class MyersDiff {
+    public:
+        MyersDiff(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines,
+                  size_t line_count, size_t max_cost, std::vector<DiffMatch> &matches)
+                : a(old_lines), b(new_lines), max_cost(max_cost), matches(matches) {
+            size_t diagonals = 2 * (line_count + 1) + 1;
+            forward.resize(diagonals);
+            backward.resize(diagonals);
+
+            if (max_cost == AUTO_DIFF_COST) {
+                size_t root = 1;
+                for (size_t lines = line_count; lines >= 4; lines /= 4) {
+                    root *= 2;
+                }
+                this->max_cost = std::max(root, MIN_DIFF_COST);
+            }
+        }
+
+        void compare(size_t a_begin, size_t a_end, size_t b_begin, size_t b_end) {
+            size_t prefix = 0;
+            while (a_begin + prefix < a_end && b_begin + prefix < b_end && a[a_begin + prefix] == b[b_begin + prefix]) {
+                ++prefix;
+            }
+            append_match(matches, a_begin, b_begin, prefix);
+            a_begin += prefix;
+            b_begin += prefix;
+
+            size_t suffix = 0;
+            while (a_begin < a_end - suffix && b_begin < b_end - suffix &&
+                   a[a_end - suffix - 1] == b[b_end - suffix - 1]) {
+                ++suffix;
+            }
+            a_end -= suffix;
+            b_end -= suffix;
+
+            // With the ends trimmed, a side left empty is all insertions or all deletions. Otherwise both halves
+            // around the middle snake have a shorter edit script, so the recursion ends.
+            if (a_begin < a_end && b_begin < b_end) {
+                Snake snake = middle_snake(a_begin, a_end, b_begin, b_end);
+                compare(a_begin, snake.x, b_begin, snake.y);
+                append_match(matches, snake.x, snake.y, snake.u - snake.x);
+                compare(snake.u, a_end, snake.v, b_end);
+            }
+
+            append_match(matches, a_end, b_end, suffix);
+        }
+
+    private:
+        const std::vector<uint32_t> &a;
+        const std::vector<uint32_t> &b;
+        size_t max_cost;
+        std::vector<DiffMatch> &matches;
+        std::vector<int64_t> forward;   ///< Furthest x reached on each diagonal k = x - y, from the start.
+        std::vector<int64_t> backward;  ///< Furthest x reached on each diagonal, from the end, in reversed coordinates.
+
+        Snake middle_snake(size_t a_begin, size_t a_end, size_t b_begin, size_t b_end) {
+            const auto n = static_cast<int64_t>(a_end - a_begin);
+            const auto m = static_cast<int64_t>(b_end - b_begin);
+            const int64_t delta = n - m;
+            const bool odd = (delta & 1) != 0;
+            const int64_t offset = n + m + 1;
+            const int64_t max_d = (n + m + 1) / 2;
+
+            forward[offset + 1] = 0;
+            backward[offset + 1] = 0;
+
+            for (int64_t d = 0; d <= max_d; ++d) {
+                for (int64_t k = -d; k <= d; k += 2) {
+                    int64_t x = (k == -d || (k != d && forward[offset + k - 1] < forward[offset + k + 1]))
+                                ? forward[offset + k + 1] : forward[offset + k - 1] + 1;
+                    int64_t y = x - k;
+                    int64_t start_x = x, start_y = y;
+                    while (x < n && y < m && a[a_begin + x] == b[b_begin + y]) {
+                        ++x;
+                        ++y;
+                    }
+                    forward[offset + k] = x;
+
+                    // The backward paths of round d - 1 are on diagonals delta - (d - 1) to delta + (d - 1).
+                    int64_t reverse_k = delta - k;
+                    if (odd && reverse_k >= -(d - 1) && reverse_k <= d - 1 && x + backward[offset + reverse_k] >= n) {
+                        return {a_begin + static_cast<size_t>(start_x), b_begin + static_cast<size_t>(start_y),
+                                a_begin + static_cast<size_t>(x), b_begin + static_cast<size_t>(y)};
+                    }
+                }
+
+                for (int64_t k = -d; k <= d; k += 2) {
+                    int64_t x = (k == -d || (k != d && backward[offset + k - 1] < backward[offset + k + 1]))
+                                ? backward[offset + k + 1] : backward[offset + k - 1] + 1;
+                    int64_t y = x - k;
+                    int64_t start_x = x, start_y = y;
+                    while (x < n && y < m && a[a_end - x - 1] == b[b_end - y - 1]) {
+                        ++x;
+                        ++y;
+                    }
+                    backward[offset + k] = x;
+
+                    int64_t forward_k = delta - k;
+                    if (!odd && forward_k >= -d && forward_k <= d && x + forward[offset + forward_k] >= n) {
+                        return {a_end - static_cast<size_t>(x), b_end - static_cast<size_t>(y),
+                                a_end - static_cast<size_t>(start_x), b_end - static_cast<size_t>(start_y)};
+                    }
+                }
+
+                if (static_cast<uint64_t>(d) >= max_cost) {
+                    return furthest_point(a_begin, b_begin, n, m, d);
+                }
+            }
+
+            // Not reached: the paths always meet by round (n + m + 1) / 2.
+            return {a_begin, b_begin, a_begin, b_begin};
+        }
+
+        /**
+         * Picks the point inside the box that the forward paths of round d reached furthest, as an empty snake. Both
+         * halves around it are smaller than the box, so the recursion still ends.
+         */
+        Snake furthest_point(size_t a_begin, size_t b_begin, int64_t n, int64_t m, int64_t d) {
+            const int64_t offset = n + m + 1;
+            int64_t best_x = 0, best_y = 0;
+            for (int64_t k = -d; k <= d; k += 2) {
+                int64_t x = forward[offset + k];
+                int64_t y = x - k;
+                if (x <= n && y >= 0 && y <= m && x + y < n + m && x + y > best_x + best_y) {
+                    best_x = x;
+                    best_y = y;
+                }
+            }
+            return {a_begin + static_cast<size_t>(best_x), b_begin + static_cast<size_t>(best_y),
+                    a_begin + static_cast<size_t>(best_x), b_begin + static_cast<size_t>(best_y)};
+        }
+    };
+}
+
+void append_match(std::vector<DiffMatch> &matches, size_t old_begin, size_t new_begin, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    if (!matches.empty()) {
+        DiffMatch &last = matches.back();
+        if (last.old_begin + last.length == old_begin && last.new_begin + last.length == new_begin) {
+            last.length += length;
+            return;
+        }
+    }
+    matches.push_back({old_begin, new_begin, length});
+}
+
+std::vector<DiffMatch> diff_lines(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines,
+                                  size_t max_cost) {
+    std::vector<DiffMatch> matches;
+    diff_line_range(old_lines, new_lines, 0, old_lines.size(), 0, new_lines.size(), max_cost, matches);
+    return matches;
+}
+
+void diff_line_range(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines,
+                     size_t old_begin, size_t old_end, size_t new_begin, size_t new_end, size_t max_cost,
+                     std::vector<DiffMatch> &matches) {
+    MyersDiff(old_lines, new_lines, (old_end - old_begin) + (new_end - new_begin), max_cost, matches)
+            .compare(old_begin, old_end, new_begin, new_end);
+}
@@ -0,0 +1,72 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#ifndef JIT_MYERS_DIFF_H
+#define JIT_MYERS_DIFF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "line_interner.h"
+
+/**
+ * A run of lines common to both sides of a diff.
+ */
+struct DiffMatch {
+    size_t old_begin; ///< First line of the run in the old file.
+    size_t new_begin; ///< First line of the run in the new file.
+    size_t length;    ///< Number of lines in the run.
+};
+
+/**
+ * Appends a common run to a list of runs, merging it with the last one if they are adjacent. Empty runs are dropped.
+ */
+void append_match(std::vector<DiffMatch> &matches, size_t old_begin, size_t new_begin, size_t length);
+
+/**
+ * Cost cutoff of diff_lines chosen from the size of the files: about the square root of the number of lines, and never
+ * less than MIN_DIFF_COST.
+ */
+constexpr size_t AUTO_DIFF_COST = 0;
+
+/**
+ * Cost cutoff of diff_lines that never gives up on a minimal diff.
+ */
+constexpr size_t UNLIMITED_DIFF_COST = SIZE_MAX;
+
+/**
+ * Lowest cost cutoff chosen by AUTO_DIFF_COST.
+ */
+constexpr size_t MIN_DIFF_COST = 256;
+
+/**
+ * Finds the lines two files have in common, using Myers' O((N+M)·D) algorithm with the linear-space middle-snake
+ * refinement.
+ *
+ * The common prefix and suffix are matched first. The rest is split at the middle snake of its shortest edit script,
+ * and the two halves are solved the same way, so the memory used is linear in the size of the files and the time
+ * follows the number of differing lines D.
+ *
+ * When the search for a middle snake goes past `max_cost` edits, it stops and splits at the point its forward paths
+ * reached furthest instead. The diff is then no longer minimal, but two unrelated files cost O((N+M)·max_cost) rather
+ * than O((N+M)²).
+ *
+ * @param old_lines The line ids of the old file, from a LineInterner shared with the new file.
+ * @param new_lines The line ids of the new file.
+ * @param max_cost The number of edits after which a split is forced, AUTO_DIFF_COST or UNLIMITED_DIFF_COST.
+ * @return The common runs, in increasing order on both sides; adjacent runs are merged.
+ */
+std::vector<DiffMatch> diff_lines(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines,
+                                  size_t max_cost = AUTO_DIFF_COST);
+
+/**
+ * Runs diff_lines on lines [old_begin, old_end) of the old file and [new_begin, new_end) of the new file only.
+ *
+ * @param matches The runs found are appended to it, merged with its last run if adjacent.
+ */
+void diff_line_range(const std::vector<uint32_t> &old_lines, const std::vector<uint32_t> &new_lines,
+                     size_t old_begin, size_t old_end, size_t new_begin, size_t new_end, size_t max_cost,
+                     std::vector<DiffMatch> &matches);
+
+#endif //JIT_MYERS_DIFF_H
@@ -0,0 +1,98 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/**
+ * Resolves the number of worker threads to use.
+ *
+ * @param requested The configured number of threads, 0 meaning "one per hardware thread".
+ * @param task_count The number of tasks to be run; no more threads than tasks are started.
+ * @return The number of threads to start, at least 1.
+ */
+size_t resolve_thread_count(size_t requested, size_t task_count) {
+    size_t thread_count = requested == 0 ? std::thread::hardware_concurrency() : requested;
+    return std::max<size_t>(1, std::min(thread_count, task_count));
+}
+
+/**
+ * Runs `task_count` tasks on a pool of worker threads.
+ *
+ * @param task_count The number of tasks to run.
+ * @param thread_count The number of worker threads, as returned by resolve_thread_count.
+ * @param task The task body, called with the worker index (0 to thread_count - 1) and the task index.
+ */
+void run_in_parallel(size_t task_count, size_t thread_count,
+                     const std::function<void(size_t worker, size_t task)> &task) {
+    std::atomic<size_t> next_task = 0;
+    std::atomic<bool> failed = false;
+    std::exception_ptr first_error;
+    std::mutex error_mutex;
+
+    auto worker_loop = [&](size_t worker) {
+        size_t current;
+        while (!failed && (current = next_task.fetch_add(1)) < task_count) {
+            try {
+                task(worker, current);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!first_error) {
+                    first_error = std::current_exception();
+                }
+                failed = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(thread_count > 0 ? thread_count - 1 : 0);
+    for (size_t worker = 1; worker < thread_count; ++worker) {
+        workers.emplace_back(worker_loop, worker);
+    }
+
+    worker_loop(0);
+
+    for (auto &worker: workers) {
+        worker.join();
+    }
+
+    if (first_error) {
+        std::rethrow_exception(first_error);
+    }
+}
+
+/**
+ * Runs `task_count` tasks on a pool of worker threads and hands their results to `emit` in task order.
+ *
+ * @param task_count The number of tasks to run.
+ * @param thread_count The number of worker threads, as returned by resolve_thread_count.
+ * @param task The task body, called with the worker index and the task index, returning the task's result.
+ * @param emit Called with each task index and its result, in increasing task order.
+ */
+void run_in_parallel_ordered(size_t task_count, size_t thread_count,
+                             const std::function<std::string(size_t worker, size_t task)> &task,
+                             const std::function<void(size_t task, std::string &result)> &emit) {
+    std::vector<std::optional<std::string>> results(task_count);
+    size_t next_emit = 0;
+    std::mutex emit_mutex;
+
+    run_in_parallel(task_count, thread_count, [&](size_t worker, size_t current) {
+        std::string result = task(worker, current);
+
+        std::lock_guard<std::mutex> lock(emit_mutex);
+        results[current] = std::move(result);
+        for (; next_emit < task_count && results[next_emit]; ++next_emit) {
+            emit(next_emit, *results[next_emit]);
+            results[next_emit].reset();
+        }
+    });
+}
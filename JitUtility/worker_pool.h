@@ -0,0 +1,52 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#ifndef JIT_WORKER_POOL_H
+#define JIT_WORKER_POOL_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+/**
+ * Resolves the number of worker threads to use.
+ *
+ * @param requested The configured number of threads, 0 meaning "one per hardware thread".
+ * @param task_count The number of tasks to be run; no more threads than tasks are started.
+ * @return The number of threads to start, at least 1.
+ */
+size_t resolve_thread_count(size_t requested, size_t task_count);
+
+/**
+ * Runs `task_count` tasks on a pool of worker threads.
+ *
+ * Tasks are handed out in index order from a shared counter, so cheap and expensive tasks balance out between the
+ * workers. The calling thread is used as one of the workers. If a task throws, the remaining tasks are skipped and
+ * the first exception is rethrown once every worker has stopped.
+ *
+ * @param task_count The number of tasks to run.
+ * @param thread_count The number of worker threads, as returned by resolve_thread_count.
+ * @param task The task body, called with the worker index (0 to thread_count - 1) and the task index.
+ */
+void run_in_parallel(size_t task_count, size_t thread_count,
+                     const std::function<void(size_t worker, size_t task)> &task);
+
+/**
+ * Runs `task_count` tasks on a pool of worker threads, like run_in_parallel, and hands their results to `emit` in
+ * task order.
+ *
+ * A result is emitted as soon as it and every result before it are ready, by whichever worker completed the last of
+ * them, so output starts before the slowest task ends while keeping a deterministic order. Calls to `emit` never
+ * overlap. Only results waiting on an earlier task are held in memory.
+ *
+ * @param task_count The number of tasks to run.
+ * @param thread_count The number of worker threads, as returned by resolve_thread_count.
+ * @param task The task body, called with the worker index and the task index, returning the task's result.
+ * @param emit Called with each task index and its result, in increasing task order.
+ */
+void run_in_parallel_ordered(size_t task_count, size_t thread_count,
+                             const std::function<std::string(size_t worker, size_t task)> &task,
+                             const std::function<void(size_t task, std::string &result)> &emit);
+
+#endif //JIT_WORKER_POOL_H
@@ -1,7 +1,11 @@
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <unordered_map>
 #include "DirectoryManagement/DirManager.h"
 #include "ChangesManagement/JitActions.h"
+#include "DirectoryManagement/FsMonitor.h"
 
 namespace fs = std::filesystem;
 
@@ -14,16 +18,55 @@ bool validate_args(int argc, int expected_args, const std::string &usage_message
     return true;
 }
 
-// Helper function to map commands to actions
-void execute_command(const std::string &command, int argc, char *argv[], manager::DirManager &dirManager) {
+// Helper function to read a commit count
+bool parse_count(const std::string &value, int &count) {
+    if (value.empty() || !std::all_of(value.begin(), value.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        return false;
+    }
+    count = std::stoi(value);
+    return true;
+}
+
+// Helper function to read a "YYYY-MM-DD" or "YYYY-MM-DD HH:MM:SS" date
+bool parse_date(const std::string &value, std::optional<std::chrono::system_clock::time_point> &date) {
+    std::string date_time = value.size() == 10 ? value + " 00:00:00" : value;
+    std::tm tm = {};
+    std::istringstream iss(date_time);
+    iss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+    if (date_time.size() != 19 || iss.fail() || iss.peek() != std::char_traits<char>::eof()) {
+        return false;
+    }
+    date = string_to_time_point(date_time);
+    return true;
+}
+
+// Helper function to map commands to actions, returning the exit status
+int execute_command(const std::string &command, int argc, char *argv[], manager::DirManager &dirManager) {
 
     if (command == "init") {
         dirManager.initialize_jit();
+    } else if (command == "fsmonitor") {
+        manager::FsMonitor fsMonitor(dirManager.get_root_directory());
+        std::string action = argc == 3 ? argv[2] : "";
+
+        if (action == "start") {
+            fsMonitor.start();
+        } else if (action == "stop") {
+            fsMonitor.stop();
+        } else if (action == "run") {
+            fsMonitor.run();
+        } else {
+            std::cerr << "Usage: jit fsmonitor <start|stop|run>" << std::endl;
+        }
     } else {
         manager::JitActions jitActions(dirManager.get_root_directory());
 
-        if (command == "add" && validate_args(argc, 3, "Usage: jit add <filename>")) {
-            jitActions.jit_add({argv[2]});
+        if (command == "add") {
+            if (argc < 3) {
+                std::cerr << "Usage: jit add <pathspec>..." << std::endl;
+            } else {
+                jitActions.jit_add(std::set<std::string>(argv + 2, argv + argc));
+            }
 
         } else if (command == "commit" && validate_args(argc, 3, "Usage: jit commit <message>")) {
             jitActions.commit(argv[2]);
@@ -32,20 +75,149 @@ void execute_command(const std::string &command, int argc, char *argv[], manager
         } else if (command == "checkout" && validate_args(argc, 3, "Usage: jit checkout <branch-name>/address")) {
             jitActions.checkout_to_a_commit(argv[2]);
         } else if (command == "status") {
-            jitActions.print_jit_status();
+            jitActions.print_jit_status(manager::Pathspec(std::vector<std::string>(argv + 2, argv + argc)));
         } else if (command == "log") {
-            jitActions.jit_commit_log();
+            manager::LogOptions options;
+            std::vector<std::string> revisions;
+            bool valid = true;
+
+            for (int i = 2; i < argc && valid; ++i) {
+                std::string arg = argv[i];
+                if (arg == "--") {
+                    // Everything after "--" is a pathspec.
+                    options.pathspec = manager::Pathspec(std::vector<std::string>(argv + i + 1, argv + argc));
+                    break;
+                } else if ((arg == "-n" || arg == "--max-count") && i + 1 < argc) {
+                    valid = parse_count(argv[++i], options.max_count);
+                } else if (arg.starts_with("--max-count=")) {
+                    valid = parse_count(arg.substr(12), options.max_count);
+                } else if (arg.starts_with("-n")) {
+                    valid = parse_count(arg.substr(2), options.max_count);
+                } else if (arg.size() > 1 && arg[0] == '-' && std::isdigit(static_cast<unsigned char>(arg[1]))) {
+                    valid = parse_count(arg.substr(1), options.max_count);
+                } else if (arg.starts_with("--since=") || arg.starts_with("--after=")) {
+                    valid = parse_date(arg.substr(arg.find('=') + 1), options.since);
+                } else if (arg.starts_with("--until=") || arg.starts_with("--before=")) {
+                    valid = parse_date(arg.substr(arg.find('=') + 1), options.until);
+                } else if (arg.starts_with("--author=")) {
+                    options.author = arg.substr(9);
+                } else if (arg == "--topo-order" || arg == "--date-order") {
+                    options.topo_order = arg == "--topo-order";
+                } else if (!arg.starts_with("-")) {
+                    revisions.push_back(arg);
+                } else {
+                    valid = false;
+                }
+            }
+
+            if (valid) {
+                jitActions.jit_commit_log(revisions, options);
+            } else {
+                std::cerr << "Usage: jit log [-n <count>] [--since=<date>] [--until=<date>] [--author=<name>] "
+                             "[--topo-order|--date-order] [<revision>|<A>..<B>|<A>...<B>]... [-- <pathspec>...]" << std::endl;
+            }
         } else if (command == "merge" && validate_args(argc, 3, "Usage: jit merge <branch-name>")) {
             jitActions.merge(argv[2]);
+        } else if (command == "merge-base") {
+            std::vector<std::string> commits(argv + 2, argv + argc);
+            bool all = std::erase(commits, "--all") != 0;
+
+            bool is_ancestor = std::erase(commits, "--is-ancestor") != 0;
+
+            if (commits.size() == 2 && is_ancestor) {
+                return jitActions.is_ancestor(commits[0], commits[1]) ? 0 : 1;
+            } else if (commits.size() == 2) {
+                jitActions.print_merge_base(commits[0], commits[1], all);
+            } else {
+                std::cerr << "Usage: jit merge-base [--all|--is-ancestor] <commit> <commit>" << std::endl;
+            }
+        } else if (command == "blame" && validate_args(argc, 3, "Usage: jit blame <file>")) {
+            jitActions.blame(argv[2]);
+        } else if (command == "gc" && validate_args(argc, 2, "Usage: jit gc")) {
+            jitActions.gc();
+        } else if (command == "commit-graph") {
+            if (argc == 3 && std::string(argv[2]) == "write") {
+                jitActions.write_commit_graph();
+            } else {
+                std::cerr << "Usage: jit commit-graph write" << std::endl;
+            }
         } else if (command == "branch") {
-            jitActions.list_jit_branches();
+            std::string option = argc == 3 ? argv[2] : "";
+            if (argc == 2 || option == "-v" || option == "-vv" || option == "--verbose") {
+                jitActions.list_jit_branches(argc == 3);
+            } else {
+                std::cerr << "Usage: jit branch [-v|-vv]" << std::endl;
+            }
         } else if (command == "diff") {
-            if (argc == 2) {
-                jitActions.jit_diff();
-            } else if (argc == 3) {
-                jitActions.jit_diff(argv[2]);
+            // Everything after "--" is a pathspec; before it, options and at most one branch or branch range.
+            manager::DiffOptions options;
+            std::vector<std::string> revisions;
+            std::vector<std::string> paths;
+            bool after_separator = false;
+            bool valid = true;
+
+            for (int i = 2; i < argc && valid; ++i) {
+                std::string arg = argv[i];
+                if (after_separator) {
+                    paths.push_back(arg);
+                } else if (arg == "--") {
+                    after_separator = true;
+                } else if (arg.starts_with("--diff-algorithm=")) {
+                    auto algorithm = parse_diff_algorithm(arg.substr(17));
+                    valid = algorithm.has_value();
+                    options.algorithm = algorithm.value_or(options.algorithm);
+                } else if (arg == "-w" || arg == "--ignore-all-space") {
+                    options.whitespace = WhitespaceMode::IGNORE_ALL;
+                } else if (arg == "-b" || arg == "--ignore-space-change") {
+                    options.whitespace = WhitespaceMode::IGNORE_CHANGE;
+                } else if (arg == "--stat") {
+                    options.format = manager::DiffFormat::STAT;
+                } else if (arg == "--numstat") {
+                    options.format = manager::DiffFormat::NUMSTAT;
+                } else if (arg == "--name-status") {
+                    options.format = manager::DiffFormat::NAME_STATUS;
+                } else if (arg.starts_with("-U") || arg.starts_with("--unified=")) {
+                    int context_lines;
+                    valid = parse_count(arg.substr(arg.starts_with("-U") ? 2 : 10), context_lines);
+                    options.context_lines = valid ? context_lines : options.context_lines;
+                } else if (!arg.starts_with("-")) {
+                    revisions.push_back(arg);
+                } else {
+                    valid = false;
+                }
+            }
+
+            manager::Pathspec pathspec(paths);
+            if (valid && revisions.empty()) {
+                jitActions.jit_diff(pathspec, options);
+            } else if (valid && revisions.size() == 1) {
+                jitActions.jit_diff(revisions.front(), pathspec, options);
             } else {
-                std::cerr << "Usage: jit diff" << std::endl;
+                std::cerr << "Usage: jit diff [--stat|--numstat|--name-status] [-U<n>] [-w|-b] "
+                             "[--diff-algorithm=auto|myers|minimal|patience|histogram] "
+                             "[<branch>|<branch1>..<branch2>] [-- <pathspec>...]" << std::endl;
+            }
+        } else if (command == "sparse-checkout") {
+            std::string action = argc >= 3 ? argv[2] : "";
+            std::vector<std::string> patterns(argv + std::min(argc, 3), argv + argc);
+            bool cone_mode = std::erase(patterns, "--no-cone") == 0;
+            std::erase(patterns, "--cone");
+
+            std::optional<bool> sparse_index;
+            if (std::erase(patterns, "--sparse-index") != 0) {
+                sparse_index = true;
+            } else if (std::erase(patterns, "--no-sparse-index") != 0) {
+                sparse_index = false;
+            }
+
+            if (action == "set") {
+                jitActions.sparse_checkout_set(patterns, cone_mode, sparse_index);
+            } else if (action == "list" && argc == 3) {
+                jitActions.sparse_checkout_list();
+            } else if (action == "disable" && argc == 3) {
+                jitActions.sparse_checkout_disable();
+            } else {
+                std::cerr << "Usage: jit sparse-checkout <set [--no-cone] [--[no-]sparse-index] <pattern>...|list|disable>" << std::endl;
             }
         } else if (command == "clone") {
             if (argc == 3) {
@@ -64,6 +236,7 @@ void execute_command(const std::string &command, int argc, char *argv[], manager
         }
     }
 
+    return 0;
 }
 
 int main(int argc, char *argv[]) {
@@ -81,7 +254,7 @@ int main(int argc, char *argv[]) {
         manager::DirManager dirManager(base_dir.string());
 
         // Execute the command
-        execute_command(command, argc, argv, dirManager);
+        return execute_command(command, argc, argv, dirManager);
 
     } catch (std::exception &ex) {
         std::cerr << ex.what() << std::endl;
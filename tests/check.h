@@ -0,0 +1,26 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#ifndef JIT_CHECK_H
+#define JIT_CHECK_H
+
+#include <iostream>
+
+/**
+ * Number of failed checks in the test executable; main returns non-zero if it is not 0.
+ */
+inline int failed_checks = 0;
+
+/**
+ * Reports a failed condition with its location and keeps going, so that one run shows every failure.
+ */
+#define CHECK(condition)                                                                    \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n"; \
+            ++failed_checks;                                                                \
+        }                                                                                   \
+    } while (false)
+
+#endif //JIT_CHECK_H
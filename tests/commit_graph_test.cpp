@@ -0,0 +1,300 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "check.h"
+#include "../CommitManagement/CommitGraph.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace fs = std::filesystem;
+using manager::CommitGraph;
+
+namespace {
+
+    /**
+     * @return A commit id made of the hexadecimal digits of `number`.
+     */
+    std::string commit_id(unsigned number) {
+        char buffer[41];
+        std::snprintf(buffer, sizeof(buffer), "%040x", number);
+        return buffer;
+    }
+
+    /**
+     * A commit graph in a fresh directory, with commits named by number and dated in that order.
+     */
+    class TestGraph {
+    public:
+        explicit TestGraph(const std::string &name)
+                : directory(fs::temp_directory_path() / ("jit_" + name + "_" + std::to_string(getpid()))) {
+            fs::remove_all(directory);
+            fs::create_directories(directory);
+            graph = std::make_unique<CommitGraph>(path());
+        }
+
+        ~TestGraph() {
+            graph.reset();
+            fs::remove_all(directory);
+        }
+
+        [[nodiscard]] std::string path() const {
+            return (directory / "commit-graph").string();
+        }
+
+        void add(unsigned number, const std::vector<unsigned> &parents) {
+            Commit commit{commit_id(number), "commit " + std::to_string(number), "master", "tester",
+                          std::chrono::system_clock::time_point(std::chrono::seconds(1000 + number)), {}, {}};
+            for (unsigned parent: parents) {
+                commit.parents.push_back(commit_id(parent));
+            }
+            graph->add_commit(commit);
+        }
+
+        uint32_t at(unsigned number) {
+            auto position = graph->get_commit(commit_id(number));
+            CHECK(position.has_value());
+            return position.value_or(0);
+        }
+
+        std::vector<unsigned> merge_bases(unsigned commit1, unsigned commit2) {
+            std::vector<unsigned> numbers;
+            for (uint32_t base: graph->get_merge_bases(at(commit1), at(commit2))) {
+                numbers.push_back(std::stoul(graph->get_checksum(base), nullptr, 16));
+            }
+            std::sort(numbers.begin(), numbers.end());
+            return numbers;
+        }
+
+        bool is_ancestor(unsigned ancestor, unsigned descendant) {
+            return graph->is_ancestor(at(ancestor), at(descendant));
+        }
+
+        void reload() {
+            graph = std::make_unique<CommitGraph>(path());
+        }
+
+        fs::path directory;
+        std::unique_ptr<CommitGraph> graph;
+    };
+
+    /**
+     * Two merges of the same parents, one with a long history and one a root: the walk goes stale on the long
+     * side first and must still reach the root.
+     */
+    void test_merge_bases_of_merges_sharing_a_root_parent() {
+        TestGraph graph("shared_root");
+        graph.add(1, {});
+        for (unsigned commit = 2; commit <= 10; ++commit) {
+            graph.add(commit, {commit - 1});
+        }
+        graph.add(20, {});
+        graph.add(30, {10, 20});
+        graph.add(31, {10, 20});
+
+        CHECK((graph.merge_bases(30, 31) == std::vector<unsigned>{10, 20}));
+        CHECK((graph.merge_bases(31, 30) == std::vector<unsigned>{10, 20}));
+    }
+
+    /**
+     * Criss-cross merges leave two best common ancestors; their own ancestors are not reported.
+     */
+    void test_merge_bases_of_criss_cross_merges() {
+        TestGraph graph("criss_cross");
+        graph.add(1, {});
+        graph.add(2, {1});
+        graph.add(3, {1});
+        graph.add(4, {2, 3});
+        graph.add(5, {3, 2});
+        graph.add(6, {4});
+        graph.add(7, {5});
+
+        CHECK((graph.merge_bases(6, 7) == std::vector<unsigned>{2, 3}));
+        CHECK((graph.merge_bases(6, 4) == std::vector<unsigned>{4}));
+        CHECK((graph.merge_bases(2, 3) == std::vector<unsigned>{1}));
+    }
+
+    /**
+     * More tips than fit in one word of reach bits, counted twice to check that a walk leaves no bits behind.
+     */
+    void test_ahead_behind() {
+        TestGraph graph("ahead_behind");
+        graph.add(1, {});
+        for (unsigned commit = 2; commit <= 80; ++commit) {
+            graph.add(commit, {commit - 1});
+        }
+        graph.add(100, {20});
+
+        std::vector<uint32_t> tips;
+        for (unsigned commit = 1; commit <= 80; ++commit) {
+            tips.push_back(graph.at(commit));
+        }
+        tips.push_back(graph.at(100));
+
+        for (int walk = 0; walk < 2; ++walk) {
+            auto counts = graph.graph->ahead_behind(graph.at(40), tips);
+            CHECK(counts.size() == tips.size());
+            for (unsigned commit = 1; commit <= 80 && commit <= counts.size(); ++commit) {
+                auto expected = commit <= 40 ? std::make_pair(0u, 40 - commit) : std::make_pair(commit - 40, 0u);
+                CHECK(counts[commit - 1] == expected);
+            }
+            CHECK((counts.back() == std::make_pair(1u, 20u)));
+        }
+        CHECK((graph.graph->ahead_behind(graph.at(100), graph.at(80)) == std::make_pair(1u, 60u)));
+    }
+
+    void test_merge_bases_of_unrelated_commits() {
+        TestGraph graph("unrelated");
+        graph.add(1, {});
+        graph.add(2, {1});
+        graph.add(3, {});
+
+        CHECK(graph.merge_bases(2, 3).empty());
+        CHECK(!graph.is_ancestor(3, 2));
+    }
+
+    void test_is_ancestor() {
+        TestGraph graph("is_ancestor");
+        graph.add(1, {});
+        graph.add(2, {1});
+        graph.add(3, {1});
+        graph.add(4, {2, 3});
+        graph.add(5, {4});
+        graph.add(6, {2});
+
+        CHECK(graph.is_ancestor(1, 5));
+        CHECK(graph.is_ancestor(3, 5));
+        CHECK(graph.is_ancestor(5, 5));
+        CHECK(!graph.is_ancestor(5, 1));
+        CHECK(!graph.is_ancestor(3, 6));
+        CHECK(!graph.is_ancestor(6, 5));
+    }
+
+    /**
+     * Appends bytes to the tail file, as a crash in the middle of an append would leave them.
+     */
+    void append_to_tail_file(const TestGraph &graph, const std::string &bytes) {
+        std::ofstream tail(graph.path() + ".tail", std::ios::binary | std::ios::app);
+        tail.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    /**
+     * A record torn by a crash is ignored when reading, and commits added afterwards are not lost behind it.
+     */
+    void test_torn_tail_record_is_cut_off() {
+        TestGraph graph("torn_tail");
+        graph.add(1, {});
+        graph.add(2, {1});
+
+        uint32_t torn_size = 100;
+        append_to_tail_file(graph, std::string(reinterpret_cast<const char *>(&torn_size), sizeof(torn_size)) +
+                                   std::string(10, 'x'));
+        graph.reload();
+        CHECK(graph.graph->size() == 2);
+
+        graph.add(3, {2});
+        graph.reload();
+        CHECK(graph.graph->size() == 3);
+        CHECK(graph.is_ancestor(1, 3));
+        CHECK(graph.graph->get_message(graph.at(3)) == "commit 3");
+    }
+
+    /**
+     * A tail torn inside its header, before the first record, is started again.
+     */
+    void test_torn_tail_header_is_cut_off() {
+        TestGraph graph("torn_header");
+        append_to_tail_file(graph, "JCG");
+        graph.reload();
+        CHECK(graph.graph->size() == 0);
+
+        graph.add(1, {});
+        graph.add(2, {1});
+        graph.reload();
+        CHECK(graph.graph->size() == 2);
+        CHECK(graph.is_ancestor(1, 2));
+    }
+
+    /**
+     * Compacting moves the tail into the segment without losing commits or parents.
+     */
+    void test_compaction_keeps_commits() {
+        TestGraph graph("compaction");
+        graph.add(1, {});
+        graph.add(2, {1});
+        graph.graph->save_commits(graph.path());
+        graph.add(3, {2});
+        graph.reload();
+
+        CHECK(graph.graph->size() == 3);
+        CHECK(fs::file_size(graph.path() + ".tail") > 0);
+        CHECK((graph.merge_bases(3, 2) == std::vector<unsigned>{2}));
+    }
+
+    void append_legacy_field(std::string &buffer, const std::string &value) {
+        size_t size = value.size();
+        buffer.append(reinterpret_cast<const char *>(&size), sizeof(size));
+        buffer += value;
+    }
+
+    /**
+     * Graphs in the older compressed format are still read, even when they compress far better than ten to one.
+     */
+    void test_legacy_graph_is_converted() {
+        TestGraph graph("legacy");
+        std::string message(200000, 'm');
+
+        std::string commits;
+        size_t commit_count = 2;
+        commits.append(reinterpret_cast<const char *>(&commit_count), sizeof(commit_count));
+        for (unsigned number = 1; number <= 2; ++number) {
+            append_legacy_field(commits, commit_id(number));
+            append_legacy_field(commits, message);
+            append_legacy_field(commits, "master");
+            append_legacy_field(commits, "tester");
+            long long time = std::chrono::system_clock::duration(std::chrono::seconds(1000 + number)).count();
+            commits.append(reinterpret_cast<const char *>(&time), sizeof(time));
+            size_t parent_count = number == 1 ? 0 : 1;
+            commits.append(reinterpret_cast<const char *>(&parent_count), sizeof(parent_count));
+            if (parent_count == 1) {
+                append_legacy_field(commits, commit_id(1));
+            }
+        }
+
+        uLong compressed_size = compressBound(commits.size());
+        std::string compressed(compressed_size, '\0');
+        CHECK(compress(reinterpret_cast<Bytef *>(compressed.data()), &compressed_size,
+                       reinterpret_cast<const Bytef *>(commits.data()), commits.size()) == Z_OK);
+        CHECK(10 * compressed_size < commits.size());
+
+        graph.graph.reset();
+        {
+            std::ofstream legacy(graph.path(), std::ios::binary);
+            legacy.write(reinterpret_cast<const char *>(&compressed_size), sizeof(compressed_size));
+            legacy.write(compressed.data(), static_cast<std::streamsize>(compressed_size));
+        }
+        graph.reload();
+
+        CHECK(graph.graph->size() == 2);
+        CHECK(graph.is_ancestor(1, 2));
+        CHECK(graph.graph->get_message(graph.at(2)) == message);
+    }
+}
+
+int main() {
+    test_merge_bases_of_merges_sharing_a_root_parent();
+    test_merge_bases_of_criss_cross_merges();
+    test_merge_bases_of_unrelated_commits();
+    test_is_ancestor();
+    test_ahead_behind();
+    test_torn_tail_record_is_cut_off();
+    test_torn_tail_header_is_cut_off();
+    test_compaction_keeps_commits();
+    test_legacy_graph_is_converted();
+    return failed_checks == 0 ? 0 : 1;
+}
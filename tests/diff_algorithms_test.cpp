@@ -0,0 +1,138 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "check.h"
+#include "../JitUtility/diff_algorithms.h"
+
+#include <random>
+
+static bool operator==(const DiffMatch &a, const DiffMatch &b) {
+    return a.old_begin == b.old_begin && a.new_begin == b.new_begin && a.length == b.length;
+}
+
+namespace {
+
+    std::vector<std::string> split_lines(const std::string &text) {
+        std::vector<std::string> lines;
+        for (char line: text) {
+            lines.emplace_back(1, line);
+        }
+        return lines;
+    }
+
+    /**
+     * @return The common runs of two files given one line per character.
+     */
+    std::vector<DiffMatch> diff(const std::string &old_text, const std::string &new_text, DiffAlgorithm algorithm) {
+        return diff_lines(split_lines(old_text), split_lines(new_text), algorithm);
+    }
+
+    /**
+     * @return The length of the longest common subsequence of two files, by dynamic programming.
+     */
+    size_t longest_common_subsequence(const std::string &old_text, const std::string &new_text) {
+        std::vector<std::vector<size_t>> lengths(old_text.size() + 1, std::vector<size_t>(new_text.size() + 1, 0));
+        for (size_t i = 1; i <= old_text.size(); ++i) {
+            for (size_t j = 1; j <= new_text.size(); ++j) {
+                lengths[i][j] = old_text[i - 1] == new_text[j - 1] ? lengths[i - 1][j - 1] + 1 :
+                                std::max(lengths[i - 1][j], lengths[i][j - 1]);
+            }
+        }
+        return lengths[old_text.size()][new_text.size()];
+    }
+
+    /**
+     * Checks that the runs pair equal lines, go forward on both sides and are merged when adjacent.
+     *
+     * @return The number of lines matched.
+     */
+    size_t check_matches(const std::string &old_text, const std::string &new_text,
+                         const std::vector<DiffMatch> &matches) {
+        size_t old_end = 0, new_end = 0, matched = 0;
+        for (size_t m = 0; m < matches.size(); ++m) {
+            const DiffMatch &match = matches[m];
+            CHECK(match.length > 0);
+            CHECK(match.old_begin >= old_end && match.new_begin >= new_end);
+            CHECK(m == 0 || match.old_begin > old_end || match.new_begin > new_end);
+            CHECK(match.old_begin + match.length <= old_text.size());
+            CHECK(match.new_begin + match.length <= new_text.size());
+            CHECK(old_text.compare(match.old_begin, match.length, new_text, match.new_begin, match.length) == 0);
+            old_end = match.old_begin + match.length;
+            new_end = match.new_begin + match.length;
+            matched += match.length;
+        }
+        return matched;
+    }
+
+    void test_every_algorithm_returns_valid_matches() {
+        std::mt19937 random(26);
+        const DiffAlgorithm algorithms[] = {DiffAlgorithm::AUTO, DiffAlgorithm::MYERS, DiffAlgorithm::MINIMAL,
+                                            DiffAlgorithm::PATIENCE, DiffAlgorithm::HISTOGRAM};
+        for (int round = 0; round < 2000; ++round) {
+            std::string old_text, new_text;
+            for (size_t i = random() % 40; i > 0; --i) {
+                old_text += static_cast<char>('a' + random() % 6);
+            }
+            new_text = old_text;
+            for (size_t edits = random() % 6; edits > 0; --edits) {
+                size_t position = new_text.empty() ? 0 : random() % new_text.size();
+                if (random() % 2 == 0 && !new_text.empty()) {
+                    new_text.erase(position, 1);
+                } else {
+                    new_text.insert(position, 1, static_cast<char>('a' + random() % 8));
+                }
+            }
+
+            for (DiffAlgorithm algorithm: algorithms) {
+                size_t matched = check_matches(old_text, new_text, diff(old_text, new_text, algorithm));
+                if (algorithm == DiffAlgorithm::MINIMAL) {
+                    CHECK(matched == longest_common_subsequence(old_text, new_text));
+                }
+            }
+        }
+    }
+
+    /**
+     * Patience aligns on the lines found once on each side, A and B here, even where a longer alignment exists
+     * through the repeated lines.
+     */
+    void test_patience_anchors_on_unique_lines() {
+        std::vector<DiffMatch> matches = diff("AxxByyQ", "xAyBZ", DiffAlgorithm::PATIENCE);
+        CHECK((matches == std::vector<DiffMatch>{{0, 1, 1}, {3, 3, 1}}));
+    }
+
+    /**
+     * Histogram anchors on the rarest region even when a longer one through more frequent lines is found after it.
+     * x and w occur too often to start a region, so both regions are found from p: its first occurrence gives the
+     * rare `p U`, its second the longer `x w p`.
+     */
+    void test_histogram_prefers_rare_anchors_over_long_ones() {
+        std::vector<std::string> old_lines = {"p", "U", "z"};
+        for (size_t i = 0; i <= HISTOGRAM_MAX_CHAIN_LENGTH + 1; ++i) {
+            old_lines.emplace_back("x");
+            old_lines.emplace_back("w");
+        }
+        old_lines.emplace_back("p");
+        old_lines.emplace_back("q");
+        std::vector<std::string> new_lines = {"x", "w", "p", "U"};
+
+        std::vector<DiffMatch> matches = diff_lines(old_lines, new_lines, DiffAlgorithm::HISTOGRAM);
+        CHECK((matches == std::vector<DiffMatch>{{0, 2, 2}}));
+    }
+
+    void test_identical_and_empty_files() {
+        CHECK((diff("abc", "abc", DiffAlgorithm::HISTOGRAM) == std::vector<DiffMatch>{{0, 0, 3}}));
+        CHECK((diff("abc", "abc", DiffAlgorithm::PATIENCE) == std::vector<DiffMatch>{{0, 0, 3}}));
+        CHECK(diff("", "abc", DiffAlgorithm::PATIENCE).empty());
+        CHECK(diff("abc", "", DiffAlgorithm::HISTOGRAM).empty());
+    }
+}
+
+int main() {
+    test_every_algorithm_returns_valid_matches();
+    test_patience_anchors_on_unique_lines();
+    test_histogram_prefers_rare_anchors_over_long_ones();
+    test_identical_and_empty_files();
+    return failed_checks == 0 ? 0 : 1;
+}
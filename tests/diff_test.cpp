@@ -0,0 +1,113 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "check.h"
+#include "../ChangesManagement/JitActions.h"
+#include "../DirectoryManagement/DirManager.h"
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    /**
+     * A fresh repository that is also the working directory while it lives, like the tree `jit` runs in.
+     */
+    class TestRepository {
+    public:
+        explicit TestRepository(const std::string &name)
+                : directory(fs::temp_directory_path() / ("jit_" + name + "_" + std::to_string(getpid()))),
+                  previous_directory(fs::current_path()) {
+            fs::remove_all(directory);
+            fs::create_directories(directory);
+            fs::current_path(directory);
+            manager::DirManager("./").initialize_jit();
+        }
+
+        ~TestRepository() {
+            fs::current_path(previous_directory);
+            fs::remove_all(directory);
+        }
+
+        void write(const std::string &filename, const std::string &content) {
+            std::ofstream(directory / filename) << content;
+        }
+
+        manager::JitActions actions{"./"};
+
+    private:
+        fs::path directory;
+        fs::path previous_directory;
+    };
+
+    /**
+     * @return What `action` prints on the standard output.
+     */
+    std::string captured_output(const std::function<void()> &action) {
+        std::ostringstream output;
+        std::streambuf *previous = std::cout.rdbuf(output.rdbuf());
+        try {
+            action();
+        } catch (...) {
+            std::cout.rdbuf(previous);
+            throw;
+        }
+        std::cout.rdbuf(previous);
+        return output.str();
+    }
+
+    /**
+     * Before the first commit HEAD holds the null id; staged files are diffed as additions.
+     */
+    void test_diff_before_first_commit() {
+        TestRepository repository("diff_before_first_commit");
+        repository.write("a.txt", "one\n");
+        repository.actions.jit_add({"."});
+
+        std::string patch;
+        try {
+            patch = captured_output([&] { repository.actions.jit_diff(); });
+        } catch (const std::exception &error) {
+            std::cerr << error.what() << "\n";
+        }
+        CHECK(patch.find("--- a/a.txt") != std::string::npos);
+        CHECK(patch.find("@@ -0,0 +1 @@") != std::string::npos);
+        CHECK(patch.find("+one") != std::string::npos);
+    }
+
+    /**
+     * The summary formats read the same HEAD before the first commit: every file is added.
+     */
+    void test_summary_formats_before_first_commit() {
+        TestRepository repository("diff_formats_before_first_commit");
+        repository.write("a.txt", "one\n");
+        repository.write("b.txt", "one\ntwo\n");
+        repository.actions.jit_add({"."});
+
+        auto diff = [&](manager::DiffFormat format) {
+            manager::DiffOptions options;
+            options.format = format;
+            try {
+                return captured_output([&] { repository.actions.jit_diff(manager::Pathspec(), options); });
+            } catch (const std::exception &error) {
+                std::cerr << error.what() << "\n";
+                return std::string();
+            }
+        };
+        CHECK(diff(manager::DiffFormat::NAME_STATUS) == "A\ta.txt\nA\tb.txt\n");
+        CHECK(diff(manager::DiffFormat::NUMSTAT) == "1\t0\ta.txt\n2\t0\tb.txt\n");
+        CHECK(diff(manager::DiffFormat::STAT).find("2 files changed, 3 insertions(+)") != std::string::npos);
+    }
+}
+
+int main() {
+    test_diff_before_first_commit();
+    test_summary_formats_before_first_commit();
+    return failed_checks == 0 ? 0 : 1;
+}
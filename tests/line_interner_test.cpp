@@ -0,0 +1,93 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "check.h"
+#include "../JitUtility/diff_algorithms.h"
+#include "../JitUtility/line_interner.h"
+
+namespace {
+
+    void test_exact_lines_differ_by_any_byte() {
+        LineInterner interner;
+        CHECK(interner.intern("a b") == 0);
+        CHECK(interner.intern("a  b") == 1);
+        CHECK(interner.intern("a b ") == 2);
+        CHECK(interner.intern("a b") == 0);
+        CHECK(interner.size() == 3);
+    }
+
+    /**
+     * -b: a run of whitespace equals a single space and trailing whitespace is dropped, but whitespace is not
+     * equal to none.
+     */
+    void test_ignore_change_collapses_whitespace_runs() {
+        LineInterner interner(WhitespaceMode::IGNORE_CHANGE);
+        uint32_t id = interner.intern("a b");
+        CHECK(interner.intern("a \t b") == id);
+        CHECK(interner.intern("a b \t\r") == id);
+        CHECK(interner.intern("ab") != id);
+        CHECK(interner.intern("  a b") == interner.intern("\ta b"));
+        CHECK(interner.intern("  a b") != id);
+        CHECK(interner.size() == 3);
+    }
+
+    /**
+     * -w: whitespace is ignored altogether.
+     */
+    void test_ignore_all_drops_whitespace() {
+        LineInterner interner(WhitespaceMode::IGNORE_ALL);
+        uint32_t id = interner.intern("ab");
+        CHECK(interner.intern(" a\tb ") == id);
+        CHECK(interner.intern("a b") == id);
+        CHECK(interner.intern("") == interner.intern(" \t"));
+        CHECK(interner.intern("a c") != id);
+    }
+
+    /**
+     * Ids stay dense and stable while the table grows, including for normalized lines, which the interner owns.
+     */
+    void test_ids_survive_growth() {
+        for (WhitespaceMode whitespace: {WhitespaceMode::EXACT, WhitespaceMode::IGNORE_CHANGE}) {
+            std::vector<std::string> lines;
+            for (int i = 0; i < 5000; ++i) {
+                lines.push_back("line  " + std::to_string(i));
+            }
+
+            LineInterner interner(whitespace);
+            std::vector<uint32_t> ids = interner.intern(lines);
+            CHECK(interner.size() == lines.size());
+            for (uint32_t i = 0; i < ids.size(); ++i) {
+                CHECK(ids[i] == i);
+            }
+            CHECK(interner.intern(lines) == ids);
+        }
+    }
+
+    /**
+     * Whitespace modes carry through to diff_lines, including the common prefix and suffix it matches before
+     * interning.
+     */
+    void test_diff_lines_ignores_whitespace_as_asked() {
+        std::vector<std::string> old_lines = {"a", "b  c", "d", "e"};
+        std::vector<std::string> new_lines = {"a ", "b c", "d", " e"};
+
+        auto exact = diff_lines(old_lines, new_lines, DiffAlgorithm::MYERS);
+        CHECK(exact.size() == 1 && exact[0].old_begin == 2 && exact[0].new_begin == 2 && exact[0].length == 1);
+
+        auto ignore_change = diff_lines(old_lines, new_lines, DiffAlgorithm::MYERS, WhitespaceMode::IGNORE_CHANGE);
+        CHECK(ignore_change.size() == 1 && ignore_change[0].old_begin == 0 && ignore_change[0].length == 3);
+
+        auto ignore_all = diff_lines(old_lines, new_lines, DiffAlgorithm::HISTOGRAM, WhitespaceMode::IGNORE_ALL);
+        CHECK(ignore_all.size() == 1 && ignore_all[0].old_begin == 0 && ignore_all[0].length == 4);
+    }
+}
+
+int main() {
+    test_exact_lines_differ_by_any_byte();
+    test_ignore_change_collapses_whitespace_runs();
+    test_ignore_all_drops_whitespace();
+    test_ids_survive_growth();
+    test_diff_lines_ignores_whitespace_as_asked();
+    return failed_checks == 0 ? 0 : 1;
+}
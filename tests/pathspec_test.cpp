@@ -0,0 +1,80 @@
+//
+// Created by thaiku on 18/10/26.
+//
+
+#include "check.h"
+#include "../DirectoryManagement/Pathspec.h"
+
+#include <chrono>
+
+using manager::Pathspec;
+
+namespace {
+
+    void test_single_star_stays_in_a_component() {
+        CHECK(Pathspec::glob_match("*.cc", "main.cc"));
+        CHECK(!Pathspec::glob_match("*.cc", "src/main.cc"));
+        CHECK(Pathspec::glob_match("src/*.cc", "src/main.cc"));
+        CHECK(Pathspec::glob_match("s*/m*n.cc", "src/main.cc"));
+        CHECK(!Pathspec::glob_match("s*.cc", "src/main.cc"));
+    }
+
+    void test_double_star_crosses_components() {
+        CHECK(Pathspec::glob_match("**.cc", "src/net/socket.cc"));
+        CHECK(Pathspec::glob_match("src/**/socket.cc", "src/net/tcp/socket.cc"));
+        CHECK(Pathspec::glob_match("src/**/socket.cc", "src/socket.cc"));
+        CHECK(!Pathspec::glob_match("src/**/socket.cc", "src/net/socket.h"));
+        CHECK(Pathspec::glob_match("**/*.txt", "docs/readme.txt"));
+        CHECK(Pathspec::glob_match("**/*.txt", "readme.txt"));
+        CHECK(!Pathspec::glob_match("**/b", "xb"));
+    }
+
+    void test_single_characters_and_classes() {
+        CHECK(Pathspec::glob_match("file?.txt", "file1.txt"));
+        CHECK(!Pathspec::glob_match("a?b", "a/b"));
+        CHECK(Pathspec::glob_match("file[0-9].txt", "file7.txt"));
+        CHECK(!Pathspec::glob_match("file[!0-9].txt", "file7.txt"));
+        CHECK(Pathspec::glob_match("file[^0-9].txt", "fileA.txt"));
+        CHECK(!Pathspec::glob_match("a[/]b", "a/b"));
+        CHECK(Pathspec::glob_match("a[b", "a[b"));
+    }
+
+    /**
+     * Patterns with many stars that fail late used to take exponential time.
+     */
+    void test_many_stars_fail_quickly() {
+        std::string path(60, 'a');
+        std::string single = "*a*a*a*a*a*a*a*a*a*a*a*a*b";
+        std::string double_star = "**a**a**a**a**a**a**a**a**a**a**b";
+
+        auto start = std::chrono::steady_clock::now();
+        CHECK(!Pathspec::glob_match(single, path));
+        CHECK(!Pathspec::glob_match(double_star, path));
+        CHECK(!Pathspec::glob_match(double_star, path + "/" + path));
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+    }
+
+    void test_pathspec_matches_directories_and_prefixes() {
+        Pathspec pathspec({"src/net", "docs/*.md"});
+        CHECK(pathspec.matches("src/net/socket.cc"));
+        CHECK(!pathspec.matches("src/network.cc"));
+        CHECK(pathspec.matches("docs/readme.md"));
+        CHECK(!pathspec.matches("docs/api/readme.md"));
+        CHECK(pathspec.could_match_directory("src"));
+        CHECK(pathspec.could_match_directory("docs"));
+        CHECK(!pathspec.could_match_directory("tests"));
+
+        Pathspec glob_directory({"d*"});
+        CHECK(glob_directory.matches("docs/api/readme.md"));
+        CHECK(Pathspec({"./"}).matches_everything());
+    }
+}
+
+int main() {
+    test_single_star_stays_in_a_component();
+    test_double_star_crosses_components();
+    test_single_characters_and_classes();
+    test_many_stars_fail_quickly();
+    test_pathspec_matches_directories_and_prefixes();
+    return failed_checks == 0 ? 0 : 1;
+}